@@ -0,0 +1,185 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+// standard library
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace tego
+{
+    //
+    // Serialises a conversation snapshot to a file on a background thread
+    //
+    // The caller provides the snapshot wrapped up in format_entry, typically
+    // by capturing implicitly shared (copy-on-write) containers by value, so
+    // taking the snapshot costs nothing on the calling thread. Entries are
+    // formatted into a large in-memory buffer which is written out in big
+    // blocks rather than line by line.
+    //
+    // The progress and complete handlers are invoked from the worker thread,
+    // it is up to the caller to marshall them back to their own thread.
+    //
+    class conversation_exporter
+    {
+    public:
+        // appends the serialised entry at index to out
+        using format_entry_t = std::function<void(std::string& out, size_t index)>;
+        using progress_t = std::function<void(size_t entriesWritten, size_t entriesTotal)>;
+        using complete_t = std::function<void(bool success)>;
+
+        // amount of formatted text we accumulate before hitting the disk
+        constexpr static size_t WRITE_BLOCK_SIZE = 1024 * 1024;
+
+        conversation_exporter(
+            std::string destPath,
+            std::string header,
+            size_t entryCount,
+            format_entry_t formatEntry,
+            progress_t progress,
+            complete_t complete)
+        : destPath_(std::move(destPath))
+        , header_(std::move(header))
+        , entryCount_(entryCount)
+        , formatEntry_(std::move(formatEntry))
+        , progress_(std::move(progress))
+        , complete_(std::move(complete))
+        { }
+
+        conversation_exporter(const conversation_exporter&) = delete;
+        conversation_exporter& operator=(const conversation_exporter&) = delete;
+
+        ~conversation_exporter()
+        {
+            cancel();
+            if (worker_.joinable())
+            {
+                worker_.join();
+            }
+        }
+
+        void start()
+        {
+            worker_ = std::thread([this]() -> void
+            {
+                const auto success = this->run();
+                finished_ = true;
+                if (complete_)
+                {
+                    complete_(success);
+                }
+            });
+        }
+
+        // request the worker stop early, the complete handler reports failure
+        void cancel()
+        {
+            cancelled_ = true;
+        }
+
+        bool finished() const
+        {
+            return finished_;
+        }
+
+    private:
+        bool run()
+        {
+            std::ofstream ofile(destPath_, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!ofile.is_open())
+            {
+                return false;
+            }
+
+            std::string buffer;
+            buffer.reserve(WRITE_BLOCK_SIZE + WRITE_BLOCK_SIZE / 4);
+            buffer.append(header_);
+
+            auto flush = [&]() -> bool
+            {
+                ofile.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+                return ofile.good();
+            };
+
+            for (size_t i = 0; i < entryCount_; i++)
+            {
+                if (cancelled_)
+                {
+                    return false;
+                }
+
+                formatEntry_(buffer, i);
+                if (buffer.size() >= WRITE_BLOCK_SIZE)
+                {
+                    if (!flush())
+                    {
+                        return false;
+                    }
+                    if (progress_)
+                    {
+                        progress_(i + 1, entryCount_);
+                    }
+                }
+            }
+
+            if (!flush())
+            {
+                return false;
+            }
+            ofile.close();
+
+            if (progress_)
+            {
+                progress_(entryCount_, entryCount_);
+            }
+            return !ofile.fail();
+        }
+
+        const std::string destPath_;
+        const std::string header_;
+        const size_t entryCount_;
+        const format_entry_t formatEntry_;
+        const progress_t progress_;
+        const complete_t complete_;
+
+        std::atomic_bool cancelled_ = false;
+        std::atomic_bool finished_ = false;
+
+        std::thread worker_;
+    };
+}
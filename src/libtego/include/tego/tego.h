@@ -319,6 +319,12 @@ void tego_user_id_get_v3_onion_service_id(
 // contacts/user methods
 //
 
+// identifies one of the onion services hosted by a tego context
+typedef uint32_t tego_identity_t;
+
+// the identity created by tego_context_start_service
+#define TEGO_PRIMARY_IDENTITY 0
+
 /*
  * Get the host's user_id (derived from private key)
  *
@@ -351,6 +357,35 @@ void tego_context_get_host_onion_service_state(
     tego_host_onion_service_state_t* out_state,
     tego_error_t** error);
 
+/*
+ * Get the user_id of one of the host's identities
+ *
+ * @param context : the current tego context
+ * @param identity : identity returned by tego_context_add_identity, or
+ *  TEGO_PRIMARY_IDENTITY
+ * @param out_hostUser : returned user id
+ * @param error : filled on error
+ */
+void tego_context_get_identity_host_user_id(
+    const tego_context_t* context,
+    tego_identity_t identity,
+    tego_user_id_t** out_hostUser,
+    tego_error_t** error);
+
+/*
+ * Get the current state of one of the host's onion services
+ *
+ * @param context : the current tego context
+ * @param identity : identity whose onion service state we want
+ * @param out_state : destination to save state
+ * @param error : filled on error
+ */
+void tego_context_get_identity_onion_service_state(
+    const tego_context_t* context,
+    tego_identity_t identity,
+    tego_host_onion_service_state_t* out_state,
+    tego_error_t** error);
+
 // TODO: figure out which statuses we need later
 typedef enum
 {
@@ -398,6 +433,22 @@ void tego_context_get_user_type(
     tego_user_type_t* out_type,
     tego_error_t** error);
 
+/*
+ * Get the type of a given user in one of the host's identities
+ *
+ * @param context : the current tego context
+ * @param identity : the identity whose users to look in
+ * @param user : the given user
+ * @param out_type : filled with type on success
+ * @param error : filled on error
+ */
+void tego_context_identity_get_user_type(
+    const tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* user,
+    tego_user_type_t* out_type,
+    tego_error_t** error);
+
 /*
  * Get the number of users managed by our tego context
  *
@@ -410,6 +461,20 @@ void tego_context_get_user_count(
     size_t* out_userCount,
     tego_error_t** error);
 
+/*
+ * Get the number of users managed by one of the host's identities
+ *
+ * @param context : the current tego context
+ * @param identity : the identity whose users to count
+ * @param out_userCount : gets the number of users
+ * @param error : filled on error
+ */
+void tego_context_identity_get_user_count(
+    const tego_context_t* context,
+    tego_identity_t identity,
+    size_t* out_userCount,
+    tego_error_t** error);
+
 /*
  * Get all of our users of a given type
  *
@@ -427,6 +492,25 @@ void tego_context_get_users(
     size_t* out_userCount,
     tego_error_t** error);
 
+/*
+ * Get all of the users of one of the host's identities
+ *
+ * @param context : the current tego context
+ * @param identity : the identity whose users to get
+ * @param out_usersBuffer : destination buffer to store returned user id pointers
+ * @param usersBufferLength : maximum nuber of users that can be written to
+ *  out_usersBuffer
+ * @param out_usersCount : destination to store number of user ids written
+ * @param error : filled on error
+ */
+void tego_context_identity_get_users(
+    const tego_context_t* context,
+    tego_identity_t identity,
+    tego_user_id_t** out_usersBuffer,
+    size_t usersBufferLength,
+    size_t* out_userCount,
+    tego_error_t** error);
+
 //
 // Tor Config
 //
@@ -459,6 +543,80 @@ void tego_tor_launch_config_set_data_directory(
     size_t dataDirectoryLength,
     tego_error_t** error);
 
+/*
+ * Attach to an externally managed tor daemon's control port rather than
+ * launching our own; several contexts may then share one tor. Our onion
+ * services are added detached and removed again when their identity goes
+ * away, and the daemon's own configuration is left untouched. If the tor
+ * already has a service with one of our keys that we did not publish, it is
+ * reported through the tor error callback rather than replaced
+ *
+ * @param launchConfig : config struct to save to
+ * @param address : IP address of the control port
+ * @param addressLength : length of address string not counting the null
+ *  terminator
+ * @param port : the control port
+ * @param error : filled on error
+ */
+void tego_tor_launch_config_set_external_control_port(
+    tego_tor_launch_config_t* launchConfig,
+    const char* address,
+    size_t addressLength,
+    uint16_t port,
+    tego_error_t** error);
+
+/*
+ * Attach to an externally managed tor daemon's control socket (tor's
+ * ControlSocket option) rather than launching our own, not available
+ * on Windows
+ *
+ * @param launchConfig : config struct to save to
+ * @param socketPath : path of the unix domain control socket
+ * @param socketPathLength : length of socketPath not counting the null
+ *  terminator
+ * @param error : filled on error
+ */
+void tego_tor_launch_config_set_external_control_socket(
+    tego_tor_launch_config_t* launchConfig,
+    const char* socketPath,
+    size_t socketPathLength,
+    tego_error_t** error);
+
+/*
+ * Set the password for an external tor's control port. Without one, cookie
+ * or no authentication is used, whichever the daemon offers
+ *
+ * @param launchConfig : config struct to save to
+ * @param password : the control port password
+ * @param passwordLength : length of password not counting the null
+ *  terminator
+ * @param error : filled on error
+ */
+void tego_tor_launch_config_set_external_control_password(
+    tego_tor_launch_config_t* launchConfig,
+    const char* password,
+    size_t passwordLength,
+    tego_error_t** error);
+
+/*
+ * Use unix domain sockets rather than loopback TCP between libtego and tor:
+ * outgoing connections go through a SOCKS listener on a socket in the data
+ * directory, and incoming connections arrive on one socket per identity.
+ * An external tor must have such a SocksPort configured itself, and run as
+ * the same user as libtego or as a member of its group: the identity sockets
+ * are only accessible to that user and group, and tor must be able to reach
+ * them in our data directory. Ignored on Windows, and falls back to TCP where
+ * a socket path would be unusable
+ *
+ * @param launchConfig : config struct to save to
+ * @param enabled : TEGO_TRUE to use unix domain sockets
+ * @param error : filled on error
+ */
+void tego_tor_launch_config_set_unix_sockets(
+    tego_tor_launch_config_t* launchConfig,
+    tego_bool_t enabled,
+    tego_error_t** error);
+
 /*
  * Start an instance of the tor daemon and associate it with the given context
  *
@@ -648,6 +806,32 @@ void tego_context_start_service(
     size_t userCount,
     tego_error_t** error);
 
+/*
+ * Host an additional onion service identity on the same tor instance and
+ * connection stack as the primary one, must be called after
+ * tego_context_start_service. Functions acting on users have a
+ * tego_context_identity_ variant taking the identity to act as, the others
+ * act as the primary identity. Callbacks about users fire for the primary
+ * identity only, their tego_context_set_identity_ variants fire for every
+ * identity and pass the identity the user belongs to
+ *
+ * @param context : the current tego context
+ * @param hostPrivateKey : the identity's private ed25519 key
+ * @param userBuffer : the list of all users this identity cares about
+ * @param userTypeBuffer : the types associated with all of those users
+ * @param userCount : the length of the user and user type buffers
+ * @param out_identity : returned handle for the new identity
+ * @param error : filled on error
+ */
+void tego_context_add_identity(
+    tego_context_t* context,
+    tego_ed25519_private_key_t const* hostPrivateKey,
+    tego_user_id_t const* const* userBuffer,
+    tego_user_type_t* const userTypeBuffer,
+    size_t userCount,
+    tego_identity_t* out_identity,
+    tego_error_t** error);
+
 /*
  * Stop tego's onion service associated with the given context
  *
@@ -670,8 +854,9 @@ size_t tego_context_get_tor_logs_size(
     tego_error_t** error);
 
 /*
- * Fill the passed in buffer with the tor daemon's logs, each entry delimitted
- * by newline character '\n'
+ * Fill the passed in buffer with the tor daemon's logs, each entry terminated
+ * by newline character '\n'. Only whole entries are written, any which do not
+ * fit in out_logBuffer are left out.
  *
  * @param context : the current tego context
  * @param out_logBuffer : user allocated buffer where tor log is to be written
@@ -686,6 +871,50 @@ size_t tego_context_get_tor_logs(
     size_t logBufferSize,
     tego_error_t** error);
 
+/*
+ * Returns the number of characters required (including null) to write out
+ * the tor logs received since the given sequence number
+ *
+ * Only a fixed number of the most recent entries are retained, so a sequence
+ * number which has been evicted behaves as though the oldest retained
+ * entry's sequence number was passed in.
+ *
+ * @param context : the current tego context
+ * @param sequence : sequence number of the first entry of interest; pass 0
+ *  to get every retained entry
+ * @param error : filled on error
+ * @return : the number of characters required
+ */
+size_t tego_context_get_tor_logs_since_size(
+    const tego_context_t* context,
+    uint64_t sequence,
+    tego_error_t** error);
+
+/*
+ * Fill the passed in buffer with the tor daemon's logs received since the
+ * given sequence number, each entry terminated by newline character '\n'.
+ * Only whole entries are written; out_nextSequence is the cursor to pass in
+ * on the next call to pick up where this one left off.
+ *
+ * @param context : the current tego context
+ * @param sequence : sequence number of the first entry to write; pass 0
+ *  to start from the oldest retained entry
+ * @param out_logBuffer : user allocated buffer where tor log is to be written
+ * @param logBufferSize : the size of the passed in out_logBuffer buffer
+ * @param out_nextSequence : (optional) filled with the sequence number
+ *  following the last entry written
+ * @param error : filled on error
+ * @return : the number of characters written (including null terminator) to
+ *  out_logBuffer
+ */
+size_t tego_context_get_tor_logs_since(
+    const tego_context_t* context,
+    uint64_t sequence,
+    char* out_logBuffer,
+    size_t logBufferSize,
+    uint64_t* out_nextSequence,
+    tego_error_t** error);
+
 /*
  * Get the null-terminated tor version string
  *
@@ -820,6 +1049,44 @@ void tego_context_get_tor_bootstrap_status(
     tego_tor_bootstrap_tag_t* out_tag,
     tego_error_t** error);
 
+// points during startup whose timing is tracked
+typedef enum
+{
+    tego_startup_milestone_tor_control_connected,
+    tego_startup_milestone_tor_bootstrapped,
+    tego_startup_milestone_onion_service_added,
+    tego_startup_milestone_onion_service_published,
+    tego_startup_milestone_count,
+} tego_startup_milestone_t;
+
+/*
+ * Get how long it took to reach a startup milestone, measured from the call
+ * to tego_context_start_tor; the milestones for the host's onion service
+ * refer to the primary identity
+ *
+ * @param context : the current tego context
+ * @param milestone : the milestone to query
+ * @param error : filled on error
+ * @return : elapsed milliseconds, or -1 if the milestone has not been reached
+ */
+int64_t tego_context_get_startup_milestone_elapsed(
+    const tego_context_t* context,
+    tego_startup_milestone_t milestone,
+    tego_error_t** error);
+
+/*
+ * Whether tor started with directory information cached in its data
+ * directory by a previous run (always true for an external tor), in which
+ * case it skips most of bootstrapping
+ *
+ * @param context : the current tego context
+ * @param error : filled on error
+ * @return : TEGO_TRUE if this was a warm start
+ */
+tego_bool_t tego_context_get_tor_warm_start(
+    const tego_context_t* context,
+    tego_error_t** error);
+
 //
 // Tego Chat Methods
 //
@@ -828,6 +1095,12 @@ void tego_context_get_tor_bootstrap_status(
 typedef uint64_t tego_time_t;
 // unique (per user) message identifier
 typedef uint32_t tego_message_id_t;
+// chat messages of up to this many characters can be sent to any peer
+#define TEGO_MESSAGE_MAX_SHORT_CHARACTERS 2000
+// largest long message size accepted by tego_context_set_max_message_size
+#define TEGO_MESSAGE_MAX_SIZE (16 * 1024 * 1024)
+// long message size limit used unless otherwise configured
+#define TEGO_MESSAGE_DEFAULT_MAX_SIZE (1024 * 1024)
 // unique (per user) file transfer identifier
 typedef uint32_t tego_file_transfer_id_t;
 // struct for file hash
@@ -835,6 +1108,14 @@ typedef struct tego_file_hash tego_file_hash_t;
 // integer type for file size
 typedef uint64_t tego_file_size_t;
 
+// smallest file transfer chunk size accepted by tego_context_set_file_transfer_chunk_size
+#define TEGO_FILE_TRANSFER_MIN_CHUNK_SIZE 1024
+// largest file transfer chunk size, a chunk plus its framing must fit in one
+// 65535 byte connection packet
+#define TEGO_FILE_TRANSFER_MAX_CHUNK_SIZE 65504
+// file transfer chunk size used unless otherwise configured
+#define TEGO_FILE_TRANSFER_DEFAULT_CHUNK_SIZE (63 * 1024)
+
 /*
  * Calculates the number of bytes needed to serialize a file hash to
  * a null-terminated utf8 string
@@ -868,6 +1149,12 @@ size_t tego_file_hash_to_string(
 /*
  * Send a text message from the host to the given user
  *
+ * Messages over TEGO_MESSAGE_MAX_SHORT_CHARACTERS characters are sent in
+ * fragments and acknowledged once, if the user's client supports long
+ * messages and accepts one of this size; clients that don't support them
+ * receive the message truncated. Messages larger than the limit set with
+ * tego_context_set_max_message_size are rejected
+ *
  * @param context : the current tego context
  * @param user : the user to send a message to
  * @param message : utf8 text message to send
@@ -883,6 +1170,26 @@ void tego_context_send_message(
     tego_message_id_t* out_id,
     tego_error_t** error);
 
+/*
+ * Send a text message from one of the host's identities to the given user
+ *
+ * @param context : the current tego context
+ * @param identity : the identity sending the message
+ * @param user : the user to send a message to
+ * @param message : utf8 text message to send
+ * @param messageLength : length of message not including null-terminator
+ * @param out_id : filled with assigned message id for callbacks
+ * @param error : filled on error
+ */
+void tego_context_identity_send_message(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* user,
+    const char* message,
+    size_t messageLength,
+    tego_message_id_t* out_id,
+    tego_error_t** error);
+
 /*
  * Request to send a file to the given user
  *
@@ -905,6 +1212,30 @@ void tego_context_send_file_transfer_request(
     tego_file_size_t* out_fileSize,
     tego_error_t** error);
 
+/*
+ * Request to send a file to the given user from one of the host's identities
+ *
+ * @param context : the current tego context
+ * @param identity : the identity sending the file
+ * @param user : the user to send a file to
+ * @param filePath : utf8 path to file to send
+ * @param filePathLength : length of filePath not including null-terminator
+ * @param out_id : optional, filled with assigned file transfer id for callbacks
+ * @param out_fileHash : optional, filled with hash of the file to send
+ * @param out_fileSize : optional, filled with the size of the file in bytes
+ * @param error : filled on error
+ */
+void tego_context_identity_send_file_transfer_request(
+    tego_context_t* context,
+    tego_identity_t identity,
+    tego_user_id_t const*  user,
+    char const* filePath,
+    size_t filePathLength,
+    tego_file_transfer_id_t* out_id,
+    tego_file_hash_t** out_fileHash,
+    tego_file_size_t* out_fileSize,
+    tego_error_t** error);
+
 typedef enum
 {
     tego_file_transfer_response_accept, // proceed with a file transfer
@@ -931,6 +1262,28 @@ void tego_context_respond_file_transfer_request(
     size_t destPathLength,
     tego_error_t** error);
 
+/*
+ * Acknowledges a request to send a file to one of the host's identities
+ *
+ * @param context : the current tego context
+ * @param identity : the identity the file transfer request was sent to
+ * @param user : the user that sent the file transfer request
+ * @param id : which file transfer to respond to
+ * @param response : how to respond to the request
+ * @param destPath : optional, destination to save the file
+ * @param destPathLength : length of destPath not including the null-terminator
+ * @param error : filled on error
+ */
+void tego_context_identity_respond_file_transfer_request(
+    tego_context_t* context,
+    tego_identity_t identity,
+    tego_user_id_t const* user,
+    tego_file_transfer_id_t id,
+    tego_file_transfer_response_t response,
+    char const* destPath,
+    size_t destPathLength,
+    tego_error_t** error);
+
 /*
  * Cancel an in-progress file transfer
  *
@@ -946,78 +1299,250 @@ void tego_context_cancel_file_transfer(
     tego_error_t** error);
 
 /*
- * Sends a request to chat to a user
+ * Cancel an in-progress file transfer of one of the host's identities
  *
  * @param context : the current tego context
- * @param user : the user we want to chat with
- * @param mesage : utf8 text greeting message to send
- * @param messageLength : length of message not including null-terminator
- * @param error : filled on error
+ * @param identity : the identity sending/receiving the transfer
+ * @param user : the user that is sending/receiving the transfer
+ * @param id : the file transfer to cancel
+ * @param error: filled on error
  */
-void tego_context_send_chat_request(
+void tego_context_identity_cancel_file_transfer(
     tego_context_t* context,
-    const tego_user_id_t* user,
-    const char* message,
-    size_t messageLength,
+    tego_identity_t identity,
+    tego_user_id_t const* user,
+    tego_file_transfer_id_t id,
     tego_error_t** error);
 
-typedef enum
-{
-    tego_chat_acknowledge_accept,   // allows the user to chat with us
-    tego_chat_acknowledge_reject,   // do not allow the user to chat with us
-    tego_chat_acknowledge_block,    // do not allow and reject all future requests
-} tego_chat_acknowledge_t;
-
 /*
- * Acknowledges chat request sent from another user. Would be called after receiving
- * a chat_request_received callback.
+ * Set the size of the chunks files are sent in. Larger chunks mean fewer
+ * packets and acknowledgements per transfer, smaller chunks mean finer
+ * grained progress and less head-of-line blocking for other channels on the
+ * same connection. Applies to file channels opened after this call. Peers
+ * which do not support raw file chunks are always sent protobuf framed chunks
+ * of at most TEGO_FILE_TRANSFER_DEFAULT_CHUNK_SIZE bytes
  *
  * @param context : the current tego context
- * @param user : the user that sent the chat request
- * @param response : how to respond to the request
+ * @param chunkSize : chunk size in bytes, between TEGO_FILE_TRANSFER_MIN_CHUNK_SIZE
+ *  and TEGO_FILE_TRANSFER_MAX_CHUNK_SIZE inclusive
  * @param error : filled on error
  */
-void tego_context_acknowledge_chat_request(
+void tego_context_set_file_transfer_chunk_size(
     tego_context_t* context,
-    const tego_user_id_t* user,
-    tego_chat_acknowledge_t response,
+    uint32_t chunkSize,
     tego_error_t** error);
 
 /*
- * Prevent the given user from message the host
+ * Set the size limit, in utf8 bytes, of long chat messages this client sends
+ * or accepts. Peers agree on the smaller of their two limits when their chat
+ * channels open, so this applies to chat channels opened after this call.
+ * A limit of 0 turns long messages off, limiting messages to
+ * TEGO_MESSAGE_MAX_SHORT_CHARACTERS characters
  *
  * @param context : the current tego context
- * @param user : the user to block
+ * @param maxSize : limit in bytes, at most TEGO_MESSAGE_MAX_SIZE
  * @param error : filled on error
  */
-void tego_context_block_user(
+void tego_context_set_max_message_size(
     tego_context_t* context,
-    const tego_user_id_t* user,
+    uint32_t maxSize,
     tego_error_t** error);
 
 /*
- * Forget about a given user, said user will be removed
- * from all internal lists and will be needed to be re-added
- * to chat
+ * Set whether chat text and file chunks may be compressed. Compression is
+ * only used with peers that support it, and only for data it actually
+ * shrinks. File hashes are always of the uncompressed file. Applies to chat
+ * and file channels opened after this call. Enabled by default
  *
  * @param context : the current tego context
- * @param user : the user to forget
+ * @param enabled : TEGO_TRUE to offer and accept compression, TEGO_FALSE to
+ *  send and accept uncompressed data only
  * @param error : filled on error
  */
-
-void tego_context_forget_user(
+void tego_context_set_payload_compression(
     tego_context_t* context,
-    const tego_user_id_t* user,
+    tego_bool_t enabled,
     tego_error_t** error);
 
-//
-// Callbacks for frontend to respond to events
-// Provides no guarantees on what thread they are running on or thread safety
-// All parameters (such as tego_error_t*) are automatically destroyed after user
-//  callback is invoked, so duplicate/marshall data as necessary
-//
+/*
+ * Keep each contact's queued and unacknowledged outgoing chat messages in an
+ * append-only log within directory, so they survive a restart. Messages left
+ * in a contact's log are queued again when the contact is loaded, keeping
+ * their message ids, and are sent once the contact comes online. Disabled by
+ * default. Must be called before tego_context_start_service to apply to the
+ * contacts it loads
+ *
+ * @param context : the current tego context
+ * @param directory : utf8 path of the directory to keep the logs in, or NULL
+ *  to disable the outbox for contacts loaded afterwards
+ * @param directoryLength : length of directory not including the null-terminator
+ * @param error : filled on error
+ */
+void tego_context_set_message_outbox_directory(
+    tego_context_t* context,
+    char const* directory,
+    size_t directoryLength,
+    tego_error_t** error);
 
-// TODO: remove the origin param once we better understand how errors are routed through the UI
+/*
+ * Export the conversation history with a user as a utf8 text log. The
+ * history is snapshotted and written out on a background thread, progress
+ * and completion are reported via the conversation_export_progress and
+ * conversation_export_complete callbacks
+ *
+ * @param context : the current tego context
+ * @param user : the user whose conversation to export
+ * @param destPath : utf8 path of the log file to write
+ * @param destPathLength : length of destPath not including the null-terminator
+ * @param error : filled on error
+ */
+void tego_context_export_conversation(
+    tego_context_t* context,
+    tego_user_id_t const* user,
+    char const* destPath,
+    size_t destPathLength,
+    tego_error_t** error);
+
+/*
+ * Export the conversation history between one of the host's identities and
+ * a user, see tego_context_export_conversation
+ *
+ * @param context : the current tego context
+ * @param identity : the identity whose conversation to export
+ * @param user : the user whose conversation to export
+ * @param destPath : utf8 path of the log file to write
+ * @param destPathLength : length of destPath not including the null-terminator
+ * @param error : filled on error
+ */
+void tego_context_identity_export_conversation(
+    tego_context_t* context,
+    tego_identity_t identity,
+    tego_user_id_t const* user,
+    char const* destPath,
+    size_t destPathLength,
+    tego_error_t** error);
+
+/*
+ * Sends a request to chat to a user
+ *
+ * @param context : the current tego context
+ * @param user : the user we want to chat with
+ * @param mesage : utf8 text greeting message to send
+ * @param messageLength : length of message not including null-terminator
+ * @param error : filled on error
+ */
+void tego_context_send_chat_request(
+    tego_context_t* context,
+    const tego_user_id_t* user,
+    const char* message,
+    size_t messageLength,
+    tego_error_t** error);
+
+/*
+ * Sends a request to chat to a user from one of the host's identities
+ *
+ * @param context : the current tego context
+ * @param identity : the identity sending the request
+ * @param user : the user we want to chat with
+ * @param mesage : utf8 text greeting message to send
+ * @param messageLength : length of message not including null-terminator
+ * @param error : filled on error
+ */
+void tego_context_identity_send_chat_request(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* user,
+    const char* message,
+    size_t messageLength,
+    tego_error_t** error);
+
+typedef enum
+{
+    tego_chat_acknowledge_accept,   // allows the user to chat with us
+    tego_chat_acknowledge_reject,   // do not allow the user to chat with us
+    tego_chat_acknowledge_block,    // do not allow and reject all future requests
+} tego_chat_acknowledge_t;
+
+/*
+ * Acknowledges chat request sent from another user. Would be called after receiving
+ * a chat_request_received callback.
+ *
+ * @param context : the current tego context
+ * @param user : the user that sent the chat request
+ * @param response : how to respond to the request
+ * @param error : filled on error
+ */
+void tego_context_acknowledge_chat_request(
+    tego_context_t* context,
+    const tego_user_id_t* user,
+    tego_chat_acknowledge_t response,
+    tego_error_t** error);
+
+/*
+ * Acknowledges a chat request sent to one of the host's identities
+ *
+ * @param context : the current tego context
+ * @param identity : the identity the chat request was sent to
+ * @param user : the user that sent the chat request
+ * @param response : how to respond to the request
+ * @param error : filled on error
+ */
+void tego_context_identity_acknowledge_chat_request(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* user,
+    tego_chat_acknowledge_t response,
+    tego_error_t** error);
+
+/*
+ * Prevent the given user from message the host
+ *
+ * @param context : the current tego context
+ * @param user : the user to block
+ * @param error : filled on error
+ */
+void tego_context_block_user(
+    tego_context_t* context,
+    const tego_user_id_t* user,
+    tego_error_t** error);
+
+/*
+ * Forget about a given user, said user will be removed
+ * from all internal lists and will be needed to be re-added
+ * to chat
+ *
+ * @param context : the current tego context
+ * @param user : the user to forget
+ * @param error : filled on error
+ */
+
+void tego_context_forget_user(
+    tego_context_t* context,
+    const tego_user_id_t* user,
+    tego_error_t** error);
+
+/*
+ * Forget about a given user of one of the host's identities
+ *
+ * @param context : the current tego context
+ * @param identity : the identity that should forget the user
+ * @param user : the user to forget
+ * @param error : filled on error
+ */
+void tego_context_identity_forget_user(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* user,
+    tego_error_t** error);
+
+//
+// Callbacks for frontend to respond to events
+// Provides no guarantees on what thread they are running on or thread safety
+// All parameters (such as tego_error_t*) are automatically destroyed after user
+//  callback is invoked, so duplicate/marshall data as necessary
+//
+
+// TODO: remove the origin param once we better understand how errors are routed through the UI
 // temporarily used by the error callback
 typedef enum
 {
@@ -1114,6 +1639,19 @@ typedef void (*tego_host_onion_service_state_changed_callback_t)(
     tego_context_t* context,
     tego_host_onion_service_state_t state);
 
+/*
+ * Callback fired when the onion service state of any hosted identity
+ * changes, including the primary identity
+ *
+ * @param context : the current tego context
+ * @param identity : the identity whose state changed
+ * @param state : the identity's current onion service state
+ */
+typedef void (*tego_identity_onion_service_state_changed_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    tego_host_onion_service_state_t state);
+
 /*
  * Callback fired when the host receives a chat request from another user
  *
@@ -1128,6 +1666,23 @@ typedef void (*tego_chat_request_received_callback_t)(
     const char* message,
     size_t messageLength);
 
+/*
+ * Identity-aware variant of tego_chat_request_received_callback_t, fired for
+ * the users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param sender : the user that wants to chat
+ * @param message : null-terminated message string received from the requesting user
+ * @param messageLength : length of the message not including null-terminator
+ */
+typedef void (*tego_identity_chat_request_received_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* sender,
+    const char* message,
+    size_t messageLength);
+
 /*
  * Callback fired when the host receives a response to their sent chat request
  *
@@ -1141,6 +1696,21 @@ typedef void (*tego_chat_request_response_received_callback_t)(
     const tego_user_id_t* sender,
     tego_bool_t acceptedRequest);
 
+/*
+ * Identity-aware variant of tego_chat_request_response_received_callback_t,
+ * fired for the users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param sender : the user responding to our chat request
+ * @param acceptedRequest : TEGO_TRUE if request accepted, TEGO_FALSE if rejected
+ */
+typedef void (*tego_identity_chat_request_response_received_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* sender,
+    tego_bool_t acceptedRequest);
+
 
 /*
  * Callback fired when the host receives a message from another user
@@ -1160,6 +1730,27 @@ typedef void (*tego_message_received_callback_t)(
     const char* message,
     size_t messageLength);
 
+/*
+ * Identity-aware variant of tego_message_received_callback_t, fired for the
+ * users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param sender : the user that sent host the message
+ * @param timestamp : the time the message was sent
+ * @param messageId : id of the message received
+ * @param message : null-terminated message string
+ * @param messageLength : length of the message not including null-terminator
+ */
+typedef void (*tego_identity_message_received_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* sender,
+    tego_time_t timestamp,
+    tego_message_id_t messageId,
+    const char* message,
+    size_t messageLength);
+
 /*
  * Callback fired when a chat message is received and acknowledge
  * by the recipient
@@ -1175,6 +1766,23 @@ typedef void (*tego_message_acknowledged_callback_t)(
     tego_message_id_t messageId,
     tego_bool_t messageAcked);
 
+/*
+ * Identity-aware variant of tego_message_acknowledged_callback_t, fired for
+ * the users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param userId : the user the message was sent to
+ * @param messageId : id of the message being acknowledged
+ * @param messageAcked : TEGO_TRUE if acknowledged, TEGO_FALSE if error
+ */
+typedef void (*tego_identity_message_acknowledged_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* userId,
+    tego_message_id_t messageId,
+    tego_bool_t messageAcked);
+
 
 /*
  * Callback fired when a user wants to send recipient a file
@@ -1196,6 +1804,29 @@ typedef void (*tego_file_transfer_request_received_callback_t)(
     tego_file_size_t fileSize,
     tego_file_hash_t const* fileHash);
 
+/*
+ * Identity-aware variant of tego_file_transfer_request_received_callback_t,
+ * fired for the users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param sender : the user sending the request
+ * @param id : id of the file transfer received
+ * @param fileName : name of the file user wants to send
+ * @param fileNameLength : length of fileName not including the null-terminator
+ * @param fileSize : size of the file in bytes
+ * @param fileHash : hash of the file
+ */
+typedef void (*tego_identity_file_transfer_request_received_callback_t)(
+    tego_context* context,
+    tego_identity_t identity,
+    tego_user_id_t const* sender,
+    tego_file_transfer_id_t id,
+    char const* fileName,
+    size_t fileNameLength,
+    tego_file_size_t fileSize,
+    tego_file_hash_t const* fileHash);
+
 /*
  * Callback fired when a file transfer request message is received and
  * acknowledged by the recipient (not whether the recipient wishes to start
@@ -1212,6 +1843,24 @@ typedef void (*tego_file_transfer_request_acknowledged_callback_t)(
     tego_file_transfer_id_t id,
     tego_bool_t requestAcked);
 
+/*
+ * Identity-aware variant of
+ * tego_file_transfer_request_acknowledged_callback_t, fired for the users of
+ * every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param receiver : the user acknowledging our request
+ * @param id : the id of the file transfer that is being acknowledged
+ * @param requestAcked : TEGO_TRUE if acknowledged, TEGO_FALSE if error
+ */
+typedef void (*tego_identity_file_transfer_request_acknowledged_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    tego_user_id_t const* receiver,
+    tego_file_transfer_id_t id,
+    tego_bool_t requestAcked);
+
 /*
  * Callback fired when the user responds to an file transfer request
  *
@@ -1227,6 +1876,25 @@ typedef void (*tego_file_transfer_request_response_received_callback_t)(
     tego_file_transfer_id_t id,
     tego_file_transfer_response_t response);
 
+/*
+ * Identity-aware variant of
+ * tego_file_transfer_request_response_received_callback_t, fired for the
+ * users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param receiver : the user accepting or rejecting our request
+ * @param id : the id of the file transfer that is being accepted
+ * @param response : TEGO_TRUE if the recipients wants to recevie
+ *  our file, TEGO_FALSE otherwise
+ */
+typedef void (*tego_identity_file_transfer_request_response_received_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    tego_user_id_t const* receiver,
+    tego_file_transfer_id_t id,
+    tego_file_transfer_response_t response);
+
 typedef enum
 {
     tego_file_transfer_direction_sending,
@@ -1252,6 +1920,27 @@ typedef void (*tego_file_transfer_progress_callback_t)(
     tego_file_size_t bytesComplete,
     tego_file_size_t bytesTotal);
 
+/*
+ * Identity-aware variant of tego_file_transfer_progress_callback_t, fired
+ * for the users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param userId : the user sending/receiving the file
+ * @param id : the file transfer associated with this callback
+ * @param direction : the direction this file is going
+ * @param bytesComplete : number of bytes sent/received
+ * @param bytesTotal : the total size of the file
+ */
+typedef void (*tego_identity_file_transfer_progress_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* userId,
+    tego_file_transfer_id_t id,
+    tego_file_transfer_direction_t direction,
+    tego_file_size_t bytesComplete,
+    tego_file_size_t bytesTotal);
+
 typedef enum
 {
     tego_file_transfer_result_success,          // file transfer completed successfully
@@ -1280,6 +1969,25 @@ typedef void (*tego_file_transfer_complete_callback_t)(
     tego_file_transfer_direction_t direction,
     tego_file_transfer_result_t result);
 
+/*
+ * Identity-aware variant of tego_file_transfer_complete_callback_t, fired
+ * for the users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param userId : the user sending/receivintg the file
+ * @param id : the file transfer associated with this callback
+ * @param direction : the direction this file was going
+ * @param result : how the transfer completed
+ */
+typedef void (*tego_identity_file_transfer_complete_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* userId,
+    tego_file_transfer_id_t id,
+    tego_file_transfer_direction_t direction,
+    tego_file_transfer_result_t result);
+
 /*
  * Callback fired when a user's status changes
  *
@@ -1292,6 +2000,21 @@ typedef void (*tego_user_status_changed_callback_t)(
     const tego_user_id_t* user,
     tego_user_status_t status);
 
+/*
+ * Identity-aware variant of tego_user_status_changed_callback_t, fired for
+ * the users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param user : the user whose status has changed
+ * @param status: the user's new status
+ */
+typedef void (*tego_identity_user_status_changed_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* user,
+    tego_user_status_t status);
+
 /*
  * Callback fired when tor creates a new onion service for
  * the host
@@ -1303,6 +2026,64 @@ typedef void (*tego_new_identity_created_callback_t)(
     tego_context_t* context,
     const tego_ed25519_private_key_t* privateKey);
 
+/*
+ * Callback fired as a conversation export makes progress
+ *
+ * @param context : the current tego context
+ * @param user : the user whose conversation is being exported
+ * @param entriesWritten : number of conversation entries written so far
+ * @param entriesTotal : total number of entries being exported
+ */
+typedef void (*tego_conversation_export_progress_callback_t)(
+    tego_context_t* context,
+    const tego_user_id_t* user,
+    size_t entriesWritten,
+    size_t entriesTotal);
+
+/*
+ * Identity-aware variant of tego_conversation_export_progress_callback_t,
+ * fired for the users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param user : the user whose conversation is being exported
+ * @param entriesWritten : number of conversation entries written so far
+ * @param entriesTotal : total number of entries being exported
+ */
+typedef void (*tego_identity_conversation_export_progress_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* user,
+    size_t entriesWritten,
+    size_t entriesTotal);
+
+/*
+ * Callback fired when a conversation export has finished
+ *
+ * @param context : the current tego context
+ * @param user : the user whose conversation was exported
+ * @param success : TEGO_TRUE if the whole log was written, TEGO_FALSE on error
+ */
+typedef void (*tego_conversation_export_complete_callback_t)(
+    tego_context_t* context,
+    const tego_user_id_t* user,
+    tego_bool_t success);
+
+/*
+ * Identity-aware variant of tego_conversation_export_complete_callback_t,
+ * fired for the users of every hosted identity including the primary one
+ *
+ * @param context : the current tego context
+ * @param identity : the host identity the user is a contact of
+ * @param user : the user whose conversation was exported
+ * @param success : TEGO_TRUE if the whole log was written, TEGO_FALSE on error
+ */
+typedef void (*tego_identity_conversation_export_complete_callback_t)(
+    tego_context_t* context,
+    tego_identity_t identity,
+    const tego_user_id_t* user,
+    tego_bool_t success);
+
 /*
  * Setters for various callbacks
  */
@@ -1347,61 +2128,136 @@ void tego_context_set_host_onion_service_state_changed_callback(
     tego_host_onion_service_state_changed_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_onion_service_state_changed_callback(
+    tego_context_t* context,
+    tego_identity_onion_service_state_changed_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_chat_request_received_callback(
     tego_context_t* context,
     tego_chat_request_received_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_chat_request_received_callback(
+    tego_context_t* context,
+    tego_identity_chat_request_received_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_chat_request_response_received_callback(
     tego_context_t* context,
     tego_chat_request_response_received_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_chat_request_response_received_callback(
+    tego_context_t* context,
+    tego_identity_chat_request_response_received_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_message_received_callback(
     tego_context_t* context,
     tego_message_received_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_message_received_callback(
+    tego_context_t* context,
+    tego_identity_message_received_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_message_acknowledged_callback(
     tego_context_t* context,
     tego_message_acknowledged_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_message_acknowledged_callback(
+    tego_context_t* context,
+    tego_identity_message_acknowledged_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_file_transfer_request_received_callback(
     tego_context_t* context,
     tego_file_transfer_request_received_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_file_transfer_request_received_callback(
+    tego_context_t* context,
+    tego_identity_file_transfer_request_received_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_file_transfer_request_acknowledged_callback(
     tego_context_t* context,
     tego_file_transfer_request_acknowledged_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_file_transfer_request_acknowledged_callback(
+    tego_context_t* context,
+    tego_identity_file_transfer_request_acknowledged_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_file_transfer_request_response_received_callback(
     tego_context_t* context,
     tego_file_transfer_request_response_received_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_file_transfer_request_response_received_callback(
+    tego_context_t* context,
+    tego_identity_file_transfer_request_response_received_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_file_transfer_progress_callback(
     tego_context_t* context,
     tego_file_transfer_progress_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_file_transfer_progress_callback(
+    tego_context_t* context,
+    tego_identity_file_transfer_progress_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_file_transfer_complete_callback(
     tego_context_t* context,
     tego_file_transfer_complete_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_file_transfer_complete_callback(
+    tego_context_t* context,
+    tego_identity_file_transfer_complete_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_user_status_changed_callback(
     tego_context_t* context,
     tego_user_status_changed_callback_t,
     tego_error_t** error);
 
+void tego_context_set_identity_user_status_changed_callback(
+    tego_context_t* context,
+    tego_identity_user_status_changed_callback_t,
+    tego_error_t** error);
+
 void tego_context_set_new_identity_created_callback(
     tego_context_t* context,
     tego_new_identity_created_callback_t,
     tego_error_t** error);
 
+void tego_context_set_conversation_export_progress_callback(
+    tego_context_t* context,
+    tego_conversation_export_progress_callback_t,
+    tego_error_t** error);
+
+void tego_context_set_identity_conversation_export_progress_callback(
+    tego_context_t* context,
+    tego_identity_conversation_export_progress_callback_t,
+    tego_error_t** error);
+
+void tego_context_set_conversation_export_complete_callback(
+    tego_context_t* context,
+    tego_conversation_export_complete_callback_t,
+    tego_error_t** error);
+
+void tego_context_set_identity_conversation_export_complete_callback(
+    tego_context_t* context,
+    tego_identity_conversation_export_complete_callback_t,
+    tego_error_t** error);
+
 
 /*
  Destructors for various tego types
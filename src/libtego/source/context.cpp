@@ -4,6 +4,7 @@
 #include "tor.hpp"
 #include "user.hpp"
 #include "ed25519.hpp"
+#include "tor_log.hpp"
 
 using tego::g_globals;
 
@@ -14,6 +15,7 @@ using tego::g_globals;
 #include "core/ContactUser.h"
 #include "core/ConversationModel.h"
 #include "utils/SecureRNG.h"
+#include "utils/CryptoKey.h"
 
 //
 // Tego Context
@@ -26,6 +28,7 @@ tego_context::tego_context()
 {
     this->torManager = Tor::TorManager::instance();
     this->torControl = torManager->control();
+    this->startupMilestones.fill(-1);
 }
 
 void tego_context::start_tor(const tego_tor_launch_config_t* config)
@@ -34,37 +37,59 @@ void tego_context::start_tor(const tego_tor_launch_config_t* config)
     TEGO_THROW_IF_NULL(config);
 
     this->torManager->setDataDirectory(config->dataDirectory.data());
+    if (!config->controlSocketPath.empty())
+    {
+        this->torManager->setExternalControlSocket(QString::fromStdString(config->controlSocketPath));
+    }
+    else if (config->controlPort != 0)
+    {
+        this->torManager->setExternalControlPort(QHostAddress(QString::fromStdString(config->controlAddress)), config->controlPort);
+    }
+    if (!config->controlPassword.empty())
+    {
+        this->torManager->setExternalControlPassword(QByteArray::fromStdString(config->controlPassword));
+    }
+    this->torManager->setUnixSocketsEnabled(config->unixSockets);
+
+    this->startupMilestones.fill(-1);
+    this->startupTimer.start();
     this->torManager->start();
 }
 
-size_t tego_context::get_tor_logs_size() const
+void tego_context::record_startup_milestone(tego_startup_milestone_t milestone)
 {
-    size_t retval = 0;
-    for(const auto& msg : this->get_tor_logs())
+    TEGO_THROW_IF_FALSE(milestone >= 0 && milestone < tego_startup_milestone_count);
+
+    auto& elapsed = this->startupMilestones[static_cast<size_t>(milestone)];
+    if (elapsed >= 0 || !this->startupTimer.isValid())
+    {
+        return;
+    }
+    elapsed = this->startupTimer.elapsed();
+
+    if (milestone == tego_startup_milestone_onion_service_published)
     {
-        retval += msg.size() + 1;
+        logger::println("startup: onion service published {} ms after starting tor ({} start)",
+            elapsed, this->get_tor_warm_start() ? "warm" : "cold");
     }
-    return retval;
 }
 
-const std::vector<std::string>& tego_context::get_tor_logs() const
+int64_t tego_context::get_startup_milestone_elapsed(tego_startup_milestone_t milestone) const
 {
-    TEGO_THROW_IF_NULL(this->torManager);
-
-    auto logMessages = this->torManager->logMessages();
-    TEGO_THROW_IF_FALSE(logMessages.size() >= 0);
+    TEGO_THROW_IF_FALSE(milestone >= 0 && milestone < tego_startup_milestone_count);
+    return this->startupMilestones[static_cast<size_t>(milestone)];
+}
 
-    // see if we need to update our local copy
-    if(static_cast<size_t>(logMessages.size()) != this->torLogs.size())
-    {
-        for(size_t i = this->torLogs.size(); i < static_cast<size_t>(logMessages.size()); i++)
-        {
-            TEGO_THROW_IF_FALSE(i < std::numeric_limits<int>::max());
-            this->torLogs.push_back(logMessages[static_cast<int>(i)].toStdString());
-        }
-    }
+bool tego_context::get_tor_warm_start() const
+{
+    TEGO_THROW_IF_NULL(this->torManager);
+    return this->torManager->isWarmStart();
+}
 
-    return this->torLogs;
+const tego::tor_log_buffer& tego_context::get_tor_logs() const
+{
+    TEGO_THROW_IF_NULL(this->torManager);
+    return this->torManager->logBuffer();
 }
 
 const char* tego_context::get_tor_version_string() const
@@ -182,6 +207,28 @@ void tego_context::start_service(
     tego_user_id_t const* const* userBuffer,
     tego_user_type_t* const userTypeBuffer,
     size_t userCount)
+{
+    this->startIdentity(hostPrivateKey, userBuffer, userTypeBuffer, userCount);
+}
+
+tego_identity_t tego_context::add_identity(
+    tego_ed25519_private_key_t const* hostPrivateKey,
+    tego_user_id_t const* const* userBuffer,
+    tego_user_type_t* const userTypeBuffer,
+    size_t userCount)
+{
+    // additional identities share the primary identity's tor instance
+    TEGO_THROW_IF_NULL(this->identityManager);
+
+    auto userIdentity = this->startIdentity(hostPrivateKey, userBuffer, userTypeBuffer, userCount);
+    return static_cast<tego_identity_t>(userIdentity->uniqueID);
+}
+
+UserIdentity* tego_context::startIdentity(
+    tego_ed25519_private_key_t const* hostPrivateKey,
+    tego_user_id_t const* const* userBuffer,
+    tego_user_type_t* const userTypeBuffer,
+    size_t userCount)
 {
     TEGO_THROW_IF_NULL(hostPrivateKey);
     if (userCount > 0)
@@ -242,9 +289,23 @@ void tego_context::start_service(
         }
     }
 
-    // save off the singleton on our context
-    this->identityManager = new IdentityManager(keyBlob);
-    auto userIdentity = this->identityManager->identities().first();
+    // the first identity saves off the singleton on our context, any
+    // further identities are hosted alongside it
+    UserIdentity* userIdentity = nullptr;
+    if (this->identityManager == nullptr)
+    {
+        this->identityManager = new IdentityManager(keyBlob);
+        userIdentity = this->identityManager->identities().first();
+    }
+    else
+    {
+        // refuse to host the same service twice
+        CryptoKey key;
+        TEGO_THROW_IF_FALSE(key.loadFromKeyBlob(keyBlob.toUtf8()));
+        TEGO_THROW_IF_NOT_NULL(this->identityManager->lookupHostname(QString::fromLatin1(key.torServiceID())));
+
+        userIdentity = this->identityManager->createIdentity(keyBlob);
+    }
     auto contactsManager = userIdentity->getContacts();
 
     contactsManager->addAllowedContacts(allowedUsers);
@@ -252,6 +313,8 @@ void tego_context::start_service(
     contactsManager->addRejectedIncomingRequests(blockedUsers);
     contactsManager->addOutgoingRequests(pendingUsers);
     contactsManager->addRejectedOutgoingRequests(rejectedUsers);
+
+    return userIdentity;
 }
 
 void tego_context::start_service()
@@ -270,6 +333,14 @@ int32_t tego_context::get_tor_bootstrap_progress() const
 void tego_context::update_tor_daemon_config(const tego_tor_daemon_config_t* daemonConfig)
 {
     TEGO_THROW_IF_NULL(this->torControl);
+    TEGO_THROW_IF_NULL(this->torManager);
+
+    // a shared tor's configuration belongs to whoever runs it
+    if (this->torManager->isExternal())
+    {
+        this->callback_registry_.emit_update_tor_daemon_config_succeeded(TEGO_TRUE);
+        return;
+    }
 
     const auto& config = *daemonConfig;
 
@@ -359,6 +430,12 @@ void tego_context::update_tor_daemon_config(const tego_tor_daemon_config_t* daem
 
 void tego_context::update_disable_network_flag(bool disableNetwork)
 {
+    TEGO_THROW_IF_NULL(this->torManager);
+    if (this->torManager->isExternal())
+    {
+        return;
+    }
+
     QVariantMap vm;
     vm["DisableNetwork"] = (disableNetwork ? "1" : "0");
 
@@ -373,13 +450,54 @@ void tego_context::set_host_onion_service_state(tego_host_onion_service_state_t
     }
 
     this->hostUserState = state;
+    switch(state)
+    {
+        case tego_host_onion_service_state_service_added:
+            this->record_startup_milestone(tego_startup_milestone_onion_service_added);
+            break;
+        case tego_host_onion_service_state_service_published:
+            this->record_startup_milestone(tego_startup_milestone_onion_service_published);
+            break;
+        default:
+            break;
+    }
     this->callback_registry_.emit_host_onion_service_state_changed(state);
 }
 
-std::unique_ptr<tego_user_id_t> tego_context::get_host_user_id() const
+void tego_context::set_host_onion_service_state(Tor::HiddenService const* service, tego_host_onion_service_state_t state)
 {
-    TEGO_THROW_IF_NULL(this->identityManager);
-    auto userIdentity = this->identityManager->identities().first();
+    // invoked from tor signal handlers, so quietly ignore services we don't know
+    if (service == nullptr || this->identityManager == nullptr)
+    {
+        return;
+    }
+
+    for (auto userIdentity : this->identityManager->identities())
+    {
+        if (userIdentity->hiddenService() != service)
+        {
+            continue;
+        }
+
+        const auto identity = userIdentity->toTegoIdentity();
+        if (identity == TEGO_PRIMARY_IDENTITY)
+        {
+            this->set_host_onion_service_state(state);
+        }
+
+        auto& identityState = this->identityStates[identity];
+        if (identityState != state)
+        {
+            identityState = state;
+            this->callback_registry_.emit_identity_onion_service_state_changed(identity, state);
+        }
+        return;
+    }
+}
+
+std::unique_ptr<tego_user_id_t> tego_context::get_host_user_id(tego_identity_t identity) const
+{
+    auto userIdentity = this->getUserIdentity(identity);
 
     auto hostname = userIdentity->hostname().toUtf8();
     tego_v3_onion_service_id serviceId(hostname.data(), TEGO_V3_ONION_SERVICE_ID_LENGTH);
@@ -392,13 +510,22 @@ tego_host_onion_service_state_t tego_context::get_host_onion_service_state() con
     return this->hostUserState;
 }
 
+tego_host_onion_service_state_t tego_context::get_host_onion_service_state(tego_identity_t identity) const
+{
+    // throws on unknown identities
+    this->getUserIdentity(identity);
+
+    auto it = this->identityStates.find(identity);
+    return it == this->identityStates.end() ? tego_host_onion_service_state_none : it->second;
+}
+
 void tego_context::send_chat_request(
+    tego_identity_t identity,
     const tego_user_id_t* user,
     const char* message,
     size_t messageLength)
 {
-    TEGO_THROW_IF_NULL(this->identityManager);
-    auto userIdentity = this->identityManager->identities().first();
+    auto userIdentity = this->getUserIdentity(identity);
     auto contactsManager = userIdentity->getContacts();
 
     TEGO_THROW_IF_FALSE(messageLength < std::numeric_limits<int>::max());
@@ -408,6 +535,7 @@ void tego_context::send_chat_request(
 }
 
 void tego_context::acknowledge_chat_request(
+        tego_identity_t identity,
         const tego_user_id_t* user,
         tego_chat_acknowledge_t response)
 {
@@ -416,8 +544,7 @@ void tego_context::acknowledge_chat_request(
     logger::println("ack chat request from {}", user->serviceId.data);
     logger::println("response : {}", static_cast<int>(response));
 
-    TEGO_THROW_IF_NULL(this->identityManager);
-    auto userIdentity = this->identityManager->identities().first();
+    auto userIdentity = this->getUserIdentity(identity);
     auto contactsManager = userIdentity->getContacts();
     auto incomingRequestManager = contactsManager->incomingRequestManager();
 
@@ -442,22 +569,25 @@ void tego_context::acknowledge_chat_request(
 }
 
 tego_message_id_t tego_context::send_message(
+    tego_identity_t identity,
     const tego_user_id_t* user,
     const std::string& message)
 {
     TEGO_THROW_IF_NULL(user);
     TEGO_THROW_IF_FALSE(message.size() > 0)
+    TEGO_THROW_IF_FALSE_MSG(this->maxMessageSize == 0 || message.size() <= this->maxMessageSize,
+        "message of {} bytes is larger than the limit of {} bytes", message.size(), this->maxMessageSize);
 
-    auto contactUser = getContactUser(user);
+    auto contactUser = getContactUser(identity, user);
     TEGO_THROW_IF_NULL(contactUser);
     auto conversationModel = contactUser->conversation();
 
     return conversationModel->sendMessage(QString::fromStdString(message));
 }
 
-tego_user_type_t tego_context::get_user_type(tego_user_id_t const* user) const
+tego_user_type_t tego_context::get_user_type(tego_identity_t identity, tego_user_id_t const* user) const
 {
-    auto contactUser = this->getContactUser(user);
+    auto contactUser = this->getContactUser(identity, user);
     if (contactUser != nullptr)
     {
         auto const status = contactUser->status();
@@ -477,7 +607,7 @@ tego_user_type_t tego_context::get_user_type(tego_user_id_t const* user) const
     }
 
     // next check for requesting users
-    auto userIdentity = this->identityManager->identities().first();
+    auto userIdentity = this->getUserIdentity(identity);
     auto contactsManager = userIdentity->getContacts();
     auto incomingRequestManager = contactsManager->incomingRequestManager();
 
@@ -505,19 +635,17 @@ tego_user_type_t tego_context::get_user_type(tego_user_id_t const* user) const
     TEGO_THROW_MSG("Unknown user with service id : '{}'", user->serviceId.data);
 }
 
-size_t tego_context::get_user_count() const
+size_t tego_context::get_user_count(tego_identity_t identity) const
 {
-    TEGO_THROW_IF_NULL(this->identityManager);
-    auto userIdentity = this->identityManager->identities().first();
+    auto userIdentity = this->getUserIdentity(identity);
     auto contactsManager = userIdentity->getContacts();
 
     return static_cast<size_t>(contactsManager->contacts().size());
 }
 
-std::vector<tego_user_id_t*> tego_context::get_users() const
+std::vector<tego_user_id_t*> tego_context::get_users(tego_identity_t identity) const
 {
-    TEGO_THROW_IF_NULL(this->identityManager);
-    auto userIdentity = this->identityManager->identities().first();
+    auto userIdentity = this->getUserIdentity(identity);
     auto contactsManager = userIdentity->getContacts();
     auto incomingRequestManager = contactsManager->incomingRequestManager();
 
@@ -573,21 +701,22 @@ std::vector<tego_user_id_t*> tego_context::get_users() const
     return users;
 }
 
-void tego_context::forget_user(const tego_user_id_t* user)
+void tego_context::forget_user(tego_identity_t identity, const tego_user_id_t* user)
 {
     // TODO: does not handle our blocked users or incoming request users
-    auto contactUser = this->getContactUser(user);
+    auto contactUser = this->getContactUser(identity, user);
     TEGO_THROW_IF_NULL(contactUser);
     contactUser->deleteContact();
 }
 
 std::tuple<tego_file_transfer_id_t, std::unique_ptr<tego_file_hash_t>, tego_file_size_t> tego_context::send_file_transfer_request(
+    tego_identity_t identity,
     tego_user_id_t const* user,
     std::string const& filePath)
 {
     TEGO_THROW_IF_NULL(user);
 
-    auto contactUser = this->getContactUser(user);
+    auto contactUser = this->getContactUser(identity, user);
     TEGO_THROW_IF_NULL(contactUser);
     auto conversationModel = contactUser->conversation();
 
@@ -595,6 +724,7 @@ std::tuple<tego_file_transfer_id_t, std::unique_ptr<tego_file_hash_t>, tego_file
 }
 
 void tego_context::respond_file_transfer_request(
+    tego_identity_t identity,
     tego_user_id_t const* user,
     tego_file_transfer_id_t fileTransfer,
     tego_file_transfer_response_t response,
@@ -608,7 +738,7 @@ void tego_context::respond_file_transfer_request(
     // ensure non-empty dest path in case we are accepting
     TEGO_THROW_IF_TRUE(response == tego_file_transfer_response_accept && destPath.empty())
 
-    auto contactUser = this->getContactUser(user);
+    auto contactUser = this->getContactUser(identity, user);
     TEGO_THROW_IF_NULL(contactUser);
     auto conversationModel = contactUser->conversation();
 
@@ -628,29 +758,147 @@ void tego_context::respond_file_transfer_request(
 }
 
 void tego_context::cancel_file_transfer_transfer(
+    tego_identity_t identity,
     tego_user_id_t const* user,
     tego_file_transfer_id_t fileTransfer)
 {
     // ensure we have a valid user
     TEGO_THROW_IF_NULL(user);
 
-    auto contactUser = this->getContactUser(user);
+    auto contactUser = this->getContactUser(identity, user);
     TEGO_THROW_IF_NULL(contactUser);
     auto conversationModel = contactUser->conversation();
 
     conversationModel->cancelTransfer(fileTransfer);
 }
 
+void tego_context::set_file_transfer_chunk_size(uint32_t chunkSize)
+{
+    TEGO_THROW_IF_FALSE_MSG(
+        chunkSize >= TEGO_FILE_TRANSFER_MIN_CHUNK_SIZE && chunkSize <= TEGO_FILE_TRANSFER_MAX_CHUNK_SIZE,
+        "chunkSize must be between {} and {} bytes", TEGO_FILE_TRANSFER_MIN_CHUNK_SIZE, TEGO_FILE_TRANSFER_MAX_CHUNK_SIZE);
+    this->fileTransferChunkSize = chunkSize;
+}
+
+uint32_t tego_context::get_file_transfer_chunk_size() const
+{
+    return this->fileTransferChunkSize;
+}
+
+void tego_context::set_max_message_size(uint32_t maxSize)
+{
+    TEGO_THROW_IF_FALSE_MSG(maxSize <= TEGO_MESSAGE_MAX_SIZE,
+        "maxSize must be at most {} bytes", TEGO_MESSAGE_MAX_SIZE);
+    this->maxMessageSize = maxSize;
+}
+
+uint32_t tego_context::get_max_message_size() const
+{
+    return this->maxMessageSize;
+}
+
+void tego_context::set_payload_compression(bool enabled)
+{
+    this->payloadCompression = enabled;
+}
+
+bool tego_context::get_payload_compression() const
+{
+    return this->payloadCompression;
+}
+
+void tego_context::set_message_outbox_directory(std::string const& directory)
+{
+    auto path = QString::fromStdString(directory);
+    if (!path.isEmpty()) {
+        TEGO_THROW_IF_FALSE_MSG(QDir().mkpath(path), "Could not create message outbox directory {}", directory);
+        path = QDir(path).absolutePath();
+    }
+    this->messageOutboxDirectory = path;
+}
+
+QString tego_context::get_message_outbox_directory() const
+{
+    return this->messageOutboxDirectory;
+}
+
+bool tego_context::is_known_contact(QString const& serverHostname, QString const& hostname) const
+{
+    if (identityManager == nullptr)
+        return false;
+
+    auto userIdentity = identityManager->lookupHostname(serverHostname);
+    return userIdentity != nullptr && userIdentity->getContacts()->lookupHostname(hostname) != nullptr;
+}
+
+void tego_context::export_conversation(
+    tego_identity_t identity,
+    tego_user_id_t const* user,
+    std::string const& destPath)
+{
+    TEGO_THROW_IF_NULL(user);
+    TEGO_THROW_IF_TRUE(destPath.empty());
+
+    auto contactUser = this->getContactUser(identity, user);
+    TEGO_THROW_IF_NULL(contactUser);
+    auto conversationModel = contactUser->conversation();
+
+    // callbacks are emitted from the export's worker thread, so each one
+    // gets its own copy of the user id
+    auto progress = [this, identity, userId = *user](size_t entriesWritten, size_t entriesTotal) -> void
+    {
+        this->callback_registry_.emit_conversation_export_progress(
+            identity,
+            std::make_unique<tego_user_id_t>(userId).release(),
+            entriesWritten,
+            entriesTotal);
+    };
+    auto complete = [this, identity, userId = *user](bool success) -> void
+    {
+        this->callback_registry_.emit_conversation_export_complete(
+            identity,
+            std::make_unique<tego_user_id_t>(userId).release(),
+            success ? TEGO_TRUE : TEGO_FALSE);
+
+        // the exporter is marked finished before this handler runs, so it can
+        // be reaped on the context's thread once control returns there
+        QMetaObject::invokeMethod(this->torManager, []() -> void
+        {
+            if (auto context = g_globals.context.get(); context != nullptr)
+            {
+                context->conversationExports.remove_if([](const auto& exporter) -> bool
+                {
+                    return exporter->finished();
+                });
+            }
+        }, Qt::QueuedConnection);
+    };
+
+    auto exporter = conversationModel->exportConversation(destPath, std::move(progress), std::move(complete));
+    exporter->start();
+    this->conversationExports.push_back(std::move(exporter));
+}
+
 //
 // tego_context private methods
 //
 
-ContactUser* tego_context::getContactUser(tego_user_id_t const* user) const
+UserIdentity* tego_context::getUserIdentity(tego_identity_t identity) const
 {
-    TEGO_THROW_IF_NULL(user);
     TEGO_THROW_IF_NULL(identityManager);
+    TEGO_THROW_IF_FALSE(identity <= static_cast<tego_identity_t>(std::numeric_limits<int>::max()));
+
+    auto userIdentity = identityManager->lookupUniqueID(static_cast<int>(identity));
+    TEGO_THROW_IF_NULL(userIdentity);
+
+    return userIdentity;
+}
+
+ContactUser* tego_context::getContactUser(tego_identity_t identity, tego_user_id_t const* user) const
+{
+    TEGO_THROW_IF_NULL(user);
 
-    auto contactsManager = identityManager->identities().first()->getContacts();
+    auto contactsManager = this->getUserIdentity(identity)->getContacts();
     auto contactUser = contactsManager->lookupHostname(
         QString::fromUtf8(
             user->serviceId.data,
@@ -747,21 +995,40 @@ extern "C"
     size_t tego_context_get_tor_logs_size(
         const tego_context_t* context,
         tego_error_t** error)
+    {
+        return tego_context_get_tor_logs_since_size(context, 0, error);
+    }
+
+    size_t tego_context_get_tor_logs(
+        const tego_context_t* context,
+        char* out_logBuffer,
+        size_t logBufferSize,
+        tego_error_t** error)
+    {
+        return tego_context_get_tor_logs_since(context, 0, out_logBuffer, logBufferSize, nullptr, error);
+    }
+
+    size_t tego_context_get_tor_logs_since_size(
+        const tego_context_t* context,
+        uint64_t sequence,
+        tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> size_t
         {
             TEGO_THROW_IF_NULL(context);
             TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
 
-            return context->get_tor_logs_size();
+            // include space for the null terminator
+            return context->get_tor_logs().size_since(sequence) + 1;
         }, error, 0);
     }
 
-
-    size_t tego_context_get_tor_logs(
+    size_t tego_context_get_tor_logs_since(
         const tego_context_t* context,
+        uint64_t sequence,
         char* out_logBuffer,
         size_t logBufferSize,
+        uint64_t* out_nextSequence,
         tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> size_t
@@ -770,41 +1037,19 @@ extern "C"
             TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
             TEGO_THROW_IF_NULL(out_logBuffer);
 
+            const auto& logs = context->get_tor_logs();
+
             // nothing to do if no space to write
             if (logBufferSize == 0)
             {
+                if (out_nextSequence != nullptr)
+                {
+                    *out_nextSequence = std::max(sequence, logs.first_sequence());
+                }
                 return 0;
             }
 
-            // get our tor logs
-            const auto& logs = context->get_tor_logs();
-            size_t logsSize = context->get_tor_logs_size();
-
-            // create temporary buffer to copy each line into
-            std::vector<char> logBuffer;
-            logBuffer.reserve(logsSize);
-
-            // copy each log and separate by new lines '\n'
-            for(const auto& line : logs)
-            {
-                std::copy(line.begin(), line.end(), std::back_inserter(logBuffer));
-                logBuffer.push_back('\n');
-            }
-            // append null terminator
-            logBuffer.push_back(0);
-
-            // finally copy at most logBufferSize bytes from logBuffer
-            size_t copyCount = std::min(logBufferSize, logBuffer.size());
-            TEGO_THROW_IF_FALSE(copyCount > 0);
-
-            // check that we won't overflow
-            TEGO_THROW_IF_FALSE(copyCount < std::numeric_limits<long>::max());
-
-            std::copy(logBuffer.begin(), logBuffer.begin() + static_cast<long>(copyCount), out_logBuffer);
-            // always write null terminator at the end
-            out_logBuffer[copyCount - 1] = 0;
-
-            return copyCount;
+            return logs.copy_since(sequence, out_logBuffer, logBufferSize, out_nextSequence);
         }, error, 0);
     }
 
@@ -890,6 +1135,33 @@ extern "C"
         }, error);
     }
 
+    int64_t tego_context_get_startup_milestone_elapsed(
+        const tego_context_t* context,
+        tego_startup_milestone_t milestone,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> int64_t
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+
+            return context->get_startup_milestone_elapsed(milestone);
+        }, error, -1);
+    }
+
+    tego_bool_t tego_context_get_tor_warm_start(
+        const tego_context_t* context,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> tego_bool_t
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+
+            return context->get_tor_warm_start() ? TEGO_TRUE : TEGO_FALSE;
+        }, error, TEGO_FALSE);
+    }
+
     void tego_context_start_service(
         tego_context_t* context,
         tego_ed25519_private_key_t const* hostPrivateKey,
@@ -933,11 +1205,70 @@ extern "C"
             TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
             TEGO_THROW_IF_NULL(out_hostUser);
 
-            auto hostUser = context->get_host_user_id();
+            auto hostUser = context->get_host_user_id(TEGO_PRIMARY_IDENTITY);
+            *out_hostUser = hostUser.release();
+        }, error);
+    }
+
+    void tego_context_add_identity(
+        tego_context_t* context,
+        tego_ed25519_private_key_t const* hostPrivateKey,
+        tego_user_id_t const* const* userBuffer,
+        tego_user_type_t* const userTypeBuffer,
+        size_t userCount,
+        tego_identity_t* out_identity,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+            TEGO_THROW_IF_NULL(hostPrivateKey);
+            TEGO_THROW_IF_NULL(out_identity);
+            TEGO_THROW_IF_FALSE((userBuffer == nullptr && userTypeBuffer == nullptr && userCount == 0) ||
+                                (userBuffer != nullptr && userTypeBuffer != nullptr && userCount > 0));
+
+            *out_identity = context->add_identity(
+                hostPrivateKey,
+                userBuffer,
+                userTypeBuffer,
+                userCount);
+        }, error);
+    }
+
+    void tego_context_get_identity_host_user_id(
+        const tego_context_t* context,
+        tego_identity_t identity,
+        tego_user_id_t** out_hostUser,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+            TEGO_THROW_IF_NULL(out_hostUser);
+
+            auto hostUser = context->get_host_user_id(identity);
             *out_hostUser = hostUser.release();
         }, error);
     }
 
+    void tego_context_get_identity_onion_service_state(
+        const tego_context_t* context,
+        tego_identity_t identity,
+        tego_host_onion_service_state_t* out_state,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+            TEGO_THROW_IF_NULL(out_state);
+
+            *out_state = context->get_host_onion_service_state(identity);
+        }, error);
+    }
+
     void tego_context_get_host_onion_service_state(
         const tego_context_t* context,
         tego_host_onion_service_state_t* out_state,
@@ -988,6 +1319,16 @@ extern "C"
         const tego_user_id_t* user,
         tego_user_type_t* out_type,
         tego_error_t** error)
+    {
+        return tego_context_identity_get_user_type(context, TEGO_PRIMARY_IDENTITY, user, out_type, error);
+    }
+
+    void tego_context_identity_get_user_type(
+        const tego_context_t* context,
+        tego_identity_t identity,
+        const tego_user_id_t* user,
+        tego_user_type_t* out_type,
+        tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> void
         {
@@ -996,7 +1337,7 @@ extern "C"
             TEGO_THROW_IF_NULL(user);
             TEGO_THROW_IF_NULL(out_type);
 
-            auto type = context->get_user_type(user);
+            auto type = context->get_user_type(identity, user);
             *out_type = type;
         }, error);
     }
@@ -1005,6 +1346,15 @@ extern "C"
         const tego_context_t* context,
         size_t* out_userCount,
         tego_error_t** error)
+    {
+        return tego_context_identity_get_user_count(context, TEGO_PRIMARY_IDENTITY, out_userCount, error);
+    }
+
+    void tego_context_identity_get_user_count(
+        const tego_context_t* context,
+        tego_identity_t identity,
+        size_t* out_userCount,
+        tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> void
         {
@@ -1012,7 +1362,7 @@ extern "C"
             TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
             TEGO_THROW_IF_NULL(out_userCount);
 
-            auto count = context->get_user_count();
+            auto count = context->get_user_count(identity);
             *out_userCount = count;
         }, error);
     }
@@ -1023,6 +1373,17 @@ extern "C"
         size_t usersBufferLength,
         size_t* out_userCount,
         tego_error_t** error)
+    {
+        return tego_context_identity_get_users(context, TEGO_PRIMARY_IDENTITY, out_usersBuffer, usersBufferLength, out_userCount, error);
+    }
+
+    void tego_context_identity_get_users(
+        const tego_context_t* context,
+        tego_identity_t identity,
+        tego_user_id_t** out_usersBuffer,
+        size_t usersBufferLength,
+        size_t* out_userCount,
+        tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> void
         {
@@ -1031,7 +1392,7 @@ extern "C"
             TEGO_THROW_IF_NULL(out_usersBuffer);
             TEGO_THROW_IF_NULL(out_userCount);
 
-            auto users = context->get_users();
+            auto users = context->get_users(identity);
             const auto userCount = std::min(users.size(), usersBufferLength);
             for(size_t i = 0; i < userCount; ++i)
             {
@@ -1056,7 +1417,26 @@ extern "C"
             TEGO_THROW_IF_NULL(user);
             TEGO_THROW_IF_FALSE(message != nullptr || messageLength == 0);
 
-            context->send_chat_request(user, message, messageLength);
+            context->send_chat_request(TEGO_PRIMARY_IDENTITY, user, message, messageLength);
+        }, error);
+    }
+
+    void tego_context_identity_send_chat_request(
+        tego_context_t* context,
+        tego_identity_t identity,
+        const tego_user_id_t* user,
+        const char* message,
+        size_t messageLength,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+            TEGO_THROW_IF_NULL(user);
+            TEGO_THROW_IF_FALSE(message != nullptr || messageLength == 0);
+
+            context->send_chat_request(identity, user, message, messageLength);
         }, error);
     }
 
@@ -1065,13 +1445,23 @@ extern "C"
         const tego_user_id_t* user,
         tego_chat_acknowledge_t response,
         tego_error_t** error)
+    {
+        return tego_context_identity_acknowledge_chat_request(context, TEGO_PRIMARY_IDENTITY, user, response, error);
+    }
+
+    void tego_context_identity_acknowledge_chat_request(
+        tego_context_t* context,
+        tego_identity_t identity,
+        const tego_user_id_t* user,
+        tego_chat_acknowledge_t response,
+        tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> void
         {
             TEGO_THROW_IF_NULL(context);
             TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
 
-            context->acknowledge_chat_request(user, response);
+            context->acknowledge_chat_request(identity, user, response);
         }, error);
     }
 
@@ -1084,6 +1474,20 @@ extern "C"
         tego_file_hash_t** out_fileHash,
         tego_file_size_t* out_fileSize,
         tego_error_t** error)
+    {
+        return tego_context_identity_send_file_transfer_request(context, TEGO_PRIMARY_IDENTITY, user, filePath, filePathLength, out_id, out_fileHash, out_fileSize, error);
+    }
+
+    void tego_context_identity_send_file_transfer_request(
+        tego_context* context,
+        tego_identity_t identity,
+        tego_user_id_t const*  user,
+        char const* filePath,
+        size_t filePathLength,
+        tego_file_transfer_id_t* out_id,
+        tego_file_hash_t** out_fileHash,
+        tego_file_size_t* out_fileSize,
+        tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> void
         {
@@ -1095,6 +1499,7 @@ extern "C"
 
             auto [id, fileHash, fileSize] =
                 context->send_file_transfer_request(
+                    identity,
                     user,
                     std::string(filePath, filePathLength));
 
@@ -1122,6 +1527,19 @@ extern "C"
         char const* destPath,
         size_t destPathLength,
         tego_error_t** error)
+    {
+        return tego_context_identity_respond_file_transfer_request(context, TEGO_PRIMARY_IDENTITY, user, fileTransfer, response, destPath, destPathLength, error);
+    }
+
+    void tego_context_identity_respond_file_transfer_request(
+        tego_context* context,
+        tego_identity_t identity,
+        tego_user_id_t const* user,
+        tego_file_transfer_id_t fileTransfer,
+        tego_file_transfer_response_t response,
+        char const* destPath,
+        size_t destPathLength,
+        tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> void
         {
@@ -1136,6 +1554,7 @@ extern "C"
                 (destPath != nullptr || destPathLength > 0))
 
             context->respond_file_transfer_request(
+                identity,
                 user,
                 fileTransfer,
                 response,
@@ -1148,13 +1567,113 @@ extern "C"
         tego_user_id_t const* user,
         tego_file_transfer_id_t id,
         tego_error_t** error)
+    {
+        return tego_context_identity_cancel_file_transfer(context, TEGO_PRIMARY_IDENTITY, user, id, error);
+    }
+
+    void tego_context_identity_cancel_file_transfer(
+        tego_context* context,
+        tego_identity_t identity,
+        tego_user_id_t const* user,
+        tego_file_transfer_id_t id,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+            TEGO_THROW_IF_NULL(user);
+            context->cancel_file_transfer_transfer(identity, user, id);
+        }, error);
+    }
+
+    void tego_context_set_file_transfer_chunk_size(
+        tego_context_t* context,
+        uint32_t chunkSize,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+            context->set_file_transfer_chunk_size(chunkSize);
+        }, error);
+    }
+
+    void tego_context_set_max_message_size(
+        tego_context_t* context,
+        uint32_t maxSize,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+            context->set_max_message_size(maxSize);
+        }, error);
+    }
+
+    void tego_context_set_payload_compression(
+        tego_context_t* context,
+        tego_bool_t enabled,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+            TEGO_THROW_IF_FALSE(enabled == TEGO_TRUE || enabled == TEGO_FALSE);
+            context->set_payload_compression(enabled == TEGO_TRUE);
+        }, error);
+    }
+
+    void tego_context_set_message_outbox_directory(
+        tego_context_t* context,
+        char const* directory,
+        size_t directoryLength,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+
+            if (directory == nullptr) {
+                context->set_message_outbox_directory({});
+            } else {
+                TEGO_THROW_IF_FALSE(directoryLength > 0);
+                context->set_message_outbox_directory(std::string(directory, directoryLength));
+            }
+        }, error);
+    }
+
+    void tego_context_export_conversation(
+        tego_context_t* context,
+        tego_user_id_t const* user,
+        char const* destPath,
+        size_t destPathLength,
+        tego_error_t** error)
+    {
+        return tego_context_identity_export_conversation(context, TEGO_PRIMARY_IDENTITY, user, destPath, destPathLength, error);
+    }
+
+    void tego_context_identity_export_conversation(
+        tego_context_t* context,
+        tego_identity_t identity,
+        tego_user_id_t const* user,
+        char const* destPath,
+        size_t destPathLength,
+        tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> void
         {
             TEGO_THROW_IF_NULL(context);
             TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
             TEGO_THROW_IF_NULL(user);
-            context->cancel_file_transfer_transfer(user, id);
+            TEGO_THROW_IF_NULL(destPath);
+            TEGO_THROW_IF_FALSE(destPathLength > 0);
+
+            context->export_conversation(identity, user, std::string(destPath, destPathLength));
         }, error);
     }
 
@@ -1174,7 +1693,7 @@ extern "C"
             TEGO_THROW_IF_NULL(message);
             TEGO_THROW_IF_FALSE(messageLength > 0);
 
-            auto id = context->send_message(user, std::string(message, messageLength));
+            auto id = context->send_message(TEGO_PRIMARY_IDENTITY, user, std::string(message, messageLength));
             if (out_id != nullptr)
             {
                 logger::println("Sent message with id: {}", id);
@@ -1183,16 +1702,50 @@ extern "C"
         }, error);
     }
 
+    void tego_context_identity_send_message(
+        tego_context_t* context,
+        tego_identity_t identity,
+        const tego_user_id_t* user,
+        const char* message,
+        size_t messageLength,
+        tego_message_id_t* out_id,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(context);
+            TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
+            TEGO_THROW_IF_NULL(user);
+            TEGO_THROW_IF_NULL(message);
+            TEGO_THROW_IF_FALSE(messageLength > 0);
+
+            auto id = context->send_message(identity, user, std::string(message, messageLength));
+            if (out_id != nullptr)
+            {
+                *out_id = id;
+            }
+        }, error);
+    }
+
     void tego_context_forget_user(
         tego_context_t* context,
         const tego_user_id_t* user,
         tego_error_t** error)
+    {
+        return tego_context_identity_forget_user(context, TEGO_PRIMARY_IDENTITY, user, error);
+    }
+
+    void tego_context_identity_forget_user(
+        tego_context_t* context,
+        tego_identity_t identity,
+        const tego_user_id_t* user,
+        tego_error_t** error)
     {
         return tego::translateExceptions([=]() -> void
         {
             TEGO_THROW_IF_NULL(context);
             TEGO_THROW_IF_FALSE(context->threadId == std::this_thread::get_id());
-            context->forget_user(user);
+            context->forget_user(identity, user);
         }, error);
     }
 }
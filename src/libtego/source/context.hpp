@@ -2,12 +2,15 @@
 
 #include "signals.hpp"
 #include "tor.hpp"
+#include "tor_log.hpp"
 #include "user.hpp"
 
 #include "tor/TorControl.h"
 #include "tor/TorManager.h"
 #include "core/IdentityManager.h"
 
+#include <tego/conversation_export.hpp>
+
 //
 // Tego Context
 //
@@ -19,51 +22,80 @@ public:
 
     void start_tor(const tego_tor_launch_config_t* config);
     bool get_tor_daemon_configured() const;
-    size_t get_tor_logs_size() const;
-    const std::vector<std::string>& get_tor_logs() const;
+    const tego::tor_log_buffer& get_tor_logs() const;
     const char* get_tor_version_string() const;
     tego_tor_control_status_t get_tor_control_status() const;
     tego_tor_process_status_t get_tor_process_status() const;
     tego_tor_network_status_t get_tor_network_status() const;
     int32_t get_tor_bootstrap_progress() const;
     tego_tor_bootstrap_tag_t get_tor_bootstrap_tag() const;
+    void record_startup_milestone(tego_startup_milestone_t milestone);
+    int64_t get_startup_milestone_elapsed(tego_startup_milestone_t milestone) const;
+    bool get_tor_warm_start() const;
     void start_service(
         tego_ed25519_private_key_t const* hostPrivateKey,
         tego_user_id_t const* const* userBuffer,
         tego_user_type_t* const userTypeBuffer,
         size_t userCount);
     void start_service();
+    tego_identity_t add_identity(
+        tego_ed25519_private_key_t const* hostPrivateKey,
+        tego_user_id_t const* const* userBuffer,
+        tego_user_type_t* const userTypeBuffer,
+        size_t userCount);
     void update_tor_daemon_config(const tego_tor_daemon_config_t* config);
     void update_disable_network_flag(bool disableNetwork);
     void save_tor_daemon_config();
     void set_host_onion_service_state(tego_host_onion_service_state_t state);
-    std::unique_ptr<tego_user_id_t> get_host_user_id() const;
+    void set_host_onion_service_state(Tor::HiddenService const* service, tego_host_onion_service_state_t state);
+    std::unique_ptr<tego_user_id_t> get_host_user_id(tego_identity_t identity) const;
     tego_host_onion_service_state_t get_host_onion_service_state() const;
+    tego_host_onion_service_state_t get_host_onion_service_state(tego_identity_t identity) const;
     void send_chat_request(
+        tego_identity_t identity,
         const tego_user_id_t* user,
         const char* message,
         size_t messageLength);
     void acknowledge_chat_request(
+        tego_identity_t identity,
         const tego_user_id_t* user,
         tego_chat_acknowledge_t response);
     tego_message_id_t send_message(
+        tego_identity_t identity,
         const tego_user_id_t* user,
         const std::string& message);
-    tego_user_type_t get_user_type(tego_user_id_t const* user) const;
-    size_t get_user_count() const;
-    std::vector<tego_user_id_t*> get_users() const;
-    void forget_user(const tego_user_id_t* user);
+    tego_user_type_t get_user_type(tego_identity_t identity, tego_user_id_t const* user) const;
+    size_t get_user_count(tego_identity_t identity) const;
+    std::vector<tego_user_id_t*> get_users(tego_identity_t identity) const;
+    void forget_user(tego_identity_t identity, const tego_user_id_t* user);
     std::tuple<tego_file_transfer_id_t, std::unique_ptr<tego_file_hash_t>, tego_file_size_t> send_file_transfer_request(
+        tego_identity_t identity,
         tego_user_id_t const* user,
         std::string const& filePath);
     void respond_file_transfer_request(
+        tego_identity_t identity,
         tego_user_id_t const* user,
         tego_file_transfer_id_t fileTransfer,
         tego_file_transfer_response_t response,
         std::string const& destPath);
     void cancel_file_transfer_transfer(
+        tego_identity_t identity,
         tego_user_id_t const* user,
         tego_file_transfer_id_t);
+    void set_file_transfer_chunk_size(uint32_t chunkSize);
+    uint32_t get_file_transfer_chunk_size() const;
+    void set_max_message_size(uint32_t maxSize);
+    uint32_t get_max_message_size() const;
+    void set_payload_compression(bool enabled);
+    bool get_payload_compression() const;
+    void set_message_outbox_directory(std::string const& directory);
+    QString get_message_outbox_directory() const;
+    // whether hostname is a contact of the identity hosting serverHostname
+    bool is_known_contact(QString const& serverHostname, QString const& hostname) const;
+    void export_conversation(
+        tego_identity_t identity,
+        tego_user_id_t const* user,
+        std::string const& destPath);
 
     tego::callback_registry callback_registry_;
     tego::callback_queue callback_queue_;
@@ -83,9 +115,32 @@ public:
     // event loop, which in our case is the thread the context is created on)
     std::thread::id threadId;
 private:
-    class ContactUser* getContactUser(const tego_user_id_t*) const;
+    class UserIdentity* startIdentity(
+        tego_ed25519_private_key_t const* hostPrivateKey,
+        tego_user_id_t const* const* userBuffer,
+        tego_user_type_t* const userTypeBuffer,
+        size_t userCount);
+    class UserIdentity* getUserIdentity(tego_identity_t identity) const;
+    class ContactUser* getContactUser(tego_identity_t identity, const tego_user_id_t*) const;
 
     mutable std::string torVersion;
-    mutable std::vector<std::string> torLogs;
     tego_host_onion_service_state_t hostUserState = tego_host_onion_service_state_none;
+    // milliseconds since start_tor at which each milestone was first
+    // reached, -1 until then
+    QElapsedTimer startupTimer;
+    std::array<int64_t, tego_startup_milestone_count> startupMilestones;
+    // last reported onion service state of every hosted identity
+    std::unordered_map<tego_identity_t, tego_host_onion_service_state_t> identityStates;
+    // preferred size of outgoing file chunks, negotiated down per FileChannel
+    uint32_t fileTransferChunkSize = TEGO_FILE_TRANSFER_DEFAULT_CHUNK_SIZE;
+    // largest long chat message we send or accept, 0 to disable them
+    uint32_t maxMessageSize = TEGO_MESSAGE_DEFAULT_MAX_SIZE;
+    // whether chat and file channels offer and accept compressed payloads
+    bool payloadCompression = true;
+    // where contacts' outgoing message logs are kept, empty if disabled
+    QString messageOutboxDirectory;
+
+    // in-flight conversation exports, these emit callbacks from their worker
+    // threads so must be torn down before the callback queue
+    std::list<std::unique_ptr<tego::conversation_exporter>> conversationExports;
 };
\ No newline at end of file
@@ -113,10 +113,10 @@ void ContactUser::updateStatus()
         switch(newStatus)
         {
             case ContactUser::Online:
-                tego::g_globals.context->callback_registry_.emit_user_status_changed(userId.release(), tego_user_status_online);
+                tego::g_globals.context->callback_registry_.emit_user_status_changed(this->identity->toTegoIdentity(), userId.release(), tego_user_status_online);
                 break;
             case ContactUser::Offline:
-                tego::g_globals.context->callback_registry_.emit_user_status_changed(userId.release(), tego_user_status_offline);
+                tego::g_globals.context->callback_registry_.emit_user_status_changed(this->identity->toTegoIdentity(), userId.release(), tego_user_status_offline);
                 break;
             default:
 
@@ -36,9 +36,11 @@
 using tego::g_globals;
 
 #include "ConversationModel.h"
+#include "core/UserIdentity.h"
 #include "protocol/Connection.h"
 #include "protocol/ChatChannel.h"
 #include "protocol/FileChannel.h"
+#include "tor/HiddenService.h"
 #include "utils/SecureRNG.h"
 #include "utils/Useful.h"
 
@@ -46,6 +48,7 @@ ConversationModel::ConversationModel(QObject *parent)
     : QAbstractListModel(parent)
     , m_contact(0)
     , messages({})
+    , m_firstPosition(0)
     , m_unreadCount(0)
     , lastMessageId(SecureRNG::randomInt(UINT32_MAX))
 
@@ -58,12 +61,22 @@ void ConversationModel::setContact(ContactUser *contact)
         return;
 
     beginResetModel();
-    messages.clear();
+    resetMessages();
+    m_outbox.reset();
+    disconnect(m_outboxPending);
 
     if (m_contact)
         disconnect(m_contact, 0, this, 0);
     m_contact = contact;
     if (m_contact) {
+        loadOutbox();
+        connect(m_contact, &ContactUser::contactDeleted, this,
+            [this]() {
+                if (m_outbox)
+                    m_outbox->removeFile();
+                m_outbox.reset();
+            });
+
         auto connectChannel = [this](Protocol::Channel *channel) {
             if (channel->direction() == Protocol::Channel::Outbound)
             {
@@ -105,6 +118,67 @@ void ConversationModel::setContact(ContactUser *contact)
     emit contactChanged();
 }
 
+void ConversationModel::loadOutbox()
+{
+    const QString directory = g_globals.context->get_message_outbox_directory();
+    if (directory.isEmpty())
+        return;
+
+    // logs are kept per identity hostname, which a new identity only has once
+    // tor has generated its key; load then rather than share one directory
+    // between every such identity
+    UserIdentity *identity = m_contact->getIdentity();
+    if (identity->hostname().isEmpty()) {
+        if (Tor::HiddenService *service = identity->hiddenService()) {
+            m_outboxPending = connect(service, &Tor::HiddenService::privateKeyChanged, this,
+                [this]() {
+                    disconnect(m_outboxPending);
+                    beginResetModel();
+                    loadOutbox();
+                    endResetModel();
+                });
+        }
+        return;
+    }
+
+    // one log per contact of each identity
+    const QString identityId = identity->hostname().section(QLatin1Char('.'), 0, 0);
+    const QString contactId = m_contact->hostname().section(QLatin1Char('.'), 0, 0);
+    QDir dir(directory);
+    if (!dir.mkpath(identityId)) {
+        qWarning() << "Cannot create message outbox directory for" << identityId;
+        return;
+    }
+
+    m_outbox = std::make_unique<MessageOutbox>(dir.filePath(identityId + QLatin1Char('/') + contactId + QStringLiteral(".outbox")));
+    const auto entries = m_outbox->load();
+
+    // messages queued while waiting for the hostname are newer than any in
+    // the log, and are persisted now
+    const bool hadMessages = !messages.isEmpty();
+    for (const MessageData &message : qAsConst(messages)) {
+        if (message.type == Message && (message.status == Queued || message.status == Sending))
+            m_outbox->append({message.identifier, message.time, message.text});
+    }
+
+    QList<MessageData> replayed;
+    for (const auto &entry : entries) {
+        if (m_outgoingPositions.contains(entry.id))
+            continue;
+        replayed.append(MessageData(Message, entry.text, entry.time, entry.id, Queued));
+        m_pendingOutgoing.insert(entry.id);
+    }
+    messages = replayed + messages;
+    indexMessages(0);
+
+    // keep ids sequential after the replayed messages
+    if (!replayed.isEmpty()) {
+        if (!hadMessages)
+            lastMessageId = replayed.last().identifier + 1;
+        qDebug() << "Queued" << replayed.size() << "messages from the outbox for" << contactId;
+    }
+}
+
 /* Get a channel of type T for a contact, if it doesn't exist create one
  * on error returns NULL */
 template<typename T> T *findOrCreateChannelForContact(ContactUser *contact, Protocol::Channel::Direction direction) {
@@ -171,9 +245,7 @@ std::tuple<tego_file_transfer_id_t, std::unique_ptr<tego_file_hash_t>, tego_file
         logger::trace();
     }
 
-    beginInsertRows(QModelIndex(), 0, 0);
-    messages.prepend(message);
-    endInsertRows();
+    insertMessage(messages.size(), message);
     prune();
 
     return {message.identifier, std::move(fileHash), fileSize};
@@ -203,9 +275,10 @@ tego_message_id_t ConversationModel::sendMessage(const QString &text)
         }
     }
 
-    beginInsertRows(QModelIndex(), 0, 0);
-    messages.prepend(message);
-    endInsertRows();
+    if (m_outbox && message.status != Error)
+        m_outbox->append({message.identifier, message.time, message.text});
+
+    insertMessage(messages.size(), message);
     prune();
 
     return message.identifier;
@@ -255,10 +328,9 @@ void ConversationModel::cancelTransfer(tego_file_transfer_id_t id)
             }
         }
     }
-    else if(auto it = std::find_if(messages.begin(), messages.end(), [=](auto& msg) {return msg.identifier == id;});
-            it != messages.end())
+    else if(int i = indexOfIdentifier(id, true); i >= 0)
     {
-        messages.erase(it);
+        removeMessage(i);
     }
     else
     {
@@ -277,8 +349,8 @@ void ConversationModel::sendQueuedMessages()
 
     // sendQueuedMessages is called at channelOpened
 
-    // Iterate backwards, from oldest to newest messages
-    for (int i = messages.size() - 1; i >= 0; i--)
+    // From oldest to newest messages
+    for (int i : pendingMessages())
     {
         auto& m = messages[i];
         if (m.status == Queued) {
@@ -289,7 +361,9 @@ void ConversationModel::sendQueuedMessages()
                 case ConversationModel::MessageType::Message:
                     if (chat_channel->isOpened())
                     {
-                        m.status = chat_channel->sendChatMessageWithId(m.text, m.time, m.identifier) ? Sending : Error;
+                        setStatus(i, chat_channel->sendChatMessageWithId(m.text, m.time, m.identifier) ? Sending : Error);
+                        if (m.status == Error && m_outbox)
+                            m_outbox->remove(m.identifier);
                         attempted = true;
                     }
                     break;
@@ -297,7 +371,7 @@ void ConversationModel::sendQueuedMessages()
                     if (file_channel->isOpened())
                     {
                         logger::println("Attempted to send queued file: {}", m.text);
-                        m.status = file_channel->sendFileWithId(m.text, m.fileHash, m.time, m.identifier) ? Sending : Error;
+                        setStatus(i, file_channel->sendFileWithId(m.text, m.fileHash, m.time, m.identifier) ? Sending : Error);
                         attempted = true;
                     }
                     break;
@@ -309,7 +383,7 @@ void ConversationModel::sendQueuedMessages()
             if (attempted)
             {
                 m.attemptCount++;
-                emit dataChanged(index(i, 0), index(i, 0));
+                emit dataChanged(index(rowOf(i), 0), index(rowOf(i), 0));
             }
         }
     }
@@ -321,14 +395,9 @@ void ConversationModel::messageReceived(const QString &text, const QDateTime &ti
     // causes the other party to resend the message. Discard the duplicate.
     // We don't need to resend the old acknowledgement packet because
     // it is identical to the one for the duplicate message.
-    for (int i = 0; i < messages.size() && i < 5; i++) {
-        if (messages[i].status == Delivered) {
-            break;
-        }
-        if (messages[i].identifier == id && messages[i].text == text) {
-            qDebug() << "duplicate incoming message" << id;
-            return;
-        }
+    if (int i = indexOfIdentifier(id, false); i >= 0 && messages[i].text == text) {
+        qDebug() << "duplicate incoming message" << id;
+        return;
     }
 
     // To preserve conversation flow despite potentially high latency, incoming messages
@@ -336,16 +405,14 @@ void ConversationModel::messageReceived(const QString &text, const QDateTime &ti
     // the peer hadn't seen any unacknowledged message when this message was sent.
     int row = 0;
     for (int i = 0; i < messages.size() && i < 5; i++) {
-        if (messages[i].status != Sending && messages[i].status != Queued) {
+        const MessageStatus status = messages[rowOf(i)].status;
+        if (status != Sending && status != Queued) {
             row = i;
             break;
         }
     }
 
-    beginInsertRows(QModelIndex(), row, row);
-    MessageData message(Message, text, time, id, Received);
-    messages.insert(row, message);
-    endInsertRows();
+    insertMessage(messages.size() - row, MessageData(Message, text, time, id, Received));
     prune();
 
     m_unreadCount++;
@@ -361,39 +428,43 @@ void ConversationModel::messageReceived(const QString &text, const QDateTime &ti
 
         logger::println("Received Message : {}", rawText.get());
 
-        g_globals.context->callback_registry_.emit_message_received(userId.release(), static_cast<tego_time_t>(time.toMSecsSinceEpoch()), id, rawText.release(), static_cast<size_t>(utf8Text.size()));
+        g_globals.context->callback_registry_.emit_message_received(this->m_contact->identity->toTegoIdentity(), userId.release(), static_cast<tego_time_t>(time.toMSecsSinceEpoch()), id, rawText.release(), static_cast<size_t>(utf8Text.size()));
     }
 }
 
 void ConversationModel::messageAcknowledged(MessageId id, bool accepted)
 {
-    int row = indexOfIdentifier(id, true);
-    if (row < 0)
+    if (m_outbox)
+        m_outbox->remove(id);
+
+    int i = indexOfIdentifier(id, true);
+    if (i < 0)
         return;
 
-    MessageData &data = messages[row];
-    data.status = accepted ? Delivered : Error;
-    emit dataChanged(index(row, 0), index(row, 0));
+    setStatus(i, accepted ? Delivered : Error);
+    emit dataChanged(index(rowOf(i), 0), index(rowOf(i), 0));
 
     auto userId = this->contact()->toTegoUserId();
-    g_globals.context->callback_registry_.emit_message_acknowledged(userId.release(), id, (accepted ? TEGO_TRUE : TEGO_FALSE));
+    g_globals.context->callback_registry_.emit_message_acknowledged(this->contact()->identity->toTegoIdentity(), userId.release(), id, (accepted ? TEGO_TRUE : TEGO_FALSE));
 }
 
 void ConversationModel::outboundChannelClosed()
 {
     // Any messages that are Sending are moved back to Queued, so they
     // will be re-sent when we reconnect.
-    for (int i = 0; i < messages.size(); i++) {
+    for (int i : pendingMessages()) {
         if (messages[i].status != Sending)
             continue;
         if (messages[i].attemptCount >= 2) {
             qDebug() << "Outbound chat channel closed, and unacknowledged message has been tried twice already. Marking as error.";
-            messages[i].status = Error;
+            setStatus(i, Error);
+            if (m_outbox && messages[i].type == Message)
+                m_outbox->remove(messages[i].identifier);
         } else {
             qDebug() << "Outbound chat channel closed, putting unacknowledged chat message back in queue";
-            messages[i].status = Queued;
+            setStatus(i, Queued);
         }
-        emit dataChanged(index(i, 0), index(i, 0));
+        emit dataChanged(index(rowOf(i), 0), index(rowOf(i), 0));
     }
 
     // Try to reopen the channel if we're still connected
@@ -404,16 +475,104 @@ void ConversationModel::outboundChannelClosed()
 
 void ConversationModel::clear()
 {
+    if (m_outbox)
+        m_outbox->clear();
+
     if (messages.isEmpty())
         return;
 
     beginRemoveRows(QModelIndex(), 0, messages.size()-1);
-    messages.clear();
+    resetMessages();
     endRemoveRows();
 
     resetUnreadCount();
 }
 
+std::unique_ptr<tego::conversation_exporter> ConversationModel::exportConversation(
+    const std::string& destPath,
+    tego::conversation_exporter::progress_t progress,
+    tego::conversation_exporter::complete_t complete) const
+{
+    TEGO_THROW_IF_NULL(m_contact);
+
+    const auto contactId = m_contact->contactID().toStdString();
+    auto header = fmt::format("Conversation with {}\n", contactId);
+
+    // implicitly shared, the worker reads from this copy while we keep
+    // modifying ours
+    const auto snapshot = messages;
+
+    // file paths are resolved here rather than on the worker
+    QHash<int, std::string> fileNames;
+    for (int i = 0; i < snapshot.size(); i++)
+    {
+        if (snapshot.at(i).type == File)
+        {
+            fileNames.insert(i, QFileInfo(snapshot.at(i).text).fileName().toStdString());
+        }
+    }
+
+    auto formatEntry = [snapshot, fileNames, contactId](std::string& out, size_t index) -> void
+    {
+        constexpr static const char* statusList[] =
+        {
+            "Received",
+            "Queued",
+            "Sending",
+            "Delivered",
+            "Error",
+        };
+
+        // messages are stored oldest first
+        const auto& md = snapshot.at(static_cast<int>(index));
+        const auto time = md.time.toString().toStdString();
+
+        switch (md.type)
+        {
+            case Message:
+                if (md.status == Received)
+                {
+                    fmt::format_to(std::back_inserter(out), "[{}] <{}>: {}\n", time, contactId, md.text.toStdString());
+                }
+                else if (md.status == Delivered)
+                {
+                    fmt::format_to(std::back_inserter(out), "[{}] <me>: {}\n", time, md.text.toStdString());
+                }
+                else
+                {
+                    fmt::format_to(std::back_inserter(out), "[{}] <me> ({}): {}\n", time, statusList[md.status], md.text.toStdString());
+                }
+                break;
+            case File:
+            {
+                // tego_file_hash::to_string() caches into a mutable member, so
+                // don't touch it from the worker thread
+                std::string hash;
+                for (auto byte : md.fileHash.data)
+                {
+                    fmt::format_to(std::back_inserter(hash), "{:02x}", byte);
+                }
+                fmt::format_to(std::back_inserter(out), "[{}] file '{}' {} <{}> (hash: {}): {}\n",
+                    time,
+                    fileNames.value(static_cast<int>(index)),
+                    md.status == Received ? "from" : "to",
+                    contactId,
+                    hash,
+                    statusList[md.status]);
+            }
+            break;
+        }
+    };
+
+    return std::make_unique<tego::conversation_exporter>(
+        destPath,
+        std::move(header),
+        static_cast<size_t>(snapshot.size()),
+        std::move(formatEntry),
+        std::move(progress),
+        std::move(complete));
+}
+
 void ConversationModel::resetUnreadCount()
 {
     if (m_unreadCount == 0)
@@ -445,6 +604,7 @@ void ConversationModel::onFileTransferRequestReceived(tego_file_transfer_id_t id
     auto heapHash = std::make_unique<tego_file_hash_t>(hash);
 
     g_globals.context->callback_registry_.emit_file_transfer_request_received(
+        this->contact()->identity->toTegoIdentity(),
         userId.release(),
         id,
         rawFilename.release(),
@@ -455,16 +615,16 @@ void ConversationModel::onFileTransferRequestReceived(tego_file_transfer_id_t id
 
 void ConversationModel::onFileTransferAcknowledged(tego_file_transfer_id_t id, bool accepted)
 {
-    int row = indexOfIdentifier(id, true);
-    if (row < 0)
+    int i = indexOfIdentifier(id, true);
+    if (i < 0)
         return;
 
-    MessageData &data = messages[row];
-    data.status = accepted ? Delivered : Error;
-    emit dataChanged(index(row, 0), index(row, 0));
+    setStatus(i, accepted ? Delivered : Error);
+    emit dataChanged(index(rowOf(i), 0), index(rowOf(i), 0));
 
     auto userId = this->contact()->toTegoUserId();
     g_globals.context->callback_registry_.emit_file_transfer_request_acknowledged(
+        this->contact()->identity->toTegoIdentity(),
         userId.release(),
         id,
         accepted ? TEGO_TRUE : TEGO_FALSE);
@@ -474,6 +634,7 @@ void ConversationModel::onFileTransferRequestResponded(tego_file_transfer_id_t i
 {
     auto userId = this->contact()->toTegoUserId();
     g_globals.context->callback_registry_.emit_file_transfer_request_response_received(
+        this->contact()->identity->toTegoIdentity(),
         userId.release(),
         id,
         response);
@@ -483,6 +644,7 @@ void ConversationModel::onFileTransferProgress(tego_file_transfer_id_t id, tego_
 {
     auto userId = this->contact()->toTegoUserId();
     g_globals.context->callback_registry_.emit_file_transfer_progress(
+        this->contact()->identity->toTegoIdentity(),
         userId.release(),
         id,
         direction,
@@ -494,6 +656,7 @@ void ConversationModel::onFileTransferFinished(tego_file_transfer_id_t id, tego_
 {
     auto userId = this->contact()->toTegoUserId();
     g_globals.context->callback_registry_.emit_file_transfer_complete(
+        this->contact()->identity->toTegoIdentity(),
         userId.release(),
         id,
         direction,
@@ -524,7 +687,8 @@ QVariant ConversationModel::data(const QModelIndex &index, int role) const
     if (!index.isValid() || index.row() >= messages.size())
         return QVariant();
 
-    const MessageData &message = messages[index.row()];
+    const int i = rowOf(index.row());
+    const MessageData &message = messages[i];
 
     switch (role) {
         case Qt::DisplayRole: return message.text;
@@ -535,20 +699,20 @@ QVariant ConversationModel::data(const QModelIndex &index, int role) const
         case SectionRole: {
             if (m_contact->status() == ContactUser::Online)
                 return QString();
-            if (index.row() < messages.size() - 1) {
-                const MessageData &next = messages[index.row()+1];
-                if (next.status != Received && next.status != Delivered)
+            if (i > 0) {
+                const MessageData &previous = messages[i - 1];
+                if (previous.status != Received && previous.status != Delivered)
                     return QString();
             }
-            for (int i = 0; i <= index.row(); i++) {
-                if (messages[i].status == Received || messages[i].status == Delivered)
+            for (int j = messages.size() - 1; j >= i; j--) {
+                if (messages[j].status == Received || messages[j].status == Delivered)
                     return QString();
             }
             return QStringLiteral("offline");
         }
         case TimespanRole: {
-            if (index.row() < messages.size() - 1)
-                return messages[index.row() + 1].time.secsTo(messages[index.row()].time);
+            if (i > 0)
+                return messages[i - 1].time.secsTo(message.time);
             else
                 return -1;
         }
@@ -557,23 +721,119 @@ QVariant ConversationModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
-int ConversationModel::indexOfIdentifier(MessageId identifier, bool isOutgoing) const
+QHash<ConversationModel::MessageId, quint64> &ConversationModel::positionsOf(const MessageData &message)
+{
+    return message.status == Received ? m_incomingPositions : m_outgoingPositions;
+}
+
+void ConversationModel::indexMessages(int from)
 {
-    for (int i = 0; i < messages.size(); i++) {
-        if (messages[i].identifier == identifier && (messages[i].status != Received) == isOutgoing)
-            return i;
+    for (int i = from; i < messages.size(); i++)
+        positionsOf(messages[i]).insert(messages[i].identifier, m_firstPosition + static_cast<quint64>(i));
+}
+
+void ConversationModel::insertMessage(int i, const MessageData &message)
+{
+    const int row = messages.size() - i;
+    beginInsertRows(QModelIndex(), row, row);
+    messages.insert(i, message);
+    if (message.status == Queued || message.status == Sending)
+        m_pendingOutgoing.insert(message.identifier);
+    // only the messages newer than this one move, usually none of them
+    indexMessages(i);
+    endInsertRows();
+}
+
+void ConversationModel::removeMessage(int i)
+{
+    const int row = rowOf(i);
+    beginRemoveRows(QModelIndex(), row, row);
+    const MessageData &message = messages[i];
+    auto &positions = positionsOf(message);
+    if (positions.value(message.identifier) == m_firstPosition + static_cast<quint64>(i))
+        positions.remove(message.identifier);
+    if (message.status == Queued || message.status == Sending)
+        m_pendingOutgoing.remove(message.identifier);
+    messages.removeAt(i);
+    indexMessages(i);
+    endRemoveRows();
+}
+
+void ConversationModel::resetMessages()
+{
+    messages.clear();
+    m_firstPosition = 0;
+    m_outgoingPositions.clear();
+    m_incomingPositions.clear();
+    m_pendingOutgoing.clear();
+}
+
+void ConversationModel::setStatus(int i, MessageStatus status)
+{
+    MessageData &message = messages[i];
+    message.status = status;
+    if (status == Queued || status == Sending)
+        m_pendingOutgoing.insert(message.identifier);
+    else
+        m_pendingOutgoing.remove(message.identifier);
+}
+
+std::vector<int> ConversationModel::pendingMessages() const
+{
+    std::vector<int> pending;
+    pending.reserve(static_cast<size_t>(m_pendingOutgoing.size()));
+    for (MessageId id : m_pendingOutgoing) {
+        int i = indexOfIdentifier(id, true);
+        if (i >= 0)
+            pending.push_back(i);
     }
-    return -1;
+    std::sort(pending.begin(), pending.end());
+    return pending;
+}
+
+int ConversationModel::indexOfIdentifier(MessageId identifier, bool isOutgoing) const
+{
+    const auto &positions = isOutgoing ? m_outgoingPositions : m_incomingPositions;
+    auto it = positions.constFind(identifier);
+    if (it == positions.constEnd())
+        return -1;
+    return static_cast<int>(*it - m_firstPosition);
 }
 
 void ConversationModel::prune()
 {
     const int history_limit = 1000;
-    if (messages.size() > history_limit) {
-        beginRemoveRows(QModelIndex(), history_limit, messages.size()-1);
-        while (messages.size() > history_limit) {
-            messages.removeLast();
+    if (messages.size() <= history_limit)
+        return;
+
+    auto isPending = [](const MessageData &message) {
+        return message.status == Queued || message.status == Sending;
+    };
+
+    // queued and sending messages are kept until they're sent or fail, or
+    // they'd never be retried; drop the oldest of the rest, usually all at
+    // the front so positions don't move
+    int leading = 0;
+    while (leading < messages.size() - history_limit && !isPending(messages[leading]))
+        leading++;
+
+    if (leading > 0) {
+        beginRemoveRows(QModelIndex(), messages.size() - leading, messages.size() - 1);
+        for (int n = 0; n < leading; n++) {
+            const MessageData &message = messages.first();
+            auto &positions = positionsOf(message);
+            if (positions.value(message.identifier) == m_firstPosition)
+                positions.remove(message.identifier);
+            messages.removeFirst();
+            m_firstPosition++;
         }
         endRemoveRows();
     }
+
+    for (int i = 0; messages.size() > history_limit && i < messages.size(); ) {
+        if (isPending(messages[i]))
+            i++;
+        else
+            removeMessage(i);
+    }
 }
@@ -36,6 +36,9 @@
 #include "core/ContactUser.h"
 #include "protocol/ChatChannel.h"
 #include "protocol/FileChannel.h"
+#include "core/MessageOutbox.h"
+
+#include <tego/conversation_export.hpp>
 
 class ConversationModel : public QAbstractListModel
 {
@@ -86,6 +89,13 @@ public:
 
     void clear();
 
+    /* Snapshot the conversation and write it out as a text log to destPath
+     * on a background thread, the returned exporter has not been started */
+    std::unique_ptr<tego::conversation_exporter> exportConversation(
+        const std::string& destPath,
+        tego::conversation_exporter::progress_t progress,
+        tego::conversation_exporter::complete_t complete) const;
+
 signals:
     void contactChanged();
     void unreadCountChanged();
@@ -120,13 +130,39 @@ private:
     };
 
     ContactUser *m_contact;
+    // oldest first, so sending appends and pruning drops from the front; row 0
+    // of the model is the newest message, messages.last()
     QList<MessageData> messages;
+    // position of messages.first(), later messages follow on from it so the
+    // positions of those that remain don't change when old ones are pruned
+    quint64 m_firstPosition;
+    // positions of the newest message with each id; ids are per direction
+    QHash<MessageId, quint64> m_outgoingPositions;
+    QHash<MessageId, quint64> m_incomingPositions;
+    // outgoing messages that are Queued or Sending
+    QSet<MessageId> m_pendingOutgoing;
     int m_unreadCount;
+    // unacknowledged outgoing chat messages persisted across restarts, if enabled
+    std::unique_ptr<MessageOutbox> m_outbox;
+    // waiting for the identity's hostname to load the outbox
+    QMetaObject::Connection m_outboxPending;
 
     // The peer might use recent message IDs between connections to handle
     // re-send. Start at a random ID to reduce chance of collisions, then increment
     MessageId lastMessageId;
 
+    void loadOutbox();
+
+    int rowOf(int i) const { return messages.size() - 1 - i; }
+    QHash<MessageId, quint64> &positionsOf(const MessageData &message);
+    void indexMessages(int from);
+    void insertMessage(int i, const MessageData &message);
+    void removeMessage(int i);
+    void resetMessages();
+    void setStatus(int i, MessageStatus status);
+    // indexes into messages of the Queued and Sending messages, oldest first
+    std::vector<int> pendingMessages() const;
+    // index into messages, or -1
     int indexOfIdentifier(MessageId identifier, bool isOutgoing) const;
     void prune();
 };
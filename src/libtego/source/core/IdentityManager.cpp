@@ -81,6 +81,14 @@ UserIdentity *IdentityManager::createIdentity()
     return identity;
 }
 
+UserIdentity *IdentityManager::createIdentity(const QString &keyBlob)
+{
+    UserIdentity *identity = new UserIdentity(++highestID, keyBlob, this);
+    addIdentity(identity);
+
+    return identity;
+}
+
 UserIdentity *IdentityManager::lookupHostname(const QString &hostname) const
 {
     QString ohost = ContactIDValidator::hostnameFromID(hostname);
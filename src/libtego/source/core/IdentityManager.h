@@ -33,7 +33,6 @@
 #ifndef IDENTITYMANAGER_H
 #define IDENTITYMANAGER_H
 
-// TODO: this needs to go entirely, we do not have multiple simultaneous UserIdentity objects
 class IdentityManager : public QObject
 {
     Q_OBJECT
@@ -49,6 +48,8 @@ public:
     class UserIdentity *lookupUniqueID(int uniqueID) const;
 
     class UserIdentity *createIdentity();
+    // keyBlob : ED25519-V3 private key of an additional identity to host
+    class UserIdentity *createIdentity(const QString &keyBlob);
 
 signals:
     void contactDeleted(class ContactUser *user, class UserIdentity *identity);
@@ -31,6 +31,7 @@
  */
 
 #include "IdentityManager.h"
+#include "UserIdentity.h"
 #include "IncomingRequestManager.h"
 #include "ContactsManager.h"
 #include "ContactUser.h"
@@ -70,7 +71,7 @@ IncomingRequestManager::IncomingRequestManager(ContactsManager *c)
         auto rawMessage = std::make_unique<char[]>(messageLength + 1);
         std::copy(message.begin(), message.end(), rawMessage.get());
 
-        tego::g_globals.context->callback_registry_.emit_chat_request_received(userId.release(), rawMessage.release(), messageLength);
+        tego::g_globals.context->callback_registry_.emit_chat_request_received(self->contacts->identity->toTegoIdentity(), userId.release(), rawMessage.release(), messageLength);
 
         logger::trace();
     });
@@ -0,0 +1,337 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "MessageOutbox.h"
+
+MessageOutbox::MessageOutbox(const QString &path)
+    : m_path(path)
+    , m_nextSequence(0)
+    , m_deadBytes(0)
+    , m_broken(false)
+{
+    m_syncTimer.setCallback([this]() { sync(); });
+}
+
+MessageOutbox::~MessageOutbox()
+{
+    if (m_syncTimer.isActive())
+        sync();
+}
+
+QByteArray MessageOutbox::header()
+{
+    // magic and format version
+    return QByteArrayLiteral("TOBX\x01");
+}
+
+QByteArray MessageOutbox::queuedRecord(const Entry &entry)
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << quint8(QueuedRecord) << entry.id << qint64(entry.time.toMSecsSinceEpoch()) << entry.text.toUtf8();
+    return record;
+}
+
+QByteArray MessageOutbox::doneRecord(MessageId id)
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << quint8(DoneRecord) << id;
+    return record;
+}
+
+QList<MessageOutbox::Entry> MessageOutbox::load()
+{
+    m_live.clear();
+    m_nextSequence = 0;
+    m_deadBytes = 0;
+    m_broken = false;
+
+    m_file.setFileName(m_path);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    const bool opened = m_file.open(OpenMode, FilePermissions);
+#else
+#ifdef Q_OS_UNIX
+    // create it owner-only, so it's never readable by others even briefly
+    const int fd = ::open(QFile::encodeName(m_path).constData(), O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+    if (fd >= 0)
+        ::close(fd);
+#endif
+    const bool opened = m_file.open(OpenMode);
+#endif
+    if (!opened) {
+        qWarning() << "Cannot open message outbox" << m_path << ":" << m_file.errorString();
+        return {};
+    }
+    // corrects logs created before their permissions were restricted
+    const QFileDevice::Permissions userBits = QFileDevice::ReadUser | QFileDevice::WriteUser | QFileDevice::ExeUser;
+    if ((m_file.permissions() & ~userBits) != FilePermissions && !m_file.setPermissions(FilePermissions))
+        qWarning() << "Cannot restrict permissions on message outbox" << m_path;
+
+    const QByteArray expectedHeader = header();
+    if (m_file.read(expectedHeader.size()) != expectedHeader) {
+        if (m_file.size() > 0)
+            qWarning() << "Discarding unrecognized message outbox" << m_path;
+        truncate();
+        return {};
+    }
+
+    // the file is unbuffered, so parse the records from a single read of it
+    const qint64 recordsStart = m_file.pos();
+    const QByteArray records = m_file.readAll();
+    QDataStream stream(records);
+    stream.setVersion(QDataStream::Qt_5_15);
+    auto pos = [&stream, recordsStart]() { return recordsStart + stream.device()->pos(); };
+
+    // end of the last complete record
+    qint64 validEnd = recordsStart;
+    while (!stream.atEnd()) {
+        quint8 type = 0;
+        MessageId id = 0;
+        stream >> type >> id;
+
+        if (type == QueuedRecord) {
+            qint64 msecs = 0;
+            QByteArray text;
+            stream >> msecs >> text;
+            if (stream.status() != QDataStream::Ok)
+                break;
+
+            auto it = m_live.find(id);
+            if (it != m_live.end())
+                m_deadBytes += it->recordSize;
+            m_live.insert(id, LiveEntry{
+                Entry{id, QDateTime::fromMSecsSinceEpoch(msecs), QString::fromUtf8(text)},
+                m_nextSequence++,
+                pos() - validEnd});
+        } else if (type == DoneRecord) {
+            if (stream.status() != QDataStream::Ok)
+                break;
+
+            auto it = m_live.find(id);
+            if (it != m_live.end()) {
+                m_deadBytes += it->recordSize;
+                m_live.erase(it);
+            }
+            m_deadBytes += pos() - validEnd;
+        } else {
+            break;
+        }
+
+        validEnd = pos();
+    }
+
+    if (validEnd < m_file.size()) {
+        qWarning() << "Dropping" << (m_file.size() - validEnd) << "bytes of incomplete records from message outbox" << m_path;
+        m_file.resize(validEnd);
+    }
+    m_file.seek(m_file.size());
+
+    QList<Entry> entries;
+    for (const LiveEntry *live : liveEntries())
+        entries.append(live->entry);
+
+    if (m_live.isEmpty())
+        truncate();
+    else if (m_file.size() >= CompactMinBytes && m_deadBytes * 2 > m_file.size())
+        compact();
+
+    return entries;
+}
+
+void MessageOutbox::append(const Entry &entry)
+{
+    if (!m_file.isOpen())
+        return;
+
+    const QByteArray record = queuedRecord(entry);
+    if (!write(record))
+        return;
+
+    auto it = m_live.find(entry.id);
+    if (it != m_live.end())
+        m_deadBytes += it->recordSize;
+    m_live.insert(entry.id, LiveEntry{entry, m_nextSequence++, record.size()});
+}
+
+void MessageOutbox::remove(MessageId id)
+{
+    auto it = m_live.find(id);
+    if (it == m_live.end())
+        return;
+
+    const qint64 recordSize = it->recordSize;
+    m_live.erase(it);
+
+    if (m_live.isEmpty()) {
+        truncate();
+        return;
+    }
+
+    // if the done record can't be written the message is sent again after a
+    // restart, but compaction still drops it
+    m_deadBytes += recordSize;
+    const QByteArray record = doneRecord(id);
+    if (write(record))
+        m_deadBytes += record.size();
+
+    if (m_file.size() >= CompactMinBytes && m_deadBytes * 2 > m_file.size())
+        compact();
+}
+
+void MessageOutbox::clear()
+{
+    m_live.clear();
+    truncate();
+}
+
+void MessageOutbox::removeFile()
+{
+    m_syncTimer.stop();
+    m_live.clear();
+    m_deadBytes = 0;
+    m_file.close();
+    QFile::remove(m_path);
+}
+
+std::vector<const MessageOutbox::LiveEntry*> MessageOutbox::liveEntries() const
+{
+    std::vector<const LiveEntry*> entries;
+    entries.reserve(static_cast<size_t>(m_live.size()));
+    for (const LiveEntry &live : m_live)
+        entries.push_back(&live);
+
+    std::sort(entries.begin(), entries.end(),
+        [](const LiveEntry *a, const LiveEntry *b) { return a->sequence < b->sequence; });
+    return entries;
+}
+
+bool MessageOutbox::write(const QByteArray &record)
+{
+    if (!m_file.isOpen() || m_broken)
+        return false;
+
+    const qint64 start = m_file.pos();
+    if (m_file.write(record) != record.size()) {
+        qWarning() << "Failed writing to message outbox" << m_path << ":" << m_file.errorString();
+        // load() stops at a torn record, which would lose every record
+        // appended after it
+        if (!m_file.resize(start) || !m_file.seek(start)) {
+            qWarning() << "Cannot remove torn record from message outbox" << m_path << ", no longer writing to it";
+            m_broken = true;
+            m_syncTimer.stop();
+            m_file.close();
+        }
+        return false;
+    }
+
+    if (!m_syncTimer.isActive())
+        m_syncTimer.start(SyncDelayMs);
+    return true;
+}
+
+void MessageOutbox::sync()
+{
+    m_syncTimer.stop();
+    if (!m_file.isOpen())
+        return;
+
+    m_file.flush();
+#ifdef Q_OS_UNIX
+    ::fsync(m_file.handle());
+#elif defined(Q_OS_WIN)
+    ::FlushFileBuffers(reinterpret_cast<HANDLE>(::_get_osfhandle(m_file.handle())));
+#endif
+}
+
+void MessageOutbox::truncate()
+{
+    m_deadBytes = 0;
+    if (!m_file.isOpen())
+        return;
+
+    m_file.resize(0);
+    m_file.seek(0);
+    write(header());
+}
+
+void MessageOutbox::compact()
+{
+    if (m_broken)
+        return;
+
+    const auto entries = liveEntries();
+
+    // QSaveFile syncs the new log before renaming it over the old one
+    QSaveFile out(m_path);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot compact message outbox" << m_path << ":" << out.errorString();
+        return;
+    }
+    // set on the temporary file, so the log is never readable by others
+    // once it is renamed over the old one
+    if (!out.setPermissions(FilePermissions)) {
+        qWarning() << "Cannot restrict permissions on message outbox" << m_path;
+        out.cancelWriting();
+        return;
+    }
+
+    std::vector<qint64> recordSizes;
+    recordSizes.reserve(entries.size());
+    out.write(header());
+    for (const LiveEntry *live : entries) {
+        const QByteArray record = queuedRecord(live->entry);
+        out.write(record);
+        recordSizes.push_back(record.size());
+    }
+
+    // the old log can't be replaced while it's open on some platforms
+    m_file.close();
+    const bool committed = out.commit();
+    if (!m_file.open(OpenMode)) {
+        qWarning() << "Cannot reopen message outbox" << m_path << ":" << m_file.errorString();
+        return;
+    }
+    m_file.seek(m_file.size());
+
+    if (!committed) {
+        qWarning() << "Failed compacting message outbox" << m_path << ":" << out.errorString();
+        return;
+    }
+
+    for (size_t i = 0; i < entries.size(); i++)
+        m_live[entries[i]->entry.id].recordSize = recordSizes[i];
+    m_deadBytes = 0;
+    m_syncTimer.stop();
+}
@@ -0,0 +1,127 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MESSAGEOUTBOX_H
+#define MESSAGEOUTBOX_H
+
+#include "protocol/ChatChannel.h"
+#include "utils/TimerWheel.h"
+
+/* Append-only on-disk log of a contact's unacknowledged outgoing messages
+ *
+ * Queuing a message appends a record holding it, and acknowledging or
+ * failing it appends a small record marking it done, so neither rewrites
+ * anything. Records reach the OS as they are written, but are synced to disk
+ * in batches at most SyncDelayMs after the first unsynced write: a crash
+ * loses nothing, power loss may lose the last moment of queued messages.
+ *
+ * Once most of the log is dead records it is rewritten with only the live
+ * messages, and it is truncated whenever nothing is left in it. A record
+ * torn by a crash mid-write is dropped when the log is loaded, and one torn
+ * by a failed write is cut off again straight away so later records aren't
+ * lost behind it. */
+class MessageOutbox
+{
+    Q_DISABLE_COPY(MessageOutbox)
+
+public:
+    typedef Protocol::ChatChannel::MessageId MessageId;
+
+    struct Entry
+    {
+        MessageId id;
+        QDateTime time;
+        QString text;
+    };
+
+    static constexpr int SyncDelayMs = 1000;
+    // logs smaller than this are never compacted
+    static constexpr qint64 CompactMinBytes = 64 * 1024;
+    // the log holds message text, so only its owner may read it
+    static constexpr QFileDevice::Permissions FilePermissions = QFileDevice::ReadOwner | QFileDevice::WriteOwner;
+    // unbuffered, so a failed write never leaves data behind in QFile that
+    // would stop the log being cut back to its last complete record
+    static constexpr QIODevice::OpenMode OpenMode = QIODevice::ReadWrite | QIODevice::Unbuffered;
+
+    explicit MessageOutbox(const QString &path);
+    ~MessageOutbox();
+
+    /* Open the log, creating it if needed, and return the messages still in
+     * it, oldest first */
+    QList<Entry> load();
+
+    void append(const Entry &entry);
+    /* Mark a message done; ids not in the log are ignored */
+    void remove(MessageId id);
+    void clear();
+    /* Close and delete the log, e.g. when the contact is removed */
+    void removeFile();
+
+private:
+    enum RecordType : quint8 {
+        QueuedRecord = 1,
+        DoneRecord = 2,
+    };
+
+    struct LiveEntry
+    {
+        Entry entry;
+        // append order, to keep it across compaction
+        quint64 sequence;
+        qint64 recordSize;
+    };
+
+    QString m_path;
+    QFile m_file;
+    QHash<MessageId, LiveEntry> m_live;
+    quint64 m_nextSequence;
+    qint64 m_deadBytes;
+    // set once a torn record couldn't be removed, nothing more is written
+    bool m_broken;
+    WheelTimer m_syncTimer;
+
+    static QByteArray header();
+    static QByteArray queuedRecord(const Entry &entry);
+    static QByteArray doneRecord(MessageId id);
+
+    // live entries in the order they were appended
+    std::vector<const LiveEntry*> liveEntries() const;
+
+    // false if the record wasn't written, in which case none of it is left
+    // in the log
+    bool write(const QByteArray &record);
+    void sync();
+    void truncate();
+    void compact();
+};
+
+#endif // MESSAGEOUTBOX_H
@@ -92,7 +92,7 @@ void OutgoingContactRequest::setStatus(Status newStatus)
 
         tego_bool_t requestAccepted = ((m_status == Accepted) ? TEGO_TRUE : TEGO_FALSE);
 
-        tego::g_globals.context->callback_registry_.emit_chat_request_response_received(userId.release(), requestAccepted);
+        tego::g_globals.context->callback_registry_.emit_chat_request_response_received(user->identity->toTegoIdentity(), userId.release(), requestAccepted);
     }
 
     emit statusChanged(newStatus, oldStatus);
@@ -39,11 +39,13 @@ using tego::g_globals;
 
 #include "UserIdentity.h"
 #include "tor/TorControl.h"
+#include "tor/TorManager.h"
 #include "tor/HiddenService.h"
 #include "core/ContactIDValidator.h"
 #include "core/ContactUser.h"
 #include "protocol/Connection.h"
 #include "utils/Useful.h"
+#include "utils/UnixSocket.h"
 
 using namespace Protocol;
 
@@ -53,17 +55,13 @@ UserIdentity::UserIdentity(int id, const QString& serviceID, QObject *parent)
     , contacts(this)
     , m_hiddenService(0)
     , m_incomingServer(0)
+    , m_unixServer(0)
 {
     setupService(serviceID);
 }
 
 UserIdentity *UserIdentity::createIdentity(int uniqueID)
 {
-    // There is actually no support for multiple identities currently.
-    Q_ASSERT(uniqueID == 0);
-    if (uniqueID != 0)
-        return 0;
-
     return new UserIdentity(uniqueID, "", {});
 }
 
@@ -101,6 +99,11 @@ void UserIdentity::setupService(const QString& serviceID)
 
     Q_ASSERT(m_hiddenService);
 
+    if (listenOnUnixSocket()) {
+        g_globals.context->torControl->addHiddenService(m_hiddenService);
+        return;
+    }
+
     m_incomingServer = new QTcpServer(this);
     if (!m_incomingServer->listen(QHostAddress::LocalHost, 0)) {
         // XXX error case
@@ -112,8 +115,42 @@ void UserIdentity::setupService(const QString& serviceID)
 
     m_hiddenService->addTarget(9878, m_incomingServer->serverAddress(), m_incomingServer->serverPort());
 
-    g_globals.context->torControl->setHiddenService(m_hiddenService);
-    g_globals.context->torControl->publishHiddenService();
+    g_globals.context->torControl->addHiddenService(m_hiddenService);
+}
+
+bool UserIdentity::listenOnUnixSocket()
+{
+    auto torManager = g_globals.context->torManager;
+    const QString socketPath = torManager->unixSocketPath(QStringLiteral("identity-%1.sock").arg(uniqueID));
+    if (socketPath.isEmpty())
+        return false;
+
+    m_unixServer = new UnixSocketServer(this);
+    // a tor we launched runs as us; a shared one must at least share our
+    // group, we never open the socket to every local user
+    m_unixServer->setSocketOptions(torManager->isExternal()
+        ? QLocalServer::UserAccessOption | QLocalServer::GroupAccessOption
+        : QLocalServer::UserAccessOption);
+    QLocalServer::removeServer(socketPath);
+    if (!m_unixServer->listen(socketPath)) {
+        qWarning() << "Failed to open incoming unix socket, falling back to TCP:" << m_unixServer->errorString();
+        delete m_unixServer;
+        m_unixServer = 0;
+        return false;
+    }
+
+    connect(m_unixServer, &QLocalServer::newConnection, this, &UserIdentity::onIncomingConnection);
+    m_hiddenService->addTarget(9878, socketPath);
+    return true;
+}
+
+QTcpSocket *UserIdentity::nextIncomingSocket()
+{
+    if (m_unixServer && m_unixServer->hasPendingConnections())
+        return m_unixServer->nextPendingSocket();
+    if (m_incomingServer && m_incomingServer->hasPendingConnections())
+        return m_incomingServer->nextPendingConnection();
+    return 0;
 }
 
 QString UserIdentity::hostname() const
@@ -139,8 +176,7 @@ QString UserIdentity::contactID() const
  */
 void UserIdentity::onIncomingConnection()
 {
-    while (m_incomingServer->hasPendingConnections()) {
-        QTcpSocket *socket = m_incomingServer->nextPendingConnection();
+    while (QTcpSocket *socket = nextIncomingSocket()) {
 
         /* The localHostname property is used by Connection to determine the
          * server onion hostname that this socket is connected to, which is
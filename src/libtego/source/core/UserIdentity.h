@@ -52,9 +52,8 @@ class QTcpServer;
  * In particular, it represents the published hidden service, and
  * theoretically holds the list of contacts.
  *
- * At present, implementation (and settings) assumes that there is
- * only one identity, but some code is confusingly written to allow
- * for several.
+ * A context may host several identities, each with its own onion service
+ * and listening socket, all published through the same tor instance.
  */
 class UserIdentity : public QObject
 {
@@ -70,6 +69,7 @@ public:
 
     /* Properties */
     int getUniqueID() const { return uniqueID; }
+    tego_identity_t toTegoIdentity() const { return static_cast<tego_identity_t>(uniqueID); }
     /* Hostname is .onion format, like ContactUser */
     QString hostname() const;
     QString contactID() const;
@@ -92,12 +92,16 @@ private slots:
 private:
     Tor::HiddenService *m_hiddenService;
     QTcpServer *m_incomingServer;
+    // used instead of m_incomingServer when talking to tor over unix sockets
+    class UnixSocketServer *m_unixServer;
     QVector<QSharedPointer<Protocol::Connection>> m_incomingConnections;
 
     static UserIdentity *createIdentity(int uniqueID);
 
     void handleIncomingAuthedConnection(Protocol::Connection *connection);
     void setupService(const QString& serviceID);
+    bool listenOnUnixSocket();
+    QTcpSocket *nextIncomingSocket();
 };
 
 Q_DECLARE_METATYPE(UserIdentity*)
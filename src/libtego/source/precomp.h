@@ -7,9 +7,16 @@
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <wincrypt.h>
+#include <io.h>
 // workaround because protobuffer defines a GetMessage function
 #undef GetMessage
 #endif
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 // standard library
 #include <stddef.h>
@@ -22,6 +29,9 @@
 #include <openssl/bio.h>
 #include <openssl/pem.h>
 
+// zlib
+#include <zlib.h>
+
 // tor
 #ifdef __cplusplus
 extern "C" {
@@ -45,22 +55,32 @@ extern "C" {
 #ifdef __cplusplus
 
 // standard library
+#include <algorithm>
 #include <array>
 #include <string_view>
 #include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
 #include <stdexcept>
 #include <memory>
+#include <functional>
 #include <thread>
 #include <mutex>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <list>
+#include <vector>
 #include <set>
 #include <sstream>
 #include <optional>
 #include <tuple>
+#include <unordered_map>
 #include <type_traits>
 #include <chrono>
+#include <limits>
+#include <utility>
 
 // fmt
 #include <fmt/format.h>
@@ -76,11 +96,13 @@ extern "C" {
 #include <QBuffer>
 #include <QClipboard>
 #include <QCoreApplication>
+#include <QDataStream>
 #include <QDateTime>
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QExplicitlySharedDataPointer>
 #include <QFileInfo>
+#include <QFileSystemWatcher>
 #include <QFlags>
 #include <QGuiApplication>
 #include <QHash>
@@ -89,6 +111,8 @@ extern "C" {
 #include <QJsonValue>
 #include <QList>
 #include <QLocale>
+#include <QLocalServer>
+#include <QLoggingCategory>
 #include <QMap>
 #include <QMessageAuthenticationCode>
 #include <QMetaType>
@@ -106,6 +130,7 @@ extern "C" {
 #include <QQuickItem>
 #include <QRegularExpression>
 #include <QRegularExpressionValidator>
+#include <QRunnable>
 #include <QSaveFile>
 #include <QScopedPointer>
 #include <QScreen>
@@ -119,6 +144,8 @@ extern "C" {
 #include <QtDebug>
 #include <QtEndian>
 #include <QtGlobal>
+#include <QThread>
+#include <QThreadPool>
 #include <QTime>
 #include <QTimer>
 #include <QtQml>
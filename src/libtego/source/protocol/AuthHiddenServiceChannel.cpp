@@ -31,14 +31,19 @@
  */
 
 #include "AuthHiddenServiceChannel.h"
+#include "AuthProofVerifier.h"
 #include "AuthHiddenService.pb.h"
 #include "Connection.h"
 #include "Channel_p.h"
 #include "utils/SecureRNG.h"
 #include "utils/CryptoKey.h"
 #include "utils/Useful.h"
+#include "utils/MessagePool.h"
 #include "utils/StringUtil.h"
+#include "context.hpp"
 #include "error.hpp"
+#include "globals.hpp"
+using tego::g_globals;
 
 using namespace Protocol;
 
@@ -52,10 +57,13 @@ public:
     CryptoKey privateKey;
     QByteArray clientCookie, serverCookie;
     bool accepted;
+    // a proof has been received and is being verified
+    bool proofPending;
 
     AuthHiddenServiceChannelPrivate(Channel *q, Channel::Direction dir, Connection *conn)
         : ChannelPrivate(q, QStringLiteral("im.ricochet.auth.hidden-service"), dir, conn)
         , accepted(false)
+        , proofPending(false)
     {
     }
 
@@ -200,13 +208,15 @@ void AuthHiddenServiceChannel::sendAuthMessage()
         return;
     }
 
-    QByteArray proofData = d->getProofData(d->privateKey.torServiceID());
-    auto signature = d->privateKey.signData(proofData);
+    const QByteArray serviceId = d->privateKey.torServiceID();
+    QByteArray proofData = d->getProofData(serviceId);
+    uint8_t signature[TEGO_ED25519_SIGNATURE_SIZE];
+    d->privateKey.signData(reinterpret_cast<const uint8_t*>(proofData.constData()), static_cast<size_t>(proofData.size()), signature);
 
     QScopedPointer<Data::AuthHiddenService::Proof> proof(new Data::AuthHiddenService::Proof);
-    proof->set_signature(std::string(signature.constData(), static_cast<size_t>(signature.size())));
+    proof->set_signature(reinterpret_cast<const char*>(signature), sizeof(signature));
 
-    proof->set_service_id(d->privateKey.torServiceID().toStdString());
+    proof->set_service_id(serviceId.constData(), static_cast<size_t>(serviceId.size()));
 
     Data::AuthHiddenService::Packet message;
     message.set_allocated_proof(proof.take());
@@ -257,16 +267,16 @@ QByteArray AuthHiddenServiceChannelPrivate::getProofMessage(const QByteArray& cl
 
 void AuthHiddenServiceChannel::receivePacket(const QByteArray &packet)
 {
-    Data::AuthHiddenService::Packet message;
-    if (!message.ParseFromArray(packet.constData(), packet.size())) {
+    auto message = MessagePool<Data::AuthHiddenService::Packet>::acquire();
+    if (!message->ParseFromArray(packet.constData(), packet.size())) {
         closeChannel();
         return;
     }
 
-    if (message.has_proof()) {
-        handleProof(message.proof());
-    } else if (message.has_result()) {
-        handleResult(message.result());
+    if (message->has_proof()) {
+        handleProof(message->proof());
+    } else if (message->has_result()) {
+        handleResult(message->result());
     } else {
         qWarning() << "Unrecognized message on" << type();
         closeChannel();
@@ -283,6 +293,12 @@ void AuthHiddenServiceChannel::handleProof(const Data::AuthHiddenService::Proof
         return;
     }
 
+    if (d->proofPending) {
+        qWarning() << "Received duplicate proof on" << type();
+        closeChannel();
+        return;
+    }
+
     if (d->clientCookie.size() != COOKIE_SIZE || d->serverCookie.size() != COOKIE_SIZE) {
         TEGO_BUG() << "AuthHiddenServiceChannel can't create a proof without valid cookies";
         closeChannel();
@@ -294,34 +310,44 @@ void AuthHiddenServiceChannel::handleProof(const Data::AuthHiddenService::Proof
     QByteArray signature(message.signature().c_str(), static_cast<int>(message.signature().size()));
     QByteArray serviceId(message.service_id().c_str(), static_cast<int>(message.service_id().size()));
 
-    QScopedPointer<Data::AuthHiddenService::Result> result(new Data::AuthHiddenService::Result);
+    if (signature.size() != TEGO_ED25519_SIGNATURE_SIZE) {
+        qWarning() << "Received Signature with incorrect size from" << type();
+        finishProof(serviceId, false);
+        return;
+    }
 
-    result->set_accepted(false);
+    if (serviceId.size() != TEGO_V3_ONION_SERVICE_ID_LENGTH) {
+        qWarning() << "Unable to parse public key from" << type();
+        finishProof(serviceId, false);
+        return;
+    }
 
-    if (signature.size() == TEGO_ED25519_SIGNATURE_SIZE)
-    {
-        CryptoKey publicKey;
-        if(publicKey.loadFromServiceId(serviceId))
-        {
-            auto proofData = d->getProofData(serviceId);
-            if (publicKey.verifyData(proofData, signature))
-            {
-                result->set_accepted(true);
-            }
-            else
-            {
+    // The signature check itself happens off the main thread; the channel
+    // stays open until the result comes back. Proofs claiming a contact get a
+    // budget of their own, so a flood of connections can't lock contacts out
+    const bool knownContact = g_globals.context->is_known_contact(connection()->serverHostname(), QString::fromLatin1(serviceId));
+    auto proofData = d->getProofData(serviceId);
+    d->proofPending = AuthProofVerifier::instance()->verify(serviceId, knownContact, proofData, signature, this,
+        [this, serviceId](bool valid) {
+            if (!valid)
                 qWarning() << "Signature verification failed on" << type();
-            }
-        }
-        else
-        {
-            qWarning() << "Unable to parse public key from" << type();
-        }
-    }
-    else
-    {
-        qWarning() << "Received Signature with incorrect size from" << type();
-    }
+            finishProof(serviceId, valid);
+        });
+
+    if (!d->proofPending)
+        finishProof(serviceId, false);
+}
+
+void AuthHiddenServiceChannel::finishProof(const QByteArray &serviceId, bool accepted)
+{
+    Q_D(AuthHiddenServiceChannel);
+
+    d->proofPending = false;
+    if (!isOpened())
+        return;
+
+    QScopedPointer<Data::AuthHiddenService::Result> result(new Data::AuthHiddenService::Result);
+    result->set_accepted(accepted);
 
     if (result->accepted())
     {
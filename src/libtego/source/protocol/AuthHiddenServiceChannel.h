@@ -49,6 +49,8 @@ class AuthHiddenServiceChannel : public Channel
     Q_DECLARE_PRIVATE(AuthHiddenServiceChannel)
 
 public:
+    static constexpr TypeId ChannelTypeId = TypeId::AuthHiddenService;
+
     explicit AuthHiddenServiceChannel(Direction direction, Connection *connection);
 
     void setPrivateKey(const CryptoKey &key);
@@ -68,6 +70,7 @@ protected:
 
 private:
     void handleProof(const Data::AuthHiddenService::Proof &message);
+    void finishProof(const QByteArray &serviceId, bool accepted);
     void handleResult(const Data::AuthHiddenService::Result &message);
 };
 
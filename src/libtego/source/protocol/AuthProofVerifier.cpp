@@ -0,0 +1,155 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "AuthProofVerifier.h"
+#include "utils/CryptoKey.h"
+
+using namespace Protocol;
+
+// Per-verification timings, disabled by default since floods of proofs are
+// what the verifier exists to absorb; enable with
+// QT_LOGGING_RULES="tego.protocol.authproof.debug=true"
+Q_LOGGING_CATEGORY(authProofTrace, "tego.protocol.authproof", QtWarningMsg)
+
+AuthProofVerifier *AuthProofVerifier::instance()
+{
+    static AuthProofVerifier *p = 0;
+    if (!p)
+        p = new AuthProofVerifier(qApp);
+    return p;
+}
+
+AuthProofVerifier::AuthProofVerifier(QObject *parent)
+    : QObject(parent)
+    , m_unknownBucket{UnknownRateLimitBurst, 0}
+    , m_pending(0)
+{
+    // verification is cheap enough that a couple of threads keeps up with any
+    // legitimate load, and bounds how much CPU a flood can take from us
+    m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 2));
+    m_pool.setObjectName(QStringLiteral("AuthProofVerifier"));
+    m_clock.start();
+}
+
+AuthProofVerifier::~AuthProofVerifier()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+bool AuthProofVerifier::takeToken(Bucket &bucket, int burst, qint64 refillMs, qint64 now)
+{
+    const qint64 refills = (now - bucket.lastRefill) / refillMs;
+    if (refills > 0) {
+        bucket.tokens = static_cast<int>(qMin<qint64>(burst, bucket.tokens + refills));
+        bucket.lastRefill += refills * refillMs;
+    }
+
+    if (bucket.tokens == 0)
+        return false;
+
+    --bucket.tokens;
+    return true;
+}
+
+bool AuthProofVerifier::verify(const QByteArray &serviceId, bool knownContact, const QByteArray &message, const QByteArray &signature,
+                               QObject *context, std::function<void(bool)> callback)
+{
+    if (m_pending >= MaxPending + (knownContact ? ContactPendingReserve : 0)) {
+        ++m_stats.rejectedQueueFull;
+        qWarning() << "Refusing to verify authentication proof, too many pending";
+        return false;
+    }
+
+    const qint64 now = m_clock.elapsed();
+    bool allowed;
+    if (knownContact) {
+        auto bucket = m_contactBuckets.find(serviceId);
+        if (bucket == m_contactBuckets.end())
+            bucket = m_contactBuckets.insert(serviceId, Bucket{ContactRateLimitBurst, now});
+        allowed = takeToken(*bucket, ContactRateLimitBurst, ContactRateLimitRefillMs, now);
+    } else {
+        allowed = takeToken(m_unknownBucket, UnknownRateLimitBurst, UnknownRateLimitRefillMs, now);
+    }
+
+    if (!allowed) {
+        ++m_stats.rejectedRateLimited;
+        qWarning() << "Refusing to verify authentication proof, rate limit exceeded";
+        return false;
+    }
+
+    ++m_pending;
+    const qint64 submitted = m_clock.nsecsElapsed();
+    QPointer<QObject> guard(context);
+
+    // contacts' proofs go ahead of any unknown ones still queued
+    m_pool.start(QRunnable::create([=]() {
+        const bool valid = verifyProof(serviceId, message, signature);
+
+        QMetaObject::invokeMethod(this, [=]() {
+            --m_pending;
+
+            const qint64 latencyUs = (m_clock.nsecsElapsed() - submitted) / 1000;
+            ++m_stats.verified;
+            m_stats.totalLatencyUs += latencyUs;
+            m_stats.maxLatencyUs = qMax(m_stats.maxLatencyUs, latencyUs);
+            qCDebug(authProofTrace) << "Verified authentication proof in" << latencyUs << "us;"
+                                    << m_stats.verified << "verified, mean" << (m_stats.totalLatencyUs / static_cast<qint64>(m_stats.verified)) << "us";
+
+            if (guard)
+                callback(valid);
+        }, Qt::QueuedConnection);
+    }), knownContact ? 1 : 0);
+
+    return true;
+}
+
+bool AuthProofVerifier::verifyProof(const QByteArray &serviceId, const QByteArray &message, const QByteArray &signature)
+{
+    try {
+        CryptoKey publicKey;
+        if (!publicKey.loadFromServiceId(serviceId)) {
+            qWarning() << "Unable to parse public key for authentication proof";
+            return false;
+        }
+        if (signature.size() != TEGO_ED25519_SIGNATURE_SIZE)
+            return false;
+
+        uint8_t signatureBytes[TEGO_ED25519_SIGNATURE_SIZE];
+        std::copy(signature.begin(), signature.end(), signatureBytes);
+        return publicKey.verifyData(reinterpret_cast<const uint8_t*>(message.constData()), static_cast<size_t>(message.size()), signatureBytes);
+    } catch (const std::exception &ex) {
+        qWarning() << "Authentication proof verification failed:" << ex.what();
+        return false;
+    }
+}
@@ -0,0 +1,121 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef PROTOCOL_AUTHPROOFVERIFIER_H
+#define PROTOCOL_AUTHPROOFVERIFIER_H
+
+namespace Protocol
+{
+
+/* Verifies inbound AuthHiddenService proofs away from the main thread
+ *
+ * Anyone who knows our service id can open connections and send proofs, so
+ * decoding the claimed public key and checking the ed25519 signature happens
+ * on a small dedicated thread pool. Work is refused rather than queued without
+ * bound: there is a cap on outstanding verifications, and token buckets rate
+ * limit them.
+ *
+ * Each connection sends a single proof, so a flood is a flood of new
+ * connections, and the only thing they can't share out between them is the
+ * id a proof claims. Proofs claiming one of our contacts are charged to that
+ * contact's own bucket and may use a few pending slots kept back for them;
+ * all other proofs share one bucket. A flood claiming unknown ids can then
+ * only delay contacts' proofs behind its own, and one claiming a contact's id
+ * only locks out that contact, and only if it knows the id.
+ *
+ * Results are delivered on the thread the verifier lives on (the main thread),
+ * and only if the context object passed to verify() still exists. */
+class AuthProofVerifier : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(AuthProofVerifier)
+
+public:
+    // maximum verifications queued or running at once for unknown ids
+    static constexpr int MaxPending = 32;
+    // further verifications only proofs claiming a contact may use
+    static constexpr int ContactPendingReserve = 8;
+    // token bucket of each contact: burst size and refill interval
+    static constexpr int ContactRateLimitBurst = 4;
+    static constexpr qint64 ContactRateLimitRefillMs = 2000;
+    // token bucket shared by every proof claiming an unknown id, so opening
+    // more connections can't buy a flood more verifications per second
+    static constexpr int UnknownRateLimitBurst = 64;
+    static constexpr qint64 UnknownRateLimitRefillMs = 25;
+
+    struct Statistics
+    {
+        quint64 verified = 0;
+        quint64 rejectedQueueFull = 0;
+        quint64 rejectedRateLimited = 0;
+        // time from submission to result, in microseconds
+        qint64 totalLatencyUs = 0;
+        qint64 maxLatencyUs = 0;
+    };
+
+    static AuthProofVerifier *instance();
+
+    explicit AuthProofVerifier(QObject *parent = nullptr);
+    ~AuthProofVerifier();
+
+    /* Queue verification of signature over message by the key of serviceId,
+     * which knownContact says is one of our contacts. Returns false without
+     * invoking callback if the request was refused; otherwise callback(valid)
+     * is later invoked unless context was destroyed in the meantime. */
+    bool verify(const QByteArray &serviceId, bool knownContact, const QByteArray &message, const QByteArray &signature,
+                QObject *context, std::function<void(bool)> callback);
+
+    const Statistics &statistics() const { return m_stats; }
+
+private:
+    struct Bucket
+    {
+        int tokens;
+        qint64 lastRefill;
+    };
+
+    QThreadPool m_pool;
+    QElapsedTimer m_clock;
+    // by claimed service id, so at most one per contact
+    QHash<QByteArray, Bucket> m_contactBuckets;
+    Bucket m_unknownBucket;
+    int m_pending;
+    Statistics m_stats;
+
+    static bool takeToken(Bucket &bucket, int burst, qint64 refillMs, qint64 now);
+    static bool verifyProof(const QByteArray &serviceId, const QByteArray &message, const QByteArray &signature);
+};
+
+}
+
+#endif
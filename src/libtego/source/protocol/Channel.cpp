@@ -41,24 +41,49 @@
 
 using namespace Protocol;
 
+Channel::TypeId Channel::typeFromName(const QString &type)
+{
+    static const QHash<QString,TypeId> registry = {
+        { QStringLiteral("control"), TypeId::Control },
+        { QStringLiteral("im.ricochet.auth.hidden-service"), TypeId::AuthHiddenService },
+        { QStringLiteral("im.ricochet.chat"), TypeId::Chat },
+        { QStringLiteral("im.ricochet.contact.request"), TypeId::ContactRequest },
+        { QStringLiteral("im.ricochet.file-transfer"), TypeId::File },
+    };
+    return registry.value(type, TypeId::Unknown);
+}
+
 Channel *Channel::create(const QString &type, Direction direction, Connection *connection)
 {
     if (!connection)
         return 0;
 
-    if (type == QStringLiteral("im.ricochet.auth.hidden-service")) {
-        return new AuthHiddenServiceChannel(direction, connection);
-    } else if (type == QStringLiteral("im.ricochet.chat")) {
-        return new ChatChannel(direction, connection);
-    } else if (type == QStringLiteral("im.ricochet.contact.request")) {
-        return new ContactRequestChannel(direction, connection);
-    } else if (type == QStringLiteral("im.ricochet.file-transfer")) {
-        return new FileChannel(direction, connection);
-    } else {
-        return 0;
+    // The control channel is implicit in every connection and never created by name
+    switch (typeFromName(type)) {
+        case TypeId::AuthHiddenService:
+            return new AuthHiddenServiceChannel(direction, connection);
+        case TypeId::Chat:
+            return new ChatChannel(direction, connection);
+        case TypeId::ContactRequest:
+            return new ContactRequestChannel(direction, connection);
+        case TypeId::File:
+            return new FileChannel(direction, connection);
+        default:
+            return 0;
     }
 }
 
+const QStringList &Channel::supportedFeatures()
+{
+    // Channel types list the features they understand here, alongside their
+    // entry in create(). Feature names are namespaced by channel type, e.g.
+    // "im.ricochet.chat.some-feature"
+    static const QStringList features = {
+        QString::fromLatin1(ChatChannel::BatchFeature),
+    };
+    return features;
+}
+
 Channel::Channel(const QString &type, Direction direction, Connection *connection)
     : QObject(connection)
     , d_ptr(new ChannelPrivate(this, type, direction, connection))
@@ -84,6 +109,12 @@ QString Channel::type() const
     return d->type;
 }
 
+Channel::TypeId Channel::typeId() const
+{
+    Q_D(const Channel);
+    return d->typeId;
+}
+
 // May return -1 for unassigned channels
 int Channel::identifier() const
 {
@@ -290,6 +321,7 @@ ChannelPrivate::ChannelPrivate(Channel *q, const QString &c_type, Channel::Direc
     : q_ptr(q)
     , connection(conn)
     , type(c_type)
+    , typeId(Channel::typeFromName(c_type))
     , identifier(-1)
     , direction(dir)
     , isOpened(false)
@@ -78,13 +78,43 @@ public:
         Outbound
     };
 
+    /* The channel types we implement, interned from their protocol names
+     *
+     * Each subclass declares its own as a static ChannelTypeId member, which
+     * Connection::findChannel uses for constant time lookup.
+     */
+    enum class TypeId {
+        Unknown = -1,
+        Control,
+        AuthHiddenService,
+        Chat,
+        ContactRequest,
+        File,
+        Count
+    };
+
+    /* Look up the interned type of a protocol channel type name
+     *
+     * Returns TypeId::Unknown if 'type' is unrecognized.
+     */
+    static TypeId typeFromName(const QString &type);
+
     /* Create a Channel instance of the specified type
      *
      * Returns null if 'type' is unrecognized.
      */
     static Channel *create(const QString &type, Direction direction, Connection *connection);
 
+    /* Optional protocol features understood by the channel types we implement
+     *
+     * The client side of a connection offers these to the peer with an
+     * EnableFeatures message after the version handshake; the features both
+     * sides understand can then be queried with Connection::hasFeature.
+     */
+    static const QStringList &supportedFeatures();
+
     QString type() const;
+    TypeId typeId() const;
     int identifier() const;
     Direction direction() const;
     Connection *connection();
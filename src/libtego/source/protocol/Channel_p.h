@@ -53,6 +53,7 @@ public:
     Channel *q_ptr;
     Connection *connection;
     QString type;
+    Channel::TypeId typeId;
     int identifier;
     Channel::Direction direction;
     bool isOpened;
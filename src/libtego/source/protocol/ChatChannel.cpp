@@ -34,18 +34,32 @@
 #include "Channel_p.h"
 #include "Connection.h"
 #include "utils/Useful.h"
+#include "utils/MessagePool.h"
+#include "utils/PayloadCompression.h"
+
+#include "context.hpp"
+#include "globals.hpp"
+
+using tego::g_globals;
 
 using namespace Protocol;
 
 ChatChannel::ChatChannel(Direction direction, Connection *connection)
     : Channel(QStringLiteral("im.ricochet.chat"), direction, connection)
+    , outgoingBatchBytes(0)
+    , batchFlushScheduled(false)
+    , maxMessageSize(0)
+    , compressText(false)
 {
 }
 
-bool ChatChannel::allowInboundChannelRequest(const Data::Control::OpenChannel *request, Data::Control::ChannelResult *result)
+bool ChatChannel::batchingEnabled() const
 {
-    Q_UNUSED(request);
+    return connection()->hasFeature(QString::fromLatin1(BatchFeature));
+}
 
+bool ChatChannel::allowInboundChannelRequest(const Data::Control::OpenChannel *request, Data::Control::ChannelResult *result)
+{
     if (connection()->purpose() != Connection::Purpose::KnownContact) {
         qDebug() << "Rejecting request for" << type() << "channel from connection with purpose" << int(connection()->purpose());
         result->set_common_error(Data::Control::ChannelResult::UnauthorizedError);
@@ -57,13 +71,26 @@ bool ChatChannel::allowInboundChannelRequest(const Data::Control::OpenChannel *r
         return false;
     }
 
+    // accept long messages up to our own limit if the sender offers them
+    if (request->HasExtension(Data::Chat::offered_max_message_size)) {
+        const quint32 limit = std::min(request->GetExtension(Data::Chat::offered_max_message_size),
+                                       g_globals.context->get_max_message_size());
+        if (limit > 0) {
+            maxMessageSize = limit;
+            result->SetExtension(Data::Chat::max_message_size, limit);
+        }
+    }
+
+    if (request->GetExtension(Data::Chat::offered_zlib_text) && g_globals.context->get_payload_compression()) {
+        compressText = true;
+        result->SetExtension(Data::Chat::zlib_text, true);
+    }
+
     return true;
 }
 
 bool ChatChannel::allowOutboundChannelRequest(Data::Control::OpenChannel *request)
 {
-    Q_UNUSED(request);
-
     if (connection()->findChannel<ChatChannel>(Channel::Outbound)) {
         TEGO_BUG() << "Rejecting outbound request for" << type() << "channel because one is already open on this connection";
         return false;
@@ -74,21 +101,63 @@ bool ChatChannel::allowOutboundChannelRequest(Data::Control::OpenChannel *reques
         return false;
     }
 
+    // offer long messages, remembering our offer until the recipient answers
+    maxMessageSize = g_globals.context->get_max_message_size();
+    if (maxMessageSize > 0)
+        request->SetExtension(Data::Chat::offered_max_message_size, maxMessageSize);
+
+    compressText = g_globals.context->get_payload_compression();
+    if (compressText)
+        request->SetExtension(Data::Chat::offered_zlib_text, true);
+
+    return true;
+}
+
+bool ChatChannel::processChannelOpenResult(const Data::Control::ChannelResult *result)
+{
+    if (!result->opened())
+        return false;
+
+    const quint32 offered = std::exchange(maxMessageSize, 0);
+    if (result->HasExtension(Data::Chat::max_message_size)) {
+        const quint32 accepted = result->GetExtension(Data::Chat::max_message_size);
+        if (accepted == 0 || accepted > offered) {
+            qDebug() << "Received ChannelResult for" << type() << "with invalid max_message_size" << accepted;
+            return false;
+        }
+        maxMessageSize = accepted;
+    }
+
+    const bool offeredCompression = std::exchange(compressText, false);
+    if (result->GetExtension(Data::Chat::zlib_text)) {
+        if (!offeredCompression) {
+            qDebug() << "Received ChannelResult for" << type() << "with unexpected zlib_text";
+            return false;
+        }
+        compressText = true;
+    }
+
     return true;
 }
 
 void ChatChannel::receivePacket(const QByteArray &packet)
 {
-    Data::Chat::Packet message;
-    if (!message.ParseFromArray(packet.constData(), packet.size())) {
+    auto message = MessagePool<Data::Chat::Packet>::acquire();
+    if (!message->ParseFromArray(packet.constData(), packet.size())) {
         closeChannel();
         return;
     }
 
-    if (message.has_chat_message()) {
-        handleChatMessage(message.chat_message());
-    } else if (message.has_chat_acknowledge()) {
-        handleChatAcknowledge(message.chat_acknowledge());
+    if (message->has_chat_message()) {
+        handleChatMessage(message->chat_message());
+    } else if (message->has_chat_acknowledge()) {
+        handleChatAcknowledge(message->chat_acknowledge());
+    } else if (message->chat_messages_size() > 0 && batchingEnabled()) {
+        handleChatMessageBatch(message->chat_messages());
+    } else if (message->chat_acknowledge_ranges_size() > 0 && batchingEnabled()) {
+        handleChatAcknowledgeRanges(message->chat_acknowledge_ranges());
+    } else if (message->has_chat_message_fragment()) {
+        handleChatMessageFragment(message->chat_message_fragment());
     } else {
         qWarning() << "Unrecognized message on" << type();
         closeChannel();
@@ -103,23 +172,53 @@ bool ChatChannel::sendChatMessageWithId(QString text, QDateTime time, MessageId
         return false;
     }
 
-    QScopedPointer<Data::Chat::ChatMessage> message(new Data::Chat::ChatMessage);
-    message->set_message_id(id);
-
     if (text.isEmpty()) {
         TEGO_BUG() << "Chat message is empty, and it should've been discarded";
         return false;
     } else if (text.size() > MessageMaxCharacters) {
-        TEGO_BUG() << "Chat message is too long (" << text.size() << "characters), and it should've been limited already. Truncated.";
+        if (maxMessageSize > 0)
+            return sendLongMessage(text, time, id);
+
+        qWarning() << "Chat message is too long (" << text.size() << "characters) for a peer without long message support. Truncated.";
         text.truncate(MessageMaxCharacters);
     }
 
-    // Also converts to UTF-8
-    message->set_message_text(text.toStdString());
+    QScopedPointer<Data::Chat::ChatMessage> message(new Data::Chat::ChatMessage);
+    message->set_message_id(id);
+
+    const QByteArray utf8 = text.toUtf8();
+    const QByteArray compressed = compressText ? PayloadCompression::compress(utf8.constData(), utf8.size()) : QByteArray();
+    if (compressed.isNull()) {
+        message->set_message_text(utf8.constData(), static_cast<size_t>(utf8.size()));
+    } else {
+        message->set_message_text(std::string());
+        message->set_compressed_text(compressed.constData(), static_cast<size_t>(compressed.size()));
+    }
 
     if (!time.isNull())
         message->set_time_delta(qMin(QDateTime::currentDateTime().secsTo(time), qint64(0)));
 
+    if (batchingEnabled()) {
+        // tag and length prefix of the message within the batch
+        const int size = static_cast<int>(message->ByteSizeLong()) + 4;
+        if (outgoingBatch.chat_messages_size() >= MaxBatchMessages || outgoingBatchBytes + size > MaxBatchBytes)
+            flushBatch();
+
+        outgoingBatch.mutable_chat_messages()->AddAllocated(message.take());
+        outgoingBatchBytes += size;
+        pendingMessages.insert(id);
+
+        if (!batchFlushScheduled) {
+            batchFlushScheduled = true;
+            QMetaObject::invokeMethod(this,
+                [this]() {
+                    batchFlushScheduled = false;
+                    flushBatch();
+                }, Qt::QueuedConnection);
+        }
+        return true;
+    }
+
     Data::Chat::Packet packet;
     packet.set_allocated_chat_message(message.take());
     if (!Channel::sendMessage(packet))
@@ -129,38 +228,184 @@ bool ChatChannel::sendChatMessageWithId(QString text, QDateTime time, MessageId
     return true;
 }
 
-void ChatChannel::handleChatMessage(const Data::Chat::ChatMessage &message)
+bool ChatChannel::sendLongMessage(const QString &text, const QDateTime &time, MessageId id)
 {
-    QScopedPointer<Data::Chat::ChatAcknowledge> response(new Data::Chat::ChatAcknowledge);
+    const QByteArray utf8 = text.toUtf8();
+    if (static_cast<quint32>(utf8.size()) > maxMessageSize) {
+        qWarning() << "Chat message of" << utf8.size() << "bytes is larger than the peer accepts (" << maxMessageSize << "bytes)";
+        return false;
+    }
 
-    // QString::fromStdString decodes the string as UTF-8, replacing all invalid sequences and
-    // codepoints with the unicode replacement character.
-    QString text = QString::fromStdString(message.message_text());
+    // the whole text is compressed before it is split up
+    const QByteArray compressed = compressText ? PayloadCompression::compress(utf8.constData(), utf8.size()) : QByteArray();
+    const QByteArray &data = compressed.isNull() ? utf8 : compressed;
 
+    // fragments go out back to back, after anything already batched
+    flushBatch();
+
+    Data::Chat::Packet packet;
+    auto fragment = packet.mutable_chat_message_fragment();
+    fragment->set_message_id(id);
+    fragment->set_total_size(static_cast<quint32>(data.size()));
+    if (!compressed.isNull())
+        fragment->set_compressed(true);
+    if (!time.isNull())
+        fragment->set_time_delta(qMin(QDateTime::currentDateTime().secsTo(time), qint64(0)));
+
+    for (int offset = 0; offset < data.size(); offset += FragmentSize) {
+        fragment->set_text(data.constData() + offset, static_cast<size_t>(std::min(FragmentSize, data.size() - offset)));
+        // sending only fails once the channel is closed, which also discards
+        // the partial message at the recipient
+        if (!Channel::sendMessage(packet))
+            return false;
+
+        fragment->clear_total_size();
+        fragment->clear_compressed();
+        fragment->clear_time_delta();
+    }
+
+    pendingMessages.insert(id);
+    return true;
+}
+
+void ChatChannel::flushBatch()
+{
+    if (outgoingBatch.chat_messages_size() == 0)
+        return;
+
+    // take the batch first, handlers of a failure may queue more messages
+    Data::Chat::Packet packet;
+    packet.Swap(&outgoingBatch);
+    outgoingBatchBytes = 0;
+
+    if (Channel::sendMessage(packet))
+        return;
+
+    for (const auto &message : packet.chat_messages()) {
+        MessageId id = message.message_id();
+        if (pendingMessages.remove(id))
+            emit messageAcknowledged(id, false);
+    }
+}
+
+bool ChatChannel::deliverMessage(const QString &text, qint64 timeDelta, MessageId id)
+{
     if (direction() != Inbound) {
         qWarning() << "Rejected inbound message on an outbound chat channel";
-        response->set_accepted(false);
+        return false;
     } else if (text.isEmpty()) {
         qWarning() << "Rejected empty chat message";
-        response->set_accepted(false);
-    } else if (text.size() > MessageMaxCharacters) {
+        return false;
+    }
+
+    QDateTime time = QDateTime::currentDateTime();
+    if (timeDelta < 0)
+        time = time.addSecs(timeDelta);
+
+    emit messageReceived(text, time, id);
+    return true;
+}
+
+void ChatChannel::acknowledgeMessage(MessageId id, bool accepted)
+{
+    QScopedPointer<Data::Chat::ChatAcknowledge> response(new Data::Chat::ChatAcknowledge);
+    response->set_message_id(id);
+    response->set_accepted(accepted);
+
+    Data::Chat::Packet packet;
+    packet.set_allocated_chat_acknowledge(response.take());
+    Channel::sendMessage(packet);
+}
+
+bool ChatChannel::receiveChatMessage(const Data::Chat::ChatMessage &message)
+{
+    // QString::fromStdString decodes the string as UTF-8, replacing all invalid sequences and
+    // codepoints with the unicode replacement character.
+    QString text = QString::fromStdString(message.message_text());
+
+    if (message.has_compressed_text()) {
+        const auto &payload = message.compressed_text();
+        const QByteArray utf8 = compressText && text.isEmpty()
+            ? PayloadCompression::uncompress(payload.data(), static_cast<int>(payload.size()), MaxShortMessageBytes)
+            : QByteArray();
+        if (utf8.isNull()) {
+            qWarning() << "Rejected unexpected or malformed compressed chat message";
+            return false;
+        }
+        text = QString::fromUtf8(utf8);
+    }
+
+    if (text.size() > MessageMaxCharacters) {
         qWarning() << "Rejected oversize chat message of" << text.size() << "characters";
-        response->set_accepted(false);
-    } else {
-        QDateTime time = QDateTime::currentDateTime();
-        if (message.has_time_delta() && message.time_delta() <= 0)
-            time = time.addSecs(message.time_delta());
+        return false;
+    }
+
+    return deliverMessage(text, message.time_delta(), message.message_id());
+}
+
+void ChatChannel::handleChatMessage(const Data::Chat::ChatMessage &message)
+{
+    const bool accepted = receiveChatMessage(message);
+
+    if (message.has_message_id())
+        acknowledgeMessage(message.message_id(), accepted);
+}
+
+void ChatChannel::handleChatMessageFragment(const Data::Chat::ChatMessageFragment &fragment)
+{
+    if (direction() != Inbound || maxMessageSize == 0) {
+        qWarning() << "Rejected unexpected chat message fragment on" << type();
+        closeChannel();
+        return;
+    }
+
+    if (!incomingLongMessage) {
+        if (!fragment.has_total_size() || fragment.total_size() == 0 || fragment.total_size() > maxMessageSize) {
+            qWarning() << "Rejected long chat message of" << fragment.total_size() << "bytes";
+            closeChannel();
+            return;
+        }
 
-        emit messageReceived(text, time, message.message_id());
-        response->set_accepted(true);
+        if (fragment.compressed() && !compressText) {
+            qWarning() << "Rejected compressed long chat message on" << type();
+            closeChannel();
+            return;
+        }
+
+        incomingLongMessage = IncomingLongMessage{fragment.message_id(), fragment.total_size(), fragment.time_delta(),
+                                                  fragment.compressed(), QByteArray()};
+        incomingLongMessage->text.reserve(static_cast<int>(fragment.total_size()));
+    } else if (fragment.message_id() != incomingLongMessage->id || fragment.has_total_size() || fragment.has_compressed()) {
+        qWarning() << "Rejected chat message fragment interleaved with long message" << incomingLongMessage->id;
+        closeChannel();
+        return;
     }
 
-    if (message.has_message_id()) {
-        response->set_message_id(message.message_id());
-        Data::Chat::Packet packet;
-        packet.set_allocated_chat_acknowledge(response.take());
-        Channel::sendMessage(packet);
+    const auto &data = fragment.text();
+    if (data.empty() || incomingLongMessage->text.size() + data.size() > incomingLongMessage->totalSize) {
+        qWarning() << "Rejected chat message fragment overrunning long message" << incomingLongMessage->id;
+        closeChannel();
+        return;
     }
+
+    incomingLongMessage->text.append(data.data(), static_cast<int>(data.size()));
+    if (static_cast<quint32>(incomingLongMessage->text.size()) < incomingLongMessage->totalSize)
+        return;
+
+    const IncomingLongMessage message = std::move(*incomingLongMessage);
+    incomingLongMessage.reset();
+
+    const QByteArray utf8 = message.compressed
+        ? PayloadCompression::uncompress(message.text.constData(), message.text.size(), static_cast<int>(maxMessageSize))
+        : message.text;
+    if (utf8.isNull())
+        qWarning() << "Rejected malformed compressed long message" << message.id;
+
+    // QString::fromUtf8 replaces invalid sequences, as for short messages
+    // message_id is required on fragments and 0 is as valid an id as any
+    // other, so a long message is always acknowledged
+    const bool accepted = !utf8.isNull() && deliverMessage(QString::fromUtf8(utf8), message.timeDelta, message.id);
+    acknowledgeMessage(message.id, accepted);
 }
 
 void ChatChannel::handleChatAcknowledge(const Data::Chat::ChatAcknowledge &message)
@@ -185,3 +430,60 @@ void ChatChannel::handleChatAcknowledge(const Data::Chat::ChatAcknowledge &messa
     }
 }
 
+void ChatChannel::handleChatMessageBatch(const google::protobuf::RepeatedPtrField<Data::Chat::ChatMessage> &messages)
+{
+    if (messages.size() > MaxBatchMessages) {
+        qWarning() << "Rejected chat batch of" << messages.size() << "messages";
+        closeChannel();
+        return;
+    }
+
+    // consecutive ids with the same result share one range
+    Data::Chat::Packet response;
+    Data::Chat::ChatAcknowledgeRange *range = nullptr;
+    for (const auto &message : messages) {
+        bool accepted = receiveChatMessage(message);
+        if (!message.has_message_id())
+            continue;
+
+        MessageId id = message.message_id();
+        if (range && range->accepted() == accepted && range->first_message_id() + range->count() == id) {
+            range->set_count(range->count() + 1);
+        } else {
+            range = response.add_chat_acknowledge_ranges();
+            range->set_first_message_id(id);
+            range->set_count(1);
+            range->set_accepted(accepted);
+        }
+    }
+
+    if (response.chat_acknowledge_ranges_size() > 0)
+        Channel::sendMessage(response);
+}
+
+void ChatChannel::handleChatAcknowledgeRanges(const google::protobuf::RepeatedPtrField<Data::Chat::ChatAcknowledgeRange> &ranges)
+{
+    if (direction() != Outbound) {
+        qWarning() << "Rejected inbound acknowledgement on an inbound chat channel";
+        closeChannel();
+        return;
+    }
+
+    for (const auto &range : ranges) {
+        // we never batch more than this, so a longer range can't be an answer to us
+        if (range.count() > static_cast<quint32>(MaxBatchMessages)) {
+            qWarning() << "Rejected chat acknowledgement range of" << range.count() << "messages";
+            closeChannel();
+            return;
+        }
+
+        for (quint32 i = 0; i < range.count(); i++) {
+            MessageId id = range.first_message_id() + i;
+            if (pendingMessages.remove(id)) {
+                emit messageAcknowledged(id, range.accepted());
+            } else {
+                qDebug() << "Received chat acknowledgement for unknown message" << id;
+            }
+        }
+    }
+}
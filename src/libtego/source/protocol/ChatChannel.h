@@ -45,8 +45,32 @@ class ChatChannel : public Channel
     Q_DISABLE_COPY(ChatChannel)
 
 public:
+    static constexpr TypeId ChannelTypeId = TypeId::Chat;
+
     typedef quint32 MessageId;
-    static const int MessageMaxCharacters = 2000;
+    static const int MessageMaxCharacters = TEGO_MESSAGE_MAX_SHORT_CHARACTERS;
+
+    /* With this feature negotiated, messages sent within one pass of the
+     * event loop share a packet, and each batch is answered with ranges of
+     * acknowledgements over consecutive message ids. messageAcknowledged is
+     * still emitted once per message. */
+    static constexpr const char *BatchFeature = "im.ricochet.chat.batch";
+    // limits on a single batch, which also bound the size of an ack range
+    static const int MaxBatchMessages = 128;
+    static const int MaxBatchBytes = 48 * 1024;
+
+    /* Messages over MessageMaxCharacters are sent as fragments of this many
+     * bytes of UTF-8, if the peer accepts long messages, up to the
+     * max_message_size agreed when the channel opened. Without that they
+     * are truncated. */
+    static const int FragmentSize = 32 * 1024;
+
+    /* Text is sent compressed if both peers agreed on zlib_text when the
+     * channel opened and PayloadCompression shrinks it; long messages are
+     * compressed whole, then fragmented. A compressed short message may
+     * inflate to at most this many bytes, the UTF-8 of MessageMaxCharacters
+     * UTF-16 units. */
+    static const int MaxShortMessageBytes = MessageMaxCharacters * 3;
 
     explicit ChatChannel(Direction direction, Connection *connection);
 
@@ -59,13 +83,46 @@ signals:
 protected:
     virtual bool allowInboundChannelRequest(const Data::Control::OpenChannel *request, Data::Control::ChannelResult *result);
     virtual bool allowOutboundChannelRequest(Data::Control::OpenChannel *request);
+    virtual bool processChannelOpenResult(const Data::Control::ChannelResult *result);
     virtual void receivePacket(const QByteArray &packet);
 
 private:
     QSet<MessageId> pendingMessages;
+    // messages waiting for the end of this event loop pass, in batch mode
+    Data::Chat::Packet outgoingBatch;
+    int outgoingBatchBytes;
+    bool batchFlushScheduled;
+    // largest long message in bytes, 0 if the peer doesn't support them; the
+    // outbound side holds its offer here until the recipient answers
+    quint32 maxMessageSize;
+    // whether message text may be compressed; as with maxMessageSize, the
+    // outbound side holds its offer here until the recipient answers
+    bool compressText;
+
+    struct IncomingLongMessage
+    {
+        MessageId id;
+        quint32 totalSize;
+        qint64 timeDelta;
+        bool compressed;
+        QByteArray text;
+    };
+    // long message being reassembled on an inbound channel
+    std::optional<IncomingLongMessage> incomingLongMessage;
+
+    bool batchingEnabled() const;
+    void flushBatch();
+
+    bool sendLongMessage(const QString &text, const QDateTime &time, MessageId id);
 
+    bool deliverMessage(const QString &text, qint64 timeDelta, MessageId id);
+    void acknowledgeMessage(MessageId id, bool accepted);
+    bool receiveChatMessage(const Data::Chat::ChatMessage &message);
     void handleChatMessage(const Data::Chat::ChatMessage &message);
+    void handleChatMessageBatch(const google::protobuf::RepeatedPtrField<Data::Chat::ChatMessage> &messages);
+    void handleChatMessageFragment(const Data::Chat::ChatMessageFragment &fragment);
     void handleChatAcknowledge(const Data::Chat::ChatAcknowledge &message);
+    void handleChatAcknowledgeRanges(const google::protobuf::RepeatedPtrField<Data::Chat::ChatAcknowledgeRange> &ranges);
 };
 
 }
@@ -36,6 +36,13 @@
 
 using namespace Protocol;
 
+// Full dumps of protocol messages, disabled by default since rendering them is
+// expensive and peers control when it happens; enable with
+// QT_LOGGING_RULES="tego.protocol.trace.debug=true"
+Q_LOGGING_CATEGORY(protocolTrace, "tego.protocol.trace", QtWarningMsg)
+
+Connection::Statistics ConnectionPrivate::totalStats;
+
 Connection::Connection(QTcpSocket *socket, Direction direction)
     : QObject()
     , d(new ConnectionPrivate(this))
@@ -47,27 +54,31 @@ ConnectionPrivate::ConnectionPrivate(Connection *qq)
     : QObject(qq)
     , q(qq)
     , socket(0)
+    , channelsByType()
+    , channelRequestLimit(ChannelRequestBurst, ChannelRequestRefillMs)
+    , channelRejectLimit(ChannelRejectBurst, ChannelRejectRefillMs)
+    , unknownChannelReplyLimit(UnknownChannelReplyBurst, UnknownChannelReplyRefillMs)
     , direction(Connection::ClientSide)
     , purpose(Connection::Purpose::Unknown)
     , wasClosed(false)
     , handshakeDone(false)
+    , featuresRequested(false)
+    , featuresNegotiated(false)
     , nextOutboundChannelId(-1)
 {
     ageTimer.start();
 
-    QTimer *timeout = new QTimer(this);
-    timeout->setSingleShot(true);
-    timeout->setInterval(UnknownPurposeTimeout * 1000);
-    connect(timeout, &QTimer::timeout, this,
-        [this,timeout]() {
+    purposeTimeout.setCallback(
+        [this]() {
             if (purpose == Connection::Purpose::Unknown) {
                 qDebug() << "Closing connection" << q << "with unknown purpose after timeout";
                 q->close();
             }
-            timeout->deleteLater();
         }
     );
-    timeout->start();
+    purposeTimeout.start(UnknownPurposeTimeout * 1000);
+
+    closeTimeout.setCallback([this]() { closeImmediately(); });
 }
 
 Connection::~Connection()
@@ -197,10 +208,8 @@ void Connection::close()
         d->socket->disconnectFromHost();
 
         // If not fully closed in 5 seconds, abort
-        QTimer *timeout = new QTimer(this);
-        timeout->setSingleShot(true);
-        connect(timeout, &QTimer::timeout, d, &ConnectionPrivate::closeImmediately);
-        timeout->start(5000);
+        if (!d->closeTimeout.isActive())
+            d->closeTimeout.start(5000);
     }
 }
 
@@ -259,8 +268,16 @@ void ConnectionPrivate::socketReadable()
                 emit q->versionNegotiationFailed();
                 socket->abort();
                 return;
-            } else
+            } else {
+                // Offer our optional features before anything else goes over the control channel
+                ControlChannel *control = qobject_cast<ControlChannel*>(q->channel(0));
+                if (!control || !control->sendEnableFeatures()) {
+                    TEGO_BUG() << "Failed to send EnableFeatures on new outbound connection";
+                    socket->abort();
+                    return;
+                }
                 emit q->ready();
+            }
         } else if (direction == Connection::ServerSide && available >= 3) {
             // Expecting at least 3 bytes
             uchar intro[3] = { 0 };
@@ -380,13 +397,16 @@ void ConnectionPrivate::socketReadable()
 
         Channel *channel = q->channel(channelId);
         if (!channel) {
-            // XXX We should sanity-check and rate limit these responses better
+            count(&Connection::Statistics::unknownChannelPackets);
             if (data.isEmpty()) {
-                qDebug() << "Ignoring channel close message for non-existent channel" << channelId;
-            } else {
-                qDebug() << "Ignoring" << data.size() << "byte packet for non-existent channel" << channelId;
+                qCDebug(protocolTrace) << "Ignoring channel close message for non-existent channel" << channelId;
+            } else if (unknownChannelReplyLimit.take(ageTimer.elapsed())) {
+                qCDebug(protocolTrace) << "Ignoring" << data.size() << "byte packet for non-existent channel" << channelId;
                 // Send channel close message
                 writePacket(channelId, QByteArray());
+            } else {
+                // Don't let a peer turn its garbage into writes of ours
+                count(&Connection::Statistics::unknownChannelRepliesSuppressed);
             }
             continue;
         }
@@ -541,6 +561,10 @@ bool ConnectionPrivate::insertChannel(Channel *channel)
     }
 
     channels.insert(channel->identifier(), channel);
+
+    Channel **slot = channelTypeSlot(channel->typeId(), channel->direction());
+    if (slot && !*slot)
+        *slot = channel;
     return true;
 }
 
@@ -559,6 +583,30 @@ void ConnectionPrivate::removeChannel(Channel *channel)
         else
             it++;
     }
+
+    // Likewise, search the type table by pointer. If another channel of the same
+    // type and direction is open, it takes over the slot.
+    for (auto &slots : channelsByType) {
+        for (size_t dir = 0; dir < slots.size(); dir++) {
+            if (slots[dir] != channel)
+                continue;
+            slots[dir] = nullptr;
+            for (Channel *c : qAsConst(channels)) {
+                if (c->typeId() == channel->typeId() && c->direction() == static_cast<Channel::Direction>(dir)) {
+                    slots[dir] = c;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+Channel **ConnectionPrivate::channelTypeSlot(Channel::TypeId type, Channel::Direction dir)
+{
+    if (type == Channel::TypeId::Unknown || type == Channel::TypeId::Count ||
+        (dir != Channel::Inbound && dir != Channel::Outbound))
+        return nullptr;
+    return &channelsByType[static_cast<size_t>(type)][static_cast<size_t>(dir)];
 }
 
 void ConnectionPrivate::closeAllChannels()
@@ -571,11 +619,85 @@ void ConnectionPrivate::closeAllChannels()
         TEGO_BUG() << "Channels remain open on connection after calling closeAllChannels";
 }
 
-QHash<int,Channel*> Connection::channels()
+void ConnectionPrivate::setEnabledFeatures(const QStringList &features)
+{
+    enabledFeatures = features;
+    featuresNegotiated = true;
+    if (!features.isEmpty())
+        qDebug() << "Enabled features on connection" << q << ":" << features;
+    emit q->featuresEnabled(features);
+}
+
+bool Connection::hasFeature(const QString &feature) const
+{
+    return d->enabledFeatures.contains(feature);
+}
+
+QStringList Connection::features() const
+{
+    return d->enabledFeatures;
+}
+
+bool Connection::featuresNegotiated() const
+{
+    return d->featuresNegotiated;
+}
+
+ConnectionPrivate::RateLimit::RateLimit(int b, qint64 r)
+    : burst(b)
+    , refillMs(r)
+    , tokens(b)
+    , lastRefill(0)
+{
+}
+
+bool ConnectionPrivate::RateLimit::take(qint64 now)
+{
+    const qint64 refills = (now - lastRefill) / refillMs;
+    if (refills > 0) {
+        tokens = static_cast<int>(qMin<qint64>(burst, tokens + refills));
+        lastRefill += refills * refillMs;
+    }
+
+    if (tokens == 0)
+        return false;
+
+    --tokens;
+    return true;
+}
+
+void ConnectionPrivate::count(quint64 Connection::Statistics::*counter)
+{
+    ++(stats.*counter);
+    ++(totalStats.*counter);
+}
+
+const Connection::Statistics &Connection::statistics() const
+{
+    return d->stats;
+}
+
+const Connection::Statistics &Connection::totalStatistics()
+{
+    return ConnectionPrivate::totalStats;
+}
+
+const QHash<int,Channel*> &Connection::channels() const
 {
     return d->channels;
 }
 
+Channel *Connection::channelOfType(Channel::TypeId type, Channel::Direction direction)
+{
+    if (direction == Channel::Invalid) {
+        Channel *inbound = channelOfType(type, Channel::Inbound);
+        return inbound ? inbound : channelOfType(type, Channel::Outbound);
+    }
+
+    Channel **slot = d->channelTypeSlot(type, direction);
+    return slot ? *slot : nullptr;
+}
+
 Channel *Connection::channel(int identifier)
 {
     return d->channels.value(identifier);
@@ -626,6 +748,7 @@ bool Connection::setPurpose(Purpose value)
 
     Purpose old = d->purpose;
     d->purpose = value;
+    d->purposeTimeout.stop();
     emit purposeChanged(d->purpose, old);
     return true;
 }
@@ -139,8 +139,24 @@ public:
     Purpose purpose() const;
     bool setPurpose(Purpose purpose);
 
-    QHash<int,Channel*> channels();
+    /* Optional protocol features enabled on this connection
+     *
+     * Features are negotiated on the control channel right after the version
+     * handshake: the client offers Channel::supportedFeatures() and the server
+     * enables those it also supports. Peers which predate negotiation enable
+     * none. Control channel messages are ordered, so the server knows the
+     * result before it handles any of the client's channel requests, and the
+     * client knows it before it sees the server's response to any of them.
+     */
+    bool hasFeature(const QString &feature) const;
+    QStringList features() const;
+    bool featuresNegotiated() const;
+
+    const QHash<int,Channel*> &channels() const;
     Channel *channel(int identifier);
+    /* First channel of the given type and direction (or either direction if
+     * Invalid), found in constant time */
+    Channel *channelOfType(Channel::TypeId type, Channel::Direction direction = Channel::Invalid);
     template<typename T> T *findChannel(Channel::Direction direction = Channel::Invalid);
     template<typename T> QList<T*> findChannels(Channel::Direction direction = Channel::Invalid);
 
@@ -149,6 +165,25 @@ public:
         KnownToPeer // For outbound connections, set when the peer indicates we are a known contact
     };
 
+    /* Counters for peer behaviour the connection refused or limited
+     *
+     * A peer can make us do work by opening channels, sending requests we have
+     * to reject, or sending packets for channels that don't exist. Each of
+     * these is rate limited per connection; these counters show how often
+     * that happened, on this connection or on all connections in total.
+     */
+    struct Statistics
+    {
+        quint64 channelRequests = 0;
+        quint64 channelRequestsRejected = 0;
+        quint64 channelRequestsRateLimited = 0;
+        quint64 unknownChannelPackets = 0;
+        quint64 unknownChannelRepliesSuppressed = 0;
+    };
+
+    const Statistics &statistics() const;
+    static const Statistics &totalStatistics();
+
     bool hasAuthenticated(AuthenticationType type) const;
     bool hasAuthenticatedAs(AuthenticationType type, const QString &identity) const;
     QString authenticatedIdentity(AuthenticationType type) const;
@@ -214,6 +249,9 @@ signals:
      * opened. At this point, the channel can be used or closed normally.
      */
     void channelOpened(Channel *channel);
+    /* Emitted once the set of features enabled on the connection is known
+     */
+    void featuresEnabled(const QStringList &features);
 
 private:
     ConnectionPrivate *d;
@@ -221,21 +259,15 @@ private:
 
 template<typename T> T *Connection::findChannel(Channel::Direction direction)
 {
-    T *re = 0;
-    foreach (Channel *c, channels()) {
-        if (direction != Channel::Invalid && c->direction() != direction)
-            continue;
-        if ((re = qobject_cast<T*>(c)))
-            return re;
-    }
-    return 0;
+    // a channel's TypeId always matches its class, see Channel::typeFromName
+    return static_cast<T*>(channelOfType(T::ChannelTypeId, direction));
 }
 
 template<typename T> QList<T*> Connection::findChannels(Channel::Direction direction)
 {
     QList<T*> re;
     T *tmp = 0;
-    foreach (Channel *c, channels()) {
+    for (Channel *c : channels()) {
         if (direction != Channel::Invalid && c->direction() != direction)
             continue;
         if ((tmp = qobject_cast<T*>(c)))
@@ -34,6 +34,9 @@
 #define PROTOCOL_CONNECTION_P_H
 
 #include "Connection.h"
+#include "utils/TimerWheel.h"
+
+Q_DECLARE_LOGGING_CATEGORY(protocolTrace)
 
 namespace Protocol
 {
@@ -50,6 +53,28 @@ public:
     static const int PacketMaxDataSize = UINT16_MAX - PacketHeaderSize;
     // Time in seconds before a connection with a purpose of Unknown is killed
     static const int UnknownPurposeTimeout = 15;
+    // Per connection limits on work a peer can cause, as burst size and
+    // milliseconds to regain one token. Exceeding the limits for channel
+    // requests or rejections kills the connection; replies to packets for
+    // unknown channels are silently dropped instead.
+    static const int ChannelRequestBurst = 32;
+    static const int ChannelRequestRefillMs = 500;
+    static const int ChannelRejectBurst = 8;
+    static const int ChannelRejectRefillMs = 2000;
+    static const int UnknownChannelReplyBurst = 16;
+    static const int UnknownChannelReplyRefillMs = 1000;
+
+    /* Token bucket, refilled lazily from the connection's age timer */
+    struct RateLimit
+    {
+        RateLimit(int burst, qint64 refillMs);
+        bool take(qint64 now);
+
+        const int burst;
+        const qint64 refillMs;
+        int tokens;
+        qint64 lastRefill;
+    };
 
     explicit ConnectionPrivate(Connection *q);
     virtual ~ConnectionPrivate();
@@ -57,12 +82,25 @@ public:
     Connection *q;
     QTcpSocket *socket;
     QHash<int,Channel*> channels;
+    // first channel of each type and direction, indexed by [TypeId][Direction]
+    std::array<std::array<Channel*,2>,static_cast<size_t>(Channel::TypeId::Count)> channelsByType;
     QMap<Connection::AuthenticationType,QString> authentication;
     QElapsedTimer ageTimer;
+    WheelTimer purposeTimeout;
+    WheelTimer closeTimeout;
+    RateLimit channelRequestLimit;
+    RateLimit channelRejectLimit;
+    RateLimit unknownChannelReplyLimit;
+    Connection::Statistics stats;
+    static Connection::Statistics totalStats;
     Connection::Direction direction;
     Connection::Purpose purpose;
     bool wasClosed;
     bool handshakeDone;
+    // optional features both peers agreed on, see Connection::hasFeature
+    QStringList enabledFeatures;
+    bool featuresRequested;
+    bool featuresNegotiated;
 
     void setSocket(QTcpSocket *socket, Connection::Direction direction);
 
@@ -71,12 +109,18 @@ public:
 
     bool insertChannel(Channel *channel);
     void removeChannel(Channel *channel);
+    Channel **channelTypeSlot(Channel::TypeId type, Channel::Direction direction);
 
     void closeAllChannels();
 
     bool writePacket(Channel *channel, const QByteArray &data);
     bool writePacket(int channelId, const QByteArray &data);
 
+    void setEnabledFeatures(const QStringList &features);
+
+    // increments a counter for this connection and the process wide totals
+    void count(quint64 Connection::Statistics::*counter);
+
 public slots:
     void closeImmediately();
 
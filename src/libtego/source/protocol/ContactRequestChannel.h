@@ -45,6 +45,8 @@ class ContactRequestChannel : public Channel
     Q_DISABLE_COPY(ContactRequestChannel)
 
 public:
+    static constexpr TypeId ChannelTypeId = TypeId::ContactRequest;
+
     typedef Data::ContactRequest::Response::Status Status;
 
     explicit ContactRequestChannel(Direction direction, Connection *connection);
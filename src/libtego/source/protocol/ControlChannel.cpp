@@ -34,6 +34,7 @@
 #include "Channel_p.h"
 #include "Connection_p.h"
 #include "utils/Useful.h"
+#include "utils/MessagePool.h"
 
 using namespace Protocol;
 
@@ -127,23 +128,23 @@ bool ControlChannel::processChannelOpenResult(const Data::Control::ChannelResult
 
 void ControlChannel::receivePacket(const QByteArray &packet)
 {
-    Data::Control::Packet message;
-    if (!message.ParseFromArray(packet.constData(), packet.size())) {
+    auto message = MessagePool<Data::Control::Packet>::acquire();
+    if (!message->ParseFromArray(packet.constData(), packet.size())) {
         qWarning() << "Control channel failed parsing packet; connection will be killed";
         closeChannel();
         return;
     }
 
-    if (message.has_open_channel()) {
-        handleOpenChannel(message.open_channel());
-    } else if (message.has_channel_result()) {
-        handleChannelResult(message.channel_result());
-    } else if (message.has_keep_alive()) {
-        handleKeepAlive(message.keep_alive());
-    } else if (message.has_enable_features()) {
-        handleEnableFeatures(message.enable_features());
-    } else if (message.has_features_enabled()) {
-        handleFeaturesEnabled(message.features_enabled());
+    if (message->has_open_channel()) {
+        handleOpenChannel(message->open_channel());
+    } else if (message->has_channel_result()) {
+        handleChannelResult(message->channel_result());
+    } else if (message->has_keep_alive()) {
+        handleKeepAlive(message->keep_alive());
+    } else if (message->has_enable_features()) {
+        handleEnableFeatures(message->enable_features());
+    } else if (message->has_features_enabled()) {
+        handleFeaturesEnabled(message->features_enabled());
     } else {
         qWarning() << "Unrecognized message on control channel; connection will be killed";
         closeChannel();
@@ -153,11 +154,21 @@ void ControlChannel::receivePacket(const QByteArray &packet)
 
 void ControlChannel::handleOpenChannel(const Data::Control::OpenChannel &message)
 {
+    ConnectionPrivate *cd = connection()->d;
+    cd->count(&Connection::Statistics::channelRequests);
+    if (!cd->channelRequestLimit.take(cd->ageTimer.elapsed())) {
+        cd->count(&Connection::Statistics::channelRequestsRateLimited);
+        qWarning() << "Peer is opening channels too quickly; connection will be killed";
+        closeChannel();
+        return;
+    }
+
     // Validate channel_identifier
     int id = message.channel_identifier();
     Connection::Direction peerSide = (connection()->direction() == Connection::ClientSide) ? Connection::ServerSide : Connection::ClientSide;
-    if (!connection()->d->isValidAvailableChannelId(id, peerSide)) {
-        qWarning() << "Received OpenChannel with invalid channel_identifier:" << QString::fromStdString(message.DebugString());
+    if (!cd->isValidAvailableChannelId(id, peerSide)) {
+        qWarning() << "Received OpenChannel with invalid channel_identifier:" << id;
+        qCDebug(protocolTrace) << QString::fromStdString(message.DebugString());
         // Deliberately invalid behavior; kill the connection
         closeChannel();
         return;
@@ -202,10 +213,20 @@ void ControlChannel::handleOpenChannel(const Data::Control::OpenChannel &message
     }
 
     if (!response->opened()) {
-        qDebug() << "Rejected OpenChannel request:" << QString::fromStdString(message.DebugString()) << "response:" << QString::fromStdString(response->DebugString());
+        qDebug() << "Rejected OpenChannel request for" << QString::fromStdString(message.channel_type()) << "channel" << id;
+        qCDebug(protocolTrace) << "request:" << QString::fromStdString(message.DebugString()) << "response:" << QString::fromStdString(response->DebugString());
         // Clean up channel instance
         delete channel;
         channel = 0;
+
+        cd->count(&Connection::Statistics::channelRequestsRejected);
+        if (!cd->channelRejectLimit.take(cd->ageTimer.elapsed())) {
+            cd->count(&Connection::Statistics::channelRequestsRateLimited);
+            qWarning() << "Peer has had too many channel requests rejected; connection will be killed";
+            delete response;
+            closeChannel();
+            return;
+        }
     }
 
     Data::Control::Packet responseMessage;
@@ -221,12 +242,14 @@ void ControlChannel::handleChannelResult(const Data::Control::ChannelResult &mes
     int id = message.channel_identifier();
     Channel *channel = connection()->channel(id);
     if (!channel) {
-        qWarning() << "Received ChannelResult for unknown identifier, ignoring:" << QString::fromStdString(message.DebugString());
+        qWarning() << "Received ChannelResult for unknown identifier, ignoring:" << id;
+        qCDebug(protocolTrace) << QString::fromStdString(message.DebugString());
         return;
     }
 
     if (channel->direction() != Outbound || channel->isOpened()) {
-        qWarning() << "Received (duplicate?) ChannelResult for existing channel in an unexpected state:" << QString::fromStdString(message.DebugString());
+        qWarning() << "Received (duplicate?) ChannelResult for existing channel in an unexpected state:" << id;
+        qCDebug(protocolTrace) << QString::fromStdString(message.DebugString());
         return;
     }
 
@@ -265,20 +288,80 @@ void ControlChannel::handleKeepAlive(const Data::Control::KeepAlive &message)
     }
 }
 
+bool ControlChannel::sendEnableFeatures()
+{
+    ConnectionPrivate *cd = connection()->d;
+    if (cd->featuresRequested || cd->featuresNegotiated) {
+        TEGO_BUG() << "EnableFeatures sent more than once on a connection";
+        return false;
+    }
+
+    const QStringList &supported = Channel::supportedFeatures();
+    if (supported.isEmpty()) {
+        // Nothing to offer, so nothing can be enabled
+        cd->setEnabledFeatures(QStringList());
+        return true;
+    }
+
+    Data::Control::EnableFeatures *request = new Data::Control::EnableFeatures;
+    for (const QString &feature : supported)
+        request->add_feature(feature.toStdString());
+
+    Data::Control::Packet packet;
+    packet.set_allocated_enable_features(request);
+    cd->featuresRequested = true;
+    return sendMessage(packet);
+}
+
 void ControlChannel::handleEnableFeatures(const Data::Control::EnableFeatures &message)
 {
-    Q_UNUSED(message);
-    // This version does not support any features.
+    ConnectionPrivate *cd = connection()->d;
+    if (connection()->direction() != Connection::ServerSide || cd->featuresNegotiated) {
+        qWarning() << "Received unexpected EnableFeatures message; connection will be killed";
+        closeChannel();
+        return;
+    }
+
+    // Enable the requested features we also support, ignoring any we don't
+    const QStringList &supported = Channel::supportedFeatures();
+    QStringList enabled;
     Data::Control::Packet responseMessage;
-    responseMessage.mutable_features_enabled();
+    Data::Control::FeaturesEnabled *response = responseMessage.mutable_features_enabled();
+    for (const std::string &requested : message.feature()) {
+        const QString feature = QString::fromStdString(requested);
+        if (supported.contains(feature) && !enabled.contains(feature)) {
+            enabled.append(feature);
+            response->add_feature(requested);
+        }
+    }
+
+    cd->setEnabledFeatures(enabled);
     sendMessage(responseMessage);
 }
 
 void ControlChannel::handleFeaturesEnabled(const Data::Control::FeaturesEnabled &message)
 {
-    Q_UNUSED(message);
-    // This version does not generate EnableFeatures messages, so receiving this is an error.
-    qDebug() << "Unexpectedly received FeaturesEnabled message from peer, but we never send EnableFeatures";
-    closeChannel();
+    ConnectionPrivate *cd = connection()->d;
+    if (!cd->featuresRequested || cd->featuresNegotiated) {
+        qWarning() << "Received FeaturesEnabled message without sending EnableFeatures; connection will be killed";
+        closeChannel();
+        return;
+    }
+
+    // The peer may only enable features we offered
+    const QStringList &supported = Channel::supportedFeatures();
+    QStringList enabled;
+    for (const std::string &feature : message.feature()) {
+        const QString name = QString::fromStdString(feature);
+        if (!supported.contains(name)) {
+            qWarning() << "Peer enabled a feature we did not offer:" << name << "; connection will be killed";
+            closeChannel();
+            return;
+        }
+        if (!enabled.contains(name))
+            enabled.append(name);
+    }
+
+    cd->setEnabledFeatures(enabled);
 }
 
@@ -47,8 +47,12 @@ class ControlChannel : public Channel
     friend class ConnectionPrivate;
 
 public:
+    static constexpr TypeId ChannelTypeId = TypeId::Control;
+
     bool sendOpenChannel(Channel *channel);
     void keepAlive();
+    /* Offer our optional features to the peer; sent once by the client side */
+    bool sendEnableFeatures();
 
 signals:
     void keepAliveResponse();
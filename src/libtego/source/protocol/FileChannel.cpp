@@ -35,6 +35,8 @@
 #include "Connection.h"
 #include "utils/SecureRNG.h"
 #include "utils/Useful.h"
+#include "utils/MessagePool.h"
+#include "utils/PayloadCompression.h"
 
 #include "context.hpp"
 #include "error.hpp"
@@ -81,19 +83,20 @@ FileChannel::incoming_transfer_record::incoming_transfer_record(
 : id(transferId)
 , size(fileSize)
 , hash(fileHash)
-, stream()
 { }
 
 FileChannel::incoming_transfer_record::~incoming_transfer_record()
 {
-    if (this->stream.is_open())
+    if (this->file)
     {
-        // try our best to remove the partial file
-        this->stream.close();
-
-        // ignore error here, if incoming request succeeded then the
-        // partial should no longer exist
-        QFile::remove(QString::fromStdString(this->partial_dest()));
+        // the writer removes the partial file once any pending writes are done,
+        // if the transfer completed then the partial no longer exists
+        FileChunkWriter::instance()->discard(std::move(this->file));
+    }
+    else if (this->opening)
+    {
+        // queued behind the open, so whatever it creates is removed
+        FileChunkWriter::instance()->discard(std::move(this->opening));
     }
 }
 
@@ -102,18 +105,6 @@ std::string FileChannel::incoming_transfer_record::partial_dest() const
     return dest + ".part";
 }
 
-void FileChannel::incoming_transfer_record::open_stream(const std::string& destination)
-{
-    this->dest = destination;
-
-    // attempt to open the destination for reading and writing
-    // discard previous contents
-    // binary mode
-    // we need to read to validate the hash after the transfer completes
-    this->stream.open(this->partial_dest(), std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
-    TEGO_THROW_IF_FALSE(this->stream.is_open());
-}
-
 //
 // File Channel
 //
@@ -121,11 +112,15 @@ void FileChannel::incoming_transfer_record::open_stream(const std::string& desti
 FileChannel::FileChannel(Direction direction, Connection *connection)
     : Channel(QStringLiteral("im.ricochet.file-transfer"), direction, connection)
 {
+    // the largest configurable chunk must still fit in a single packet when raw framed
+    static_assert(TEGO_FILE_TRANSFER_MAX_CHUNK_SIZE + RawChunkHeaderSize <= ConnectionPrivate::PacketMaxDataSize);
+    static_assert(TEGO_FILE_TRANSFER_DEFAULT_CHUNK_SIZE <= FileMaxChunkSize);
+
     connect(this->d_ptr->connection, &Connection::closed, this, &FileChannel::onConnectionClosed);
 }
 
 bool FileChannel::allowInboundChannelRequest(
-    const Data::Control::OpenChannel*,
+    const Data::Control::OpenChannel *request,
     Data::Control::ChannelResult *result)
 {
     if (connection()->purpose() != Connection::Purpose::KnownContact) {
@@ -139,11 +134,28 @@ bool FileChannel::allowInboundChannelRequest(
         return false;
     }
 
+    // accept raw chunks if the sender offers them, capped to what we are willing to buffer;
+    // older senders don't offer and older receivers don't answer, so both fall back to FileChunk
+    if (request->HasExtension(Data::File::offered_raw_chunk_size)) {
+        const auto requested = request->GetExtension(Data::File::offered_raw_chunk_size);
+        if (requested >= TEGO_FILE_TRANSFER_MIN_CHUNK_SIZE) {
+            this->rawChunkSize = std::min<uint32_t>(requested, TEGO_FILE_TRANSFER_MAX_CHUNK_SIZE);
+            result->SetExtension(Data::File::raw_chunk_size, this->rawChunkSize);
+
+            // compressed chunks are only ever raw
+            if (request->GetExtension(Data::File::offered_zlib_chunks) &&
+                g_globals.context->get_payload_compression()) {
+                this->compressChunks = true;
+                result->SetExtension(Data::File::zlib_chunks, true);
+            }
+        }
+    }
+
     return true;
 }
 
 bool FileChannel::allowOutboundChannelRequest(
-    Data::Control::OpenChannel*)
+    Data::Control::OpenChannel *request)
 {
     if (connection()->findChannel<FileChannel>(Channel::Outbound)) {
         TEGO_BUG() << "Rejecting outbound request for" << type() << "channel because one is already open on this connection";
@@ -155,6 +167,41 @@ bool FileChannel::allowOutboundChannelRequest(
         return false;
     }
 
+    // offer raw chunks, remembering our offer until the receiver answers
+    this->rawChunkSize = g_globals.context->get_file_transfer_chunk_size();
+    request->SetExtension(Data::File::offered_raw_chunk_size, this->rawChunkSize);
+    this->compressChunks = g_globals.context->get_payload_compression();
+    if (this->compressChunks) {
+        request->SetExtension(Data::File::offered_zlib_chunks, true);
+    }
+    return true;
+}
+
+bool FileChannel::processChannelOpenResult(const Data::Control::ChannelResult *result)
+{
+    if (!result->opened()) {
+        return false;
+    }
+
+    const auto offered = std::exchange(this->rawChunkSize, 0);
+    if (result->HasExtension(Data::File::raw_chunk_size)) {
+        const auto accepted = result->GetExtension(Data::File::raw_chunk_size);
+        if (accepted < TEGO_FILE_TRANSFER_MIN_CHUNK_SIZE || accepted > offered) {
+            qDebug() << "Received ChannelResult for" << type() << "with invalid raw_chunk_size" << accepted;
+            return false;
+        }
+        this->rawChunkSize = accepted;
+    }
+
+    const auto offeredCompression = std::exchange(this->compressChunks, false);
+    if (result->GetExtension(Data::File::zlib_chunks)) {
+        if (!offeredCompression || this->rawChunkSize == 0) {
+            qDebug() << "Received ChannelResult for" << type() << "with unexpected zlib_chunks";
+            return false;
+        }
+        this->compressChunks = true;
+    }
+
     return true;
 }
 
@@ -225,30 +272,37 @@ bool FileChannel::verifyFileTransferCompleteNotification(Data::File::FileTransfe
 
 void FileChannel::receivePacket(const QByteArray &packet)
 {
-    Data::File::Packet message;
-    if (!message.ParseFromArray(packet.constData(), packet.size())) {
+    // raw chunks are the bulk of the traffic, so check for them before touching protobuf
+    if (this->rawChunkSize > 0 &&
+        (packet.at(0) == RawChunkMarker || (this->compressChunks && packet.at(0) == CompressedRawChunkMarker))) {
+        handleRawFileChunk(packet);
+        return;
+    }
+
+    auto message = MessagePool<Data::File::Packet>::acquire();
+    if (!message->ParseFromArray(packet.constData(), packet.size())) {
         emitFatalError("Failed to parse message on file channel", tego_file_transfer_result_failure, true);
         return;
     }
 
-    if (!verifyPacket(message))
+    if (!verifyPacket(*message))
     {
         emitFatalError("Failed to verify message on file channel", tego_file_transfer_result_failure, true);
         return;
     }
 
-    if (message.has_file_header()) {
-        handleFileHeader(message.file_header());
-    } else if (message.has_file_header_ack()) {
-        handleFileHeaderAck(message.file_header_ack());
-    } else if (message.has_file_chunk()) {
-        handleFileChunk(message.file_chunk());
-    } else if (message.has_file_header_response()) {
-        handleFileHeaderResponse(message.file_header_response());
-    } else if (message.has_file_chunk_ack()) {
-        handleFileChunkAck(message.file_chunk_ack());
-    } else if (message.has_file_transfer_complete_notification()) {
-        handleFileTransferCompleteNotification(message.file_transfer_complete_notification());
+    if (message->has_file_header()) {
+        handleFileHeader(message->file_header());
+    } else if (message->has_file_header_ack()) {
+        handleFileHeaderAck(message->file_header_ack());
+    } else if (message->has_file_chunk()) {
+        handleFileChunk(message->file_chunk());
+    } else if (message->has_file_header_response()) {
+        handleFileHeaderResponse(message->file_header_response());
+    } else if (message->has_file_chunk_ack()) {
+        handleFileChunkAck(message->file_chunk_ack());
+    } else if (message->has_file_transfer_complete_notification()) {
+        handleFileTransferCompleteNotification(message->file_transfer_complete_notification());
     } else {
         emitFatalError("Unrecognized file packet on FileChannel", tego_file_transfer_result_failure, true);
     }
@@ -325,6 +379,20 @@ void FileChannel::emitNonFatalError(std::string&& message, tego_file_transfer_id
     }
 }
 
+void FileChannel::abortTransfer(std::string&& message, tego_file_transfer_id_t id, tego_file_transfer_result_t error)
+{
+    emitNonFatalError(std::move(message), id, error);
+
+    // send message to transfer partner to let them know we've given up
+    auto notification = std::make_unique<Data::File::FileTransferCompleteNotification>();
+    notification->set_file_id(id);
+    notification->set_result(Protocol::Data::File::Cancelled);
+
+    Data::File::Packet packet;
+    packet.set_allocated_file_transfer_complete_notification(notification.release());
+    Channel::sendMessage(packet);
+}
+
 // verify that all the file_id members are the right size
 template<typename S>
 constexpr static bool has_compatible_file_id()
@@ -454,6 +522,45 @@ void FileChannel::handleFileHeaderResponse(const Data::File::FileHeaderResponse
 }
 
 void FileChannel::handleFileChunk(const Data::File::FileChunk &message)
+{
+    // the writer needs its own copy of the data since the message goes away with this call
+    const auto& chunk_data = message.chunk_data();
+    if (chunk_data.size() > FileMaxChunkSize)
+    {
+        emitFatalError("Rejected FileChunk because of invalid chunk_data() size", tego_file_transfer_result_failure, true);
+        return;
+    }
+    const QByteArray buffer(chunk_data.data(), static_cast<int>(chunk_data.size()));
+    handleChunkData(message.file_id(), buffer, 0, buffer.size(), FileMaxChunkSize);
+}
+
+void FileChannel::handleRawFileChunk(const QByteArray &packet)
+{
+    if (packet.size() <= RawChunkHeaderSize)
+    {
+        emitFatalError("Rejected raw file chunk with no data", tego_file_transfer_result_failure, true);
+        return;
+    }
+
+    const auto id = qFromBigEndian<tego_file_transfer_id_t>(packet.constData() + 1);
+    if (packet.at(0) == CompressedRawChunkMarker)
+    {
+        const auto data = PayloadCompression::uncompress(
+            packet.constData() + RawChunkHeaderSize, packet.size() - RawChunkHeaderSize, static_cast<int>(this->rawChunkSize));
+        if (data.isNull())
+        {
+            emitFatalError("Rejected malformed compressed file chunk", tego_file_transfer_result_failure, true);
+            return;
+        }
+        handleChunkData(id, data, 0, data.size(), this->rawChunkSize);
+        return;
+    }
+
+    // the chunk data is used in place, the writer shares the connection's packet buffer
+    handleChunkData(id, packet, RawChunkHeaderSize, packet.size() - RawChunkHeaderSize, this->rawChunkSize);
+}
+
+void FileChannel::handleChunkData(tego_file_transfer_id_t id, const QByteArray &buffer, int offset, int size, size_t maxSize)
 {
     if (direction() != Inbound)
     {
@@ -461,7 +568,7 @@ void FileChannel::handleFileChunk(const Data::File::FileChunk &message)
         return;
     }
 
-    auto it = incomingTransfers.find(message.file_id());
+    auto it = incomingTransfers.find(id);
     if (it == incomingTransfers.end())
     {
         // we can receive an unknown chunk if we cancel in the middle of transmission
@@ -469,98 +576,109 @@ void FileChannel::handleFileChunk(const Data::File::FileChunk &message)
         qWarning() << "rejecting chunk for unknown file";
         return;
     }
-    else if (message.chunk_data().size() > FileMaxChunkSize)
+
+    auto& itr = it->second;
+    if (static_cast<size_t>(size) > maxSize || itr.received + static_cast<tego_file_size_t>(size) > itr.size)
     {
         // something is very wrong in this case
         emitFatalError("Rejected FileChunk because of invalid chunk_data() size", tego_file_transfer_result_failure, true);
         return;
     }
-    else
+    else if (!itr.file)
     {
-        auto& itr = it->second;
-        const auto& chunk_data = message.chunk_data();
-        itr.stream.write(chunk_data.data(), static_cast<std::streamsize>(chunk_data.size()));
+        abortTransfer("Rejected FileChunk for a transfer we have not accepted", id, tego_file_transfer_result_failure);
+        return;
+    }
 
-        // emit progress callback
-        const auto id = message.file_id();
-        const auto streamOffset = static_cast<std::streamoff>(itr.stream.tellg());
-        if (streamOffset == std::streamoff(-1))
-        {
-            // we should send complete message to sender if we have a disk error so they do not spam us with chunks
-            // we can't do anything with; this transfer is not recoverable, but others can continue
-            emitNonFatalError("Error writing chunk to stream", id, tego_file_transfer_result_filesystem_error);
+    itr.received += static_cast<tego_file_size_t>(size);
+    const auto bytesReceived = itr.received;
+    const auto& bytesTotal = itr.size;
+    const auto file = itr.file;
 
-            // send message to transfer partner to let them know we've given up
-            auto notification = std::make_unique<Data::File::FileTransferCompleteNotification>();
-            notification->set_file_id(id);
-            notification->set_result(Protocol::Data::File::Cancelled);
+    // the chunk counts as received once the writer has it buffered; if the writer
+    // is backed up, hold off the ack (and so the sender's next chunk) until it's on disk
+    auto writer = FileChunkWriter::instance();
+    const bool ackNow = writer->canBuffer(size);
+    writer->write(file, buffer, offset, size, this, [=](bool ok)
+    {
+        this->handleChunkWritten(id, file, ok, ackNow ? 0 : bytesReceived);
+    });
 
-            Data::File::Packet packet;
-            packet.set_allocated_file_transfer_complete_notification(notification.release());
-            Channel::sendMessage(packet);
+    if (ackNow)
+    {
+        sendChunkAck(id, bytesReceived);
+    }
 
-            return;
-        }
+    // emit progress callback
+    emit this->fileTransferProgress(id, tego_file_transfer_direction_receiving, bytesReceived, bytesTotal);
 
-        const auto bytesWritten = static_cast<tego_file_size_t>(streamOffset);
-        const auto& bytesTotal = itr.size;
+    if (bytesReceived == bytesTotal)
+    {
+        // hash and move the file into place once all writes are done
+        writer->finish(file, this, [=](tego_file_transfer_result_t result)
+        {
+            this->handleFileWritten(id, file, result);
+        });
+    }
+}
 
-        emit this->fileTransferProgress(id, tego_file_transfer_direction_receiving, bytesWritten, bytesTotal);
+void FileChannel::handleChunkWritten(tego_file_transfer_id_t id, const std::shared_ptr<FileChunkWriter::Target> &file, bool ok, tego_file_size_t ackBytes)
+{
+    // the transfer may have been cancelled (and even replaced) while the write was queued
+    auto it = incomingTransfers.find(id);
+    if (it == incomingTransfers.end() || it->second.file != file)
+    {
+        return;
+    }
 
-        auto response = std::make_unique<Data::File::FileChunkAck>();
-        response->set_file_id(message.file_id());
-        response->set_bytes_received(bytesWritten);
+    if (!ok)
+    {
+        // we should send complete message to sender if we have a disk error so they do not spam us with chunks
+        // we can't do anything with; this transfer is not recoverable, but others can continue
+        abortTransfer("Error writing chunk to stream", id, tego_file_transfer_result_filesystem_error);
+        return;
+    }
 
-        Data::File::Packet ackPacket;
-        ackPacket.set_allocated_file_chunk_ack(response.release());
-        Channel::sendMessage(ackPacket);
+    if (ackBytes > 0)
+    {
+        sendChunkAck(id, ackBytes);
+    }
+}
 
-        if (bytesWritten == bytesTotal)
-        {
-            // reset the read/write stream and calculate the file hash
-            itr.stream.seekg(0);
-            tego_file_hash fileHash(itr.stream);
-            itr.stream.close();
+void FileChannel::handleFileWritten(tego_file_transfer_id_t id, const std::shared_ptr<FileChunkWriter::Target> &file, tego_file_transfer_result_t result)
+{
+    auto it = incomingTransfers.find(id);
+    if (it == incomingTransfers.end() || it->second.file != file)
+    {
+        return;
+    }
 
-            if (fileHash.to_string() != itr.hash)
-            {
-                // delete file if calculated hash doesn't match expected
-                QFile::remove(QString::fromStdString(itr.partial_dest()));
-                emit this->fileTransferFinished(id, tego_file_transfer_direction_receiving, tego_file_transfer_result_bad_hash);
-            }
-            else
-            {
-                // if a file already exists at our final destination, then remove it
-                const auto qDest = QString::fromStdString(itr.dest);
-                if (QFile::exists(qDest))
-                {
-                    QFile::remove(qDest);
-                }
+    if (result == tego_file_transfer_result_success)
+    {
+        logTransferStats(static_cast<qint64>(it->second.size), it->second.beginTime);
+    }
+    incomingTransfers.erase(it);
+    emit this->fileTransferFinished(id, tego_file_transfer_direction_receiving, result);
 
-                // move our partial file to final destination
-                const auto qPartialDest = QString::fromStdString(itr.partial_dest());
-                if(QFile::rename(qPartialDest, qDest))
-                {
-                    emit this->fileTransferFinished(id, tego_file_transfer_direction_receiving, tego_file_transfer_result_success);
-                    logTransferStats(static_cast<qint64>(itr.size), itr.beginTime);
-                }
-                else
-                {
-                    emit this->fileTransferFinished(id, tego_file_transfer_direction_receiving, tego_file_transfer_result_filesystem_error);
-                }
-            }
-            incomingTransfers.erase(it);
+    // send complete notification to remote user
+    auto notification = std::make_unique<Data::File::FileTransferCompleteNotification>();
+    notification->set_file_id(id);
+    notification->set_result(Protocol::Data::File::Success);
 
-            // send complete notification to remote user
-            auto notification = std::make_unique<Data::File::FileTransferCompleteNotification>();
-            notification->set_file_id(id);
-            notification->set_result(Protocol::Data::File::Success);
+    Data::File::Packet notifPacket;
+    notifPacket.set_allocated_file_transfer_complete_notification(notification.release());
+    Channel::sendMessage(notifPacket);
+}
 
-            Data::File::Packet notifPacket;
-            notifPacket.set_allocated_file_transfer_complete_notification(notification.release());
-            Channel::sendMessage(notifPacket);
-        }
-    }
+void FileChannel::sendChunkAck(tego_file_transfer_id_t id, tego_file_size_t bytesReceived)
+{
+    auto response = std::make_unique<Data::File::FileChunkAck>();
+    response->set_file_id(id);
+    response->set_bytes_received(bytesReceived);
+
+    Data::File::Packet ackPacket;
+    ackPacket.set_allocated_file_chunk_ack(response.release());
+    Channel::sendMessage(ackPacket);
 }
 
 void FileChannel::handleFileChunkAck(const Data::File::FileChunkAck &message)
@@ -724,9 +842,51 @@ void FileChannel::acceptFile(tego_file_transfer_id_t id, const std::string& dest
     auto it = incomingTransfers.find(id);
     TEGO_THROW_IF_FALSE(it != incomingTransfers.end());
     auto& itr = it->second;
+    TEGO_THROW_IF_TRUE(itr.file || itr.opening);
 
     itr.beginTime = std::chrono::system_clock::now();
-    itr.open_stream(dest);
+    itr.dest = dest;
+
+    // creating and preallocating the partial file can take a while, so it
+    // happens on the writer's thread and we answer the sender once it's done
+    auto target = std::make_shared<FileChunkWriter::Target>(itr.partial_dest(), itr.dest, itr.hash);
+    itr.opening = target;
+    FileChunkWriter::instance()->open(target, itr.size, this, [this, id, target](bool ok)
+    {
+        this->handleFileOpened(id, target, ok);
+    });
+}
+
+void FileChannel::handleFileOpened(tego_file_transfer_id_t id, const std::shared_ptr<FileChunkWriter::Target> &file, bool ok)
+{
+    // the transfer may have been cancelled (and its partial file discarded)
+    // while the file was being created
+    auto it = incomingTransfers.find(id);
+    if (it == incomingTransfers.end() || it->second.opening != file)
+    {
+        return;
+    }
+    it->second.opening.reset();
+
+    if (!ok)
+    {
+        // fail before the sender has sent us anything, they see the transfer fail rather than be rejected
+        qWarning() << "Failed to create partial file for incoming transfer";
+        incomingTransfers.erase(it);
+
+        auto notification = std::make_unique<Data::File::FileTransferCompleteNotification>();
+        notification->set_file_id(id);
+        notification->set_result(Protocol::Data::File::Failure);
+
+        Data::File::Packet packet;
+        packet.set_allocated_file_transfer_complete_notification(notification.release());
+        Channel::sendMessage(packet);
+
+        emit this->fileTransferFinished(id, tego_file_transfer_direction_receiving, tego_file_transfer_result_filesystem_error);
+        return;
+    }
+
+    it->second.file = file;
 
     auto response = std::make_unique<Data::File::FileHeaderResponse>();
     response->set_response(tego_file_transfer_response_accept);
@@ -815,40 +975,70 @@ void FileChannel::sendNextChunk(tego_file_transfer_id_t id)
         Q_ASSERT(otr.finished() == false);
         Q_ASSERT(otr.offset == static_cast<tego_file_size_t>(otr.stream.tellg()));
 
-        // read the next chunk to our buffer, and update our offset
-        otr.stream.read(this->chunkBuffer, FileMaxChunkSize);
+        // raw chunks are read from disk straight into the outgoing packet after the header,
+        // otherwise fall back to a FileChunk message sized for older peers
+        const auto maxChunkSize = (this->rawChunkSize > 0)
+            ? this->rawChunkSize
+            : std::min<tego_file_size_t>(g_globals.context->get_file_transfer_chunk_size(), FileMaxChunkSize);
+        const auto headerSize = (this->rawChunkSize > 0) ? RawChunkHeaderSize : 0;
+
+        QByteArray packet(headerSize + static_cast<int>(maxChunkSize), Qt::Uninitialized);
+        otr.stream.read(packet.data() + headerSize, static_cast<std::streamsize>(maxChunkSize));
         const auto chunkSize = otr.stream.gcount();
         // ensure we read a valid value
-        static_assert(FileMaxChunkSize != std::numeric_limits<std::streamsize>::max());
-        if (chunkSize == std::numeric_limits<std::streamsize>::max())
+        if (chunkSize <= 0 || chunkSize == std::numeric_limits<std::streamsize>::max())
         {
             // not quite a fatal error, but we need to cleanup this transfer
-            emitNonFatalError("Problem reading the next chunk from disk", id, tego_file_transfer_result_filesystem_error);
-
-            // send message to transfer partner to let them know we've given up
-            auto notification = std::make_unique<Data::File::FileTransferCompleteNotification>();
-            notification->set_file_id(id);
-            notification->set_result(Protocol::Data::File::Cancelled);
-
-            Data::File::Packet packet;
-            packet.set_allocated_file_transfer_complete_notification(notification.release());
-            Channel::sendMessage(packet);
-
+            abortTransfer("Problem reading the next chunk from disk", id, tego_file_transfer_result_filesystem_error);
             return;
         }
-        Q_ASSERT(static_cast<tego_file_size_t>(chunkSize) <= FileMaxChunkSize);
+        Q_ASSERT(static_cast<tego_file_size_t>(chunkSize) <= maxChunkSize);
 
         otr.offset += static_cast<unsigned long>(chunkSize);
 
-        // build our chunk
-        auto chunk = std::make_unique<Data::File::FileChunk>();
-        chunk->set_file_id(id);
-        chunk->set_chunk_data(std::begin(chunkBuffer), static_cast<size_t>(chunkSize));
+        if (this->rawChunkSize > 0)
+        {
+            packet[0] = RawChunkMarker;
+            qToBigEndian(id, packet.data() + 1);
+            packet.resize(RawChunkHeaderSize + static_cast<int>(chunkSize));
 
-        Data::File::Packet packet;
-        packet.set_allocated_file_chunk(chunk.release());
+            if (this->compressChunks && otr.compressionSkip > 0)
+            {
+                otr.compressionSkip--;
+            }
+            else if (this->compressChunks)
+            {
+                auto compressed = PayloadCompression::compress(packet.constData() + RawChunkHeaderSize, static_cast<int>(chunkSize));
+                if (compressed.isNull())
+                {
+                    // likely an already compressed format, try again less often
+                    otr.compressionSkip = otr.compressionBackoff;
+                    otr.compressionBackoff = std::min(otr.compressionBackoff * 2, MaxCompressionBackoff);
+                }
+                else
+                {
+                    otr.compressionBackoff = 1;
+                    compressed.prepend(packet.constData(), RawChunkHeaderSize);
+                    compressed[0] = CompressedRawChunkMarker;
+                    packet = std::move(compressed);
+                }
+            }
 
-        // send the chunk
-        Channel::sendMessage(packet);
+            // send the chunk
+            Channel::sendPacket(packet);
+        }
+        else
+        {
+            // build our chunk
+            auto chunk = std::make_unique<Data::File::FileChunk>();
+            chunk->set_file_id(id);
+            chunk->set_chunk_data(packet.constData(), static_cast<size_t>(chunkSize));
+
+            Data::File::Packet message;
+            message.set_allocated_file_chunk(chunk.release());
+
+            // send the chunk
+            Channel::sendMessage(message);
+        }
     }
 }
@@ -34,6 +34,7 @@
 #define PROTOCOL_FILECHANNEL_H
 
 #include "protocol/Channel.h"
+#include "protocol/FileChunkWriter.h"
 #include "FileChannel.pb.h"
 #include "tego/tego.h"
 #include "file_hash.hpp"
@@ -47,6 +48,8 @@ class FileChannel : public Channel
     Q_DISABLE_COPY(FileChannel)
 
 public:
+    static constexpr TypeId ChannelTypeId = TypeId::File;
+
     explicit FileChannel(Direction direction, Connection *connection);
 
     bool sendFileWithId(QString file_url, const tego_file_hash_t& fileHash, QDateTime time, tego_file_transfer_id_t id);
@@ -64,6 +67,7 @@ signals:
 protected:
     virtual bool allowInboundChannelRequest(const Data::Control::OpenChannel *request, Data::Control::ChannelResult *result);
     virtual bool allowOutboundChannelRequest(Data::Control::OpenChannel *request);
+    virtual bool processChannelOpenResult(const Data::Control::ChannelResult *result);
     virtual void receivePacket(const QByteArray &packet);
 private:
     // when our socket goes away
@@ -91,6 +95,10 @@ private:
         const tego_file_size_t size;
         tego_file_size_t offset;
         std::ifstream stream;
+        // compression skip heuristic: chunks left to send uncompressed, and
+        // how many to skip the next time a chunk doesn't compress
+        int compressionSkip = 0;
+        int compressionBackoff = 1;
 
         inline bool finished() const { return offset == size; }
     };
@@ -113,19 +121,33 @@ private:
         const tego_file_size_t size;
         std::string dest; // destination to save to
         const std::string hash;
+        // bytes handed to the disk writer so far
+        tego_file_size_t received = 0;
 
-        // need to write and read
-        std::fstream stream;
+        // the partial file, written to and finally hashed and renamed by the FileChunkWriter
+        std::shared_ptr<FileChunkWriter::Target> file;
+        // the partial file while the FileChunkWriter is still creating it
+        std::shared_ptr<FileChunkWriter::Target> opening;
 
         std::string partial_dest() const;
-        void open_stream(const std::string& dest);
     };
     // 63 kb, max packet size is UINT16_MAX (ak 65535, 64k - 1) so leave space for other data
+    // this is the limit for protobuf FileChunk messages, which is all older peers understand
     constexpr static tego_file_size_t FileMaxChunkSize = 63*1024; // bytes
-    // intermediate buffer we load chunks from disk into
-    // each access to this buffer happens on the same thread, and only within the scope of a function
-    // so no need to worry about synchronization or sharing between file transfers
-    char chunkBuffer[FileMaxChunkSize];
+    // raw chunk framing: a zero marker byte followed by the big-endian file id
+    constexpr static char RawChunkMarker = 0x00;
+    constexpr static int RawChunkHeaderSize = 1 + sizeof(tego_file_transfer_id_t);
+    // same framing, with the chunk data compressed by PayloadCompression
+    constexpr static char CompressedRawChunkMarker = 0x01;
+    // chunks that don't compress back off the next attempt exponentially up
+    // to this many chunks, so incompressible files cost little cpu
+    constexpr static int MaxCompressionBackoff = 64;
+
+    // size of the raw chunks agreed on when the channel opened, 0 if the peer
+    // only understands protobuf FileChunk messages
+    uint32_t rawChunkSize = 0;
+    // whether raw chunks may be compressed, agreed on when the channel opened
+    bool compressChunks = false;
 
     // file transfers we are sending
     std::map<tego_file_transfer_id_t, outgoing_transfer_record> outgoingTransfers;
@@ -150,6 +172,15 @@ private:
     void handleFileHeaderAck(const Data::File::FileHeaderAck &message);
     void handleFileHeaderResponse(const Data::File::FileHeaderResponse &message);
     void handleFileChunk(const Data::File::FileChunk &message);
+    void handleRawFileChunk(const QByteArray &packet);
+    void handleChunkData(tego_file_transfer_id_t id, const QByteArray &buffer, int offset, int size, size_t maxSize);
+    void handleFileOpened(tego_file_transfer_id_t id, const std::shared_ptr<FileChunkWriter::Target> &file, bool ok);
+    void handleChunkWritten(tego_file_transfer_id_t id, const std::shared_ptr<FileChunkWriter::Target> &file, bool ok, tego_file_size_t ackBytes);
+    void handleFileWritten(tego_file_transfer_id_t id, const std::shared_ptr<FileChunkWriter::Target> &file, tego_file_transfer_result_t result);
+
+    void sendChunkAck(tego_file_transfer_id_t id, tego_file_size_t bytesReceived);
+    // gives up on a single transfer and tells our transfer partner
+    void abortTransfer(std::string&& msg, tego_file_transfer_id_t id, tego_file_transfer_result_t error);
     void handleFileChunkAck(const Data::File::FileChunkAck &message);
     void handleFileTransferCompleteNotification(const Data::File::FileTransferCompleteNotification &message);
 
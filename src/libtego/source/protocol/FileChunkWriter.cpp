@@ -0,0 +1,228 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FileChunkWriter.h"
+#include "file_hash.hpp"
+
+using namespace Protocol;
+
+FileChunkWriter::Target::Target(std::string partial, std::string dest, std::string hash)
+    : partialPath(std::move(partial))
+    , destPath(std::move(dest))
+    , expectedHash(std::move(hash))
+{
+}
+
+FileChunkWriter *FileChunkWriter::instance()
+{
+    static FileChunkWriter *p = 0;
+    if (!p)
+        p = new FileChunkWriter(qApp);
+    return p;
+}
+
+FileChunkWriter::FileChunkWriter(QObject *parent)
+    : QObject(parent)
+    , m_bufferedBytes(0)
+{
+    // a single thread keeps jobs in submission order, and more threads would
+    // only contend for the same disk
+    m_pool.setMaxThreadCount(1);
+    m_pool.setObjectName(QStringLiteral("FileChunkWriter"));
+}
+
+FileChunkWriter::~FileChunkWriter()
+{
+    // let queued writes and discards run so no partial files are left behind
+    m_pool.waitForDone();
+}
+
+void FileChunkWriter::open(std::shared_ptr<Target> target, tego_file_size_t size, QObject *context, std::function<void(bool)> callback)
+{
+    Q_ASSERT(target);
+    QPointer<QObject> guard(context);
+
+    m_pool.start(QRunnable::create([=]() {
+        const bool ok = openTarget(*target, size);
+
+        QMetaObject::invokeMethod(this, [=]() {
+            if (guard)
+                callback(ok);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void FileChunkWriter::write(std::shared_ptr<Target> target, const QByteArray &data, int offset, int size,
+                            QObject *context, std::function<void(bool)> callback)
+{
+    Q_ASSERT(target);
+    Q_ASSERT(offset >= 0 && size >= 0 && offset + size <= data.size());
+
+    m_bufferedBytes += size;
+    QPointer<QObject> guard(context);
+
+    m_pool.start(QRunnable::create([=]() {
+        bool ok = false;
+        if (!target->failed) {
+            target->stream.write(data.constData() + offset, static_cast<std::streamsize>(size));
+            ok = target->stream.good();
+            target->failed = !ok;
+        }
+
+        QMetaObject::invokeMethod(this, [=]() {
+            m_bufferedBytes -= size;
+            if (guard)
+                callback(ok);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void FileChunkWriter::finish(std::shared_ptr<Target> target, QObject *context, std::function<void(tego_file_transfer_result_t)> callback)
+{
+    Q_ASSERT(target);
+    QPointer<QObject> guard(context);
+
+    m_pool.start(QRunnable::create([=]() {
+        const auto result = finishTarget(*target);
+
+        QMetaObject::invokeMethod(this, [=]() {
+            if (guard)
+                callback(result);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+void FileChunkWriter::discard(std::shared_ptr<Target> target)
+{
+    Q_ASSERT(target);
+
+    m_pool.start(QRunnable::create([=]() {
+        if (target->stream.is_open()) {
+            // try our best to remove the partial file
+            target->stream.close();
+            QFile::remove(QString::fromStdString(target->partialPath));
+        }
+    }));
+}
+
+// create the partial file with size bytes reserved on disk up front, so a full
+// disk is found before the transfer starts and sequential writes land in
+// contiguous extents
+static bool preallocateFile(const QString &path, tego_file_size_t size)
+{
+    if (size > static_cast<tego_file_size_t>(std::numeric_limits<qint64>::max()))
+        return false;
+
+    // discard previous contents
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to create partial file:" << file.errorString();
+        return false;
+    }
+
+#ifdef Q_OS_LINUX
+    // unlike posix_fallocate, which glibc emulates by writing every block on
+    // filesystems without support, this fails fast so we can just extend
+    if (::fallocate(file.handle(), 0, 0, static_cast<off_t>(size)) == 0)
+        return true;
+    if (errno != EOPNOTSUPP && errno != EINVAL) {
+        qWarning() << "Failed to preallocate" << size << "bytes for partial file:" << qt_error_string(errno);
+        return false;
+    }
+#endif
+
+    if (!file.resize(static_cast<qint64>(size))) {
+        qWarning() << "Failed to extend partial file to" << size << "bytes:" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool FileChunkWriter::openTarget(Target &target, tego_file_size_t size)
+{
+    const auto qPartial = QString::fromStdString(target.partialPath);
+    if (!preallocateFile(qPartial, size)) {
+        QFile::remove(qPartial);
+        return false;
+    }
+
+    // keep the preallocated contents, chunks overwrite them from the start;
+    // opened for reading too to validate the hash once the transfer completes
+    target.stream.open(target.partialPath, std::ios::in | std::ios::out | std::ios::binary);
+    if (!target.stream.is_open()) {
+        QFile::remove(qPartial);
+        return false;
+    }
+    return true;
+}
+
+tego_file_transfer_result_t FileChunkWriter::finishTarget(Target &target)
+{
+    if (!target.stream.is_open())
+        return tego_file_transfer_result_failure;
+
+    target.stream.flush();
+    if (target.failed || !target.stream.good()) {
+        target.stream.close();
+        QFile::remove(QString::fromStdString(target.partialPath));
+        return tego_file_transfer_result_filesystem_error;
+    }
+
+    try {
+        // reset the read/write stream and calculate the file hash
+        target.stream.seekg(0);
+        tego_file_hash fileHash(target.stream);
+        target.stream.close();
+
+        if (fileHash.to_string() != target.expectedHash) {
+            // delete file if calculated hash doesn't match expected
+            QFile::remove(QString::fromStdString(target.partialPath));
+            return tego_file_transfer_result_bad_hash;
+        }
+    } catch (const std::exception &ex) {
+        qWarning() << "Failed to hash received file:" << ex.what();
+        target.stream.close();
+        QFile::remove(QString::fromStdString(target.partialPath));
+        return tego_file_transfer_result_filesystem_error;
+    }
+
+    // if a file already exists at our final destination, then remove it
+    const auto qDest = QString::fromStdString(target.destPath);
+    if (QFile::exists(qDest))
+        QFile::remove(qDest);
+
+    // move our partial file to final destination
+    if (!QFile::rename(QString::fromStdString(target.partialPath), qDest))
+        return tego_file_transfer_result_filesystem_error;
+
+    return tego_file_transfer_result_success;
+}
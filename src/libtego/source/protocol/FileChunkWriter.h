@@ -0,0 +1,117 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTOCOL_FILECHUNKWRITER_H
+#define PROTOCOL_FILECHUNKWRITER_H
+
+#include "tego/tego.h"
+
+namespace Protocol
+{
+
+/* Writes incoming file transfer data to disk away from the main thread
+ *
+ * Creating and preallocating the partial file, every chunk write, and the
+ * final hash and rename of a completed transfer run on a single worker
+ * thread so a slow disk or network filesystem does not stall packet handling
+ * on the connections. Jobs run in submission order, so the chunks of a
+ * transfer land in the file in the order they arrived.
+ *
+ * The amount of chunk data waiting to be written is bounded: callers check
+ * canBuffer() before queueing a chunk, and if it does not fit within
+ * MaxBufferedBytes hold off acknowledging it to the sender until it has been
+ * written.
+ *
+ * Callbacks are delivered on the thread the writer lives on (the main
+ * thread), and only if the context object passed in still exists. */
+class FileChunkWriter : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(FileChunkWriter)
+
+public:
+    // chunk data queued or being written at once before writes stop counting as buffered
+    static constexpr qint64 MaxBufferedBytes = 8 * 1024 * 1024;
+
+    // a partially received file, owned by the worker thread once handed to the writer
+    struct Target
+    {
+        Target(std::string partialPath, std::string destPath, std::string expectedHash);
+
+        std::fstream stream;
+        const std::string partialPath;
+        const std::string destPath;
+        const std::string expectedHash;
+        // set after the first failed write, later writes are skipped
+        bool failed = false;
+    };
+
+    static FileChunkWriter *instance();
+
+    explicit FileChunkWriter(QObject *parent = nullptr);
+    ~FileChunkWriter();
+
+    // whether size more bytes of chunk data fit within MaxBufferedBytes
+    bool canBuffer(int size) const { return m_bufferedBytes + size <= MaxBufferedBytes; }
+
+    /* Queue creating target's partial file with size bytes reserved on disk
+     * and opening it; callback(ok) reports the outcome, on failure nothing is
+     * left behind on disk */
+    void open(std::shared_ptr<Target> target, tego_file_size_t size, QObject *context, std::function<void(bool)> callback);
+
+    /* Queue size bytes of data starting at offset to be appended to target.
+     * data is implicitly shared, so passing a whole packet is free; callback(ok)
+     * is invoked once it has been written */
+    void write(std::shared_ptr<Target> target, const QByteArray &data, int offset, int size,
+               QObject *context, std::function<void(bool)> callback);
+
+    /* Queue verification of the completed file's hash and its move from the
+     * partial path to the destination; callback(result) reports the outcome */
+    void finish(std::shared_ptr<Target> target, QObject *context, std::function<void(tego_file_transfer_result_t)> callback);
+
+    /* Queue closing target and removing its partial file if the transfer
+     * never finished; pending writes to it complete first */
+    void discard(std::shared_ptr<Target> target);
+
+    qint64 bufferedBytes() const { return m_bufferedBytes; }
+
+private:
+    QThreadPool m_pool;
+    qint64 m_bufferedBytes;
+
+    static bool openTarget(Target &target, tego_file_size_t size);
+    static tego_file_transfer_result_t finishTarget(Target &target);
+};
+
+}
+
+#endif
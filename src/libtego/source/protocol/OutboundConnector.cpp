@@ -32,6 +32,7 @@
 
 #include "OutboundConnector.h"
 #include "utils/Useful.h"
+#include "utils/TimerWheel.h"
 #include "tor/TorSocket.h"
 #include "ControlChannel.h"
 #include "AuthHiddenServiceChannel.h"
@@ -54,7 +55,7 @@ public:
     OutboundConnector::Status status;
     CryptoKey authPrivateKey;
     QString errorMessage;
-    QTimer errorRetryTimer;
+    WheelTimer errorRetryTimer;
     int errorRetryCount;
 
     OutboundConnectorPrivate(OutboundConnector *oc)
@@ -65,7 +66,7 @@ public:
         , status(OutboundConnector::Inactive)
         , errorRetryCount(0)
     {
-        connect(&errorRetryTimer, &QTimer::timeout, this, &OutboundConnectorPrivate::retryAfterError);
+        errorRetryTimer.setCallback([this]() { retryAfterError(); });
     }
 
     void setStatus(OutboundConnector::Status status);
@@ -216,7 +217,6 @@ void OutboundConnectorPrivate::setError(const QString &message)
         return;
     }
 
-    errorRetryTimer.setSingleShot(true);
     errorRetryTimer.start(60 * 1000);
     qDebug() << "Retrying outbound connection attempt in 60 seconds after an error";
 }
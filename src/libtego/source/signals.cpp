@@ -140,15 +140,30 @@ extern "C"
     TEGO_DEFINE_CALLBACK_SETTER(tor_bootstrap_status_changed)
     TEGO_DEFINE_CALLBACK_SETTER(tor_log_received)
     TEGO_DEFINE_CALLBACK_SETTER(host_onion_service_state_changed)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_onion_service_state_changed)
     TEGO_DEFINE_CALLBACK_SETTER(chat_request_received)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_chat_request_received)
     TEGO_DEFINE_CALLBACK_SETTER(chat_request_response_received)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_chat_request_response_received)
     TEGO_DEFINE_CALLBACK_SETTER(message_received)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_message_received)
     TEGO_DEFINE_CALLBACK_SETTER(message_acknowledged)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_message_acknowledged)
     TEGO_DEFINE_CALLBACK_SETTER(file_transfer_request_received)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_file_transfer_request_received)
     TEGO_DEFINE_CALLBACK_SETTER(file_transfer_request_acknowledged)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_file_transfer_request_acknowledged)
     TEGO_DEFINE_CALLBACK_SETTER(file_transfer_request_response_received)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_file_transfer_request_response_received)
     TEGO_DEFINE_CALLBACK_SETTER(file_transfer_progress)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_file_transfer_progress)
     TEGO_DEFINE_CALLBACK_SETTER(file_transfer_complete)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_file_transfer_complete)
     TEGO_DEFINE_CALLBACK_SETTER(user_status_changed)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_user_status_changed)
     TEGO_DEFINE_CALLBACK_SETTER(new_identity_created)
+    TEGO_DEFINE_CALLBACK_SETTER(conversation_export_progress)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_conversation_export_progress)
+    TEGO_DEFINE_CALLBACK_SETTER(conversation_export_complete)
+    TEGO_DEFINE_CALLBACK_SETTER(identity_conversation_export_complete)
 }
@@ -78,6 +78,47 @@ namespace tego
             }\
         private:
 
+        /*
+         * Events about a hosted identity's users have two callbacks: X, which
+         * only hears about the primary identity, and identity_X, which also
+         * gets the identity and hears about all of them. emit_X takes the
+         * identity first and fires both from one queued call, so the
+         * arguments are shared between them and cleaned up once
+         */
+        #define TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(EVENT, ...)\
+        private:\
+            tego_##EVENT##_callback_t EVENT##_ = nullptr;\
+            tego_identity_##EVENT##_callback_t identity_##EVENT##_ = nullptr;\
+        public:\
+            void register_##EVENT(tego_##EVENT##_callback_t cb)\
+            {\
+                EVENT##_ = cb;\
+            }\
+            void register_identity_##EVENT(tego_identity_##EVENT##_callback_t cb)\
+            {\
+                identity_##EVENT##_ = cb;\
+            }\
+            template<typename... ARGS>\
+            void emit_##EVENT(tego_identity_t identity, ARGS&&... args)\
+            {\
+                auto primaryCallback = (identity == TEGO_PRIMARY_IDENTITY) ? EVENT##_ : nullptr;\
+                if (primaryCallback != nullptr || identity_##EVENT##_ != nullptr) {\
+                    push_back(\
+                        [=, context=context_, callback=primaryCallback, identityCallback=identity_##EVENT##_]() mutable -> void\
+                        {\
+                            if (identityCallback != nullptr) {\
+                                identityCallback(context, identity, args...);\
+                            }\
+                            if (callback != nullptr) {\
+                                callback(context, args...);\
+                            }\
+                            cleanup_args(std::forward<ARGS>(args)...);\
+                        }\
+                    );\
+                }\
+            }\
+        private:
+
         TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(tor_error_occurred, tego_tor_error_origin_t, tego_error_t*)
         TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(update_tor_daemon_config_succeeded, tego_bool_t)
         TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(tor_control_status_changed, tego_tor_control_status_t)
@@ -86,17 +127,20 @@ namespace tego
         TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(tor_bootstrap_status_changed, int32_t, tego_tor_bootstrap_tag_t)
         TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(tor_log_received, char*, size_t)
         TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(host_onion_service_state_changed, tego_host_onion_service_state_t)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(chat_request_received, tego_user_id_t*, char*, size_t)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(chat_request_response_received, tego_user_id_t*, tego_bool_t)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(message_received, tego_user_id_t*, tego_time_t, tego_message_id_t, char*, size_t)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(message_acknowledged, tego_user_id_t*, tego_message_id_t, tego_bool_t)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(file_transfer_request_received, tego_user_id_t*, tego_file_transfer_id_t, char*, size_t, uint64_t, tego_file_hash_t*)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(file_transfer_request_acknowledged, tego_user_id_t*, tego_file_transfer_id_t, tego_bool_t)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(file_transfer_request_response_received, tego_user_id_t*, tego_file_transfer_id_t, tego_file_transfer_response_t)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(file_transfer_progress, tego_user_id_t*, tego_file_transfer_id_t, tego_file_transfer_direction_t, uint64_t, uint64_t)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(file_transfer_complete, tego_user_id_t*, tego_file_transfer_id_t, tego_file_transfer_direction_t, tego_file_transfer_result_t)
-        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(user_status_changed, tego_user_id_t*, tego_user_status_t)
+        TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(identity_onion_service_state_changed, tego_identity_t, tego_host_onion_service_state_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(chat_request_received, tego_user_id_t*, char*, size_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(chat_request_response_received, tego_user_id_t*, tego_bool_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(message_received, tego_user_id_t*, tego_time_t, tego_message_id_t, char*, size_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(message_acknowledged, tego_user_id_t*, tego_message_id_t, tego_bool_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(file_transfer_request_received, tego_user_id_t*, tego_file_transfer_id_t, char*, size_t, uint64_t, tego_file_hash_t*)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(file_transfer_request_acknowledged, tego_user_id_t*, tego_file_transfer_id_t, tego_bool_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(file_transfer_request_response_received, tego_user_id_t*, tego_file_transfer_id_t, tego_file_transfer_response_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(file_transfer_progress, tego_user_id_t*, tego_file_transfer_id_t, tego_file_transfer_direction_t, uint64_t, uint64_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(file_transfer_complete, tego_user_id_t*, tego_file_transfer_id_t, tego_file_transfer_direction_t, tego_file_transfer_result_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(user_status_changed, tego_user_id_t*, tego_user_status_t)
         TEGO_IMPLEMENT_CALLBACK_FUNCTIONS(new_identity_created, tego_ed25519_private_key_t*)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(conversation_export_progress, tego_user_id_t*, size_t, size_t)
+        TEGO_IMPLEMENT_IDENTITY_CALLBACK_FUNCTIONS(conversation_export_complete, tego_user_id_t*, tego_bool_t)
 
 
     private:
@@ -38,6 +38,74 @@ extern "C"
         }, error);
     }
 
+    void tego_tor_launch_config_set_external_control_port(
+        tego_tor_launch_config_t* launchConfig,
+        const char* address,
+        size_t addressLength,
+        uint16_t port,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(launchConfig);
+            TEGO_THROW_IF_NULL(address);
+            TEGO_THROW_IF_FALSE(port != 0);
+
+            std::string controlAddress(address, addressLength);
+            TEGO_THROW_IF_FALSE_MSG(!QHostAddress(QString::fromStdString(controlAddress)).isNull(), "control address must be an IP address: '{}'", controlAddress);
+
+            launchConfig->controlAddress = std::move(controlAddress);
+            launchConfig->controlPort = port;
+            launchConfig->controlSocketPath.clear();
+        }, error);
+    }
+
+    void tego_tor_launch_config_set_external_control_socket(
+        tego_tor_launch_config_t* launchConfig,
+        const char* socketPath,
+        size_t socketPathLength,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(launchConfig);
+            TEGO_THROW_IF_NULL(socketPath);
+            TEGO_THROW_IF_FALSE(socketPathLength > 0);
+
+            launchConfig->controlSocketPath.assign(socketPath, socketPathLength);
+            launchConfig->controlAddress.clear();
+            launchConfig->controlPort = 0;
+        }, error);
+    }
+
+    void tego_tor_launch_config_set_external_control_password(
+        tego_tor_launch_config_t* launchConfig,
+        const char* password,
+        size_t passwordLength,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(launchConfig);
+            TEGO_THROW_IF_FALSE(password != nullptr || passwordLength == 0);
+
+            launchConfig->controlPassword.assign(password == nullptr ? "" : password, passwordLength);
+        }, error);
+    }
+
+    void tego_tor_launch_config_set_unix_sockets(
+        tego_tor_launch_config_t* launchConfig,
+        tego_bool_t enabled,
+        tego_error_t** error)
+    {
+        return tego::translateExceptions([=]() -> void
+        {
+            TEGO_THROW_IF_NULL(launchConfig);
+
+            launchConfig->unixSockets = (enabled == TEGO_TRUE);
+        }, error);
+    }
+
     //
     // Tor Daemon Configuration
     //
@@ -7,6 +7,16 @@
 struct tego_tor_launch_config
 {
     std::string dataDirectory;
+
+    // shared tor mode, attach to an existing daemon's control port (or
+    // unix socket) rather than launching our own
+    std::string controlAddress;
+    uint16_t controlPort = 0;
+    std::string controlSocketPath;
+    std::string controlPassword;
+
+    // talk to tor over unix domain sockets (SOCKS and onion service targets)
+    bool unixSockets = false;
 };
 
 typedef enum
@@ -39,6 +39,7 @@ using namespace Tor;
 
 AddOnionCommand::AddOnionCommand(HiddenService *service)
     : m_service(service)
+    , m_detach(false)
 {
     Q_ASSERT(m_service);
 }
@@ -59,10 +60,18 @@ QByteArray AddOnionCommand::build()
         out += " NEW:ED25519-V3";
     }
 
+    if (m_detach)
+        out += " Flags=Detach";
+
     foreach (const HiddenService::Target &target, m_service->targets()) {
         out += " Port=";
         out += QByteArray::number(target.servicePort);
         out += ",";
+        if (!target.targetSocketPath.isEmpty()) {
+            out += "unix:";
+            out += QFile::encodeName(target.targetSocketPath);
+            continue;
+        }
         out += target.targetAddress.toString().toLatin1();
         out += ":";
         out += QByteArray::number(target.targetPort);
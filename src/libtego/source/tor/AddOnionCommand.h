@@ -47,6 +47,10 @@ class AddOnionCommand : public TorControlCommand
 public:
     AddOnionCommand(HiddenService *service);
 
+    /* Detached services outlive the control connection that added them */
+    void setDetach(bool detach) { m_detach = detach; }
+    bool isDetached() const { return m_detach; }
+
     QByteArray build();
 
     QString errorMessage() const { return m_errorMessage; }
@@ -59,6 +63,7 @@ signals:
 protected:
     HiddenService *m_service;
     QString m_errorMessage;
+    bool m_detach;
 
     virtual void onReply(int statusCode, const QByteArray &data);
     virtual void onFinished(int statusCode);
@@ -47,15 +47,9 @@ QByteArray GetConfCommand::build(const QByteArray &key)
 
 QByteArray GetConfCommand::build(const QList<QByteArray> &keys)
 {
-    QByteArray out;
-    if (type == GetConf) {
-        out = "GETCONF";
-    } else if (type == GetInfo) {
-        out = "GETINFO";
-    } else {
-        Q_ASSERT(false);
+    QByteArray out = verb();
+    if (out.isEmpty())
         return out;
-    }
 
     foreach (const QByteArray &key, keys) {
         out.append(' ');
@@ -66,6 +60,26 @@ QByteArray GetConfCommand::build(const QList<QByteArray> &keys)
     return out;
 }
 
+QByteArray GetConfCommand::verb() const
+{
+    if (type == GetConf) {
+        return QByteArray("GETCONF");
+    } else if (type == GetInfo) {
+        return QByteArray("GETINFO");
+    }
+
+    Q_ASSERT(false);
+    return QByteArray();
+}
+
+QList<QPair<QByteArray, QByteArray> > GetConfCommand::arguments(const QList<QByteArray> &keys) const
+{
+    QList<QPair<QByteArray, QByteArray> > out;
+    foreach (const QByteArray &key, keys)
+        out.append(qMakePair(key, key));
+    return out;
+}
+
 void GetConfCommand::onReply(int statusCode, const QByteArray &data)
 {
     TorControlCommand::onReply(statusCode, data);
@@ -104,10 +118,10 @@ void GetConfCommand::onDataLine(const QByteArray &data)
         QVariantList results = it->toList();
         if (results.isEmpty() && !it->toByteArray().isEmpty())
             results.append(*it);
-        results.append(data);
+        results.append(QByteArray(data.constData(), data.size()));
         *it = QVariant(results);
     } else {
-        m_results.insert(m_lastKey, QVariantList() << data);
+        m_results.insert(m_lastKey, QVariantList() << QByteArray(data.constData(), data.size()));
     }
 }
 
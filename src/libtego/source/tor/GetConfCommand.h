@@ -54,6 +54,10 @@ public:
     QByteArray build(const QByteArray &key);
     QByteArray build(const QList<QByteArray> &keys);
 
+    // Pieces of the command for TorControlSocket::sendBatchedCommand
+    QByteArray verb() const;
+    QList<QPair<QByteArray, QByteArray> > arguments(const QList<QByteArray> &keys) const;
+
     const QVariantMap &results() const { return m_results; }
     QVariant get(const QByteArray &key) const;
 
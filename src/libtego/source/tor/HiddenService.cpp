@@ -59,7 +59,13 @@ void HiddenService::addTarget(const Target &target)
 
 void HiddenService::addTarget(quint16 servicePort, QHostAddress targetAddress, quint16 targetPort)
 {
-    Target t = { targetAddress, servicePort, targetPort };
+    Target t = { targetAddress, servicePort, targetPort, QString() };
+    m_targets.append(t);
+}
+
+void HiddenService::addTarget(quint16 servicePort, const QString &targetSocketPath)
+{
+    Target t = { QHostAddress(), servicePort, 0, targetSocketPath };
     m_targets.append(t);
 }
 
@@ -87,7 +93,7 @@ void HiddenService::serviceAdded()
         return;
     }
 
-    g_globals.context->set_host_onion_service_state(tego_host_onion_service_state_service_added);
+    g_globals.context->set_host_onion_service_state(this, tego_host_onion_service_state_service_added);
 
     qDebug() << "Hidden service added successfully";
 }
@@ -52,6 +52,8 @@ public:
     {
         QHostAddress targetAddress;
         quint16 servicePort, targetPort;
+        // unix domain socket target, used instead of address and port if set
+        QString targetSocketPath;
     };
 
     HiddenService(QObject *parent = 0);
@@ -66,6 +68,7 @@ public:
     const QList<Target> &targets() const { return m_targets; }
     void addTarget(const Target &target);
     void addTarget(quint16 servicePort, QHostAddress targetAddress, quint16 targetPort);
+    void addTarget(quint16 servicePort, const QString &targetSocketPath);
 
 signals:
     void privateKeyChanged();
@@ -0,0 +1,80 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROTOCOLINFOCOMMAND_H
+#define PROTOCOLINFOCOMMAND_H
+
+#include "TorControlCommand.h"
+
+namespace Tor
+{
+
+/* PROTOCOLINFO, used to pick an authentication method when attaching to a
+ * tor instance we did not launch ourselves */
+class ProtocolInfoCommand : public TorControlCommand
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ProtocolInfoCommand)
+
+public:
+    enum AuthMethod
+    {
+        NoAuth = 0x1,
+        HashedPassword = 0x2,
+        Cookie = 0x4,
+        SafeCookie = 0x8
+    };
+    Q_DECLARE_FLAGS(AuthMethods, AuthMethod)
+
+    ProtocolInfoCommand();
+
+    QByteArray build();
+
+    bool isSuccessful() const { return statusCode() == 250; }
+    AuthMethods authMethods() const { return m_authMethods; }
+    QString cookieFile() const { return m_cookieFile; }
+    QString torVersion() const { return m_torVersion; }
+
+protected:
+    virtual void onReply(int statusCode, const QByteArray &data);
+
+private:
+    AuthMethods m_authMethods;
+    QString m_cookieFile;
+    QString m_torVersion;
+};
+
+}
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(Tor::ProtocolInfoCommand::AuthMethods)
+
+#endif // PROTOCOLINFOCOMMAND_H
@@ -79,7 +79,7 @@ QByteArray SetConfCommand::build(const QVariantMap &data)
 
 QByteArray SetConfCommand::build(const QList<QPair<QByteArray, QByteArray> > &data)
 {
-    QByteArray out(m_resetMode ? "RESETCONF" : "SETCONF");
+    QByteArray out(verb());
 
     for (int i = 0; i < data.size(); i++) {
         out += " " + data[i].first;
@@ -91,6 +91,40 @@ QByteArray SetConfCommand::build(const QList<QPair<QByteArray, QByteArray> > &da
     return out;
 }
 
+QByteArray SetConfCommand::verb() const
+{
+    return QByteArray(m_resetMode ? "RESETCONF" : "SETCONF");
+}
+
+QList<QPair<QByteArray, QByteArray> > SetConfCommand::arguments(const QVariantMap &data) const
+{
+    // One argument per key, multi-valued settings repeat the key within it
+    QList<QPair<QByteArray, QByteArray> > out;
+
+    for (QVariantMap::ConstIterator it = data.begin(); it != data.end(); it++) {
+        const QByteArray key = it.key().toLatin1();
+
+        QVariantList values;
+        if (static_cast<QMetaType::Type>(it.value().type()) == QMetaType::QVariantList)
+            values = it.value().value<QVariantList>();
+        else
+            values.append(it.value());
+
+        QByteArray token;
+        foreach (const QVariant &value, values) {
+            if (!token.isEmpty())
+                token += ' ';
+            token += key;
+            const QByteArray valueString = value.toString().toLatin1();
+            if (!valueString.isEmpty())
+                token += "=" + quotedString(valueString);
+        }
+        out.append(qMakePair(key, token));
+    }
+
+    return out;
+}
+
 void SetConfCommand::onReply(int statusCode, const QByteArray &data)
 {
     TorControlCommand::onReply(statusCode, data);
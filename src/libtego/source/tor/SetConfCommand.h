@@ -51,6 +51,10 @@ public:
     QByteArray build(const QVariantMap &data);
     QByteArray build(const QList<QPair<QByteArray, QByteArray> > &data);
 
+    // Pieces of the command for TorControlSocket::sendBatchedCommand
+    QByteArray verb() const;
+    QList<QPair<QByteArray, QByteArray> > arguments(const QVariantMap &data) const;
+
     QString errorMessage() const { return m_errorMessage; }
     bool isSuccessful() const;
 
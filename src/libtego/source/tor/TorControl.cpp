@@ -38,7 +38,9 @@
 #include "SetConfCommand.h"
 #include "GetConfCommand.h"
 #include "AddOnionCommand.h"
+#include "ProtocolInfoCommand.h"
 #include "utils/StringUtil.h"
+#include "utils/TimerWheel.h"
 
 #include "error.hpp"
 #include "globals.hpp"
@@ -60,29 +62,41 @@ public:
 
     TorControlSocket *socket;
     QHostAddress torAddress;
+    QString controlSocketPath;
     QString errorMessage;
     QString torVersion;
     QByteArray authPassword;
     QHostAddress socksAddress;
-    HiddenService* service = nullptr;
+    QString socksSocketPath;
+    bool preferUnixSockets;
+    // every identity's service, published over this control connection
+    QList<HiddenService*> services;
+    // service ids published with Flags=Detach, removed again when their
+    // identity goes away since tor would otherwise keep them
+    QHash<HiddenService*, QByteArray> detachedServices;
     quint16 controlPort, socksPort;
     TorControl::Status status;
     TorControl::TorStatus torStatus;
     QVariantMap bootstrapStatus;
     bool hasOwnership;
+    // retries the control connection after an error
+    WheelTimer reconnectTimer;
 
     TorControlPrivate(TorControl *parent);
 
     void setStatus(TorControl::Status status);
     void setTorStatus(TorControl::TorStatus status);
 
-    void publishService();
+    void publishService(HiddenService *service, bool replacingStale = false);
+    void connectToSocket();
+    void authenticate(const QByteArray &credential);
 
 public slots:
     void socketConnected();
     void socketDisconnected();
     void socketError();
 
+    void protocolInfoReply();
     void authenticateReply();
     void getTorInfoReply();
     void setError(const QString &message);
@@ -102,13 +116,15 @@ TorControl::TorControl(QObject *parent)
 TorControlPrivate::TorControlPrivate(TorControl *parent)
     : QObject(parent), q(parent), controlPort(0), socksPort(0),
       status(TorControl::NotConnected), torStatus(TorControl::TorUnknown),
-      hasOwnership(false)
+      hasOwnership(false), preferUnixSockets(false)
 {
     socket = new TorControlSocket(this);
     QObject::connect(socket, SIGNAL(connected()), this, SLOT(socketConnected()));
     QObject::connect(socket, SIGNAL(disconnected()), this, SLOT(socketDisconnected()));
     QObject::connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(socketError()));
     QObject::connect(socket, SIGNAL(error(QString)), this, SLOT(setError(QString)));
+
+    reconnectTimer.setCallback([this]() { q->reconnect(); });
 }
 
 QNetworkProxy TorControl::connectionProxy()
@@ -132,9 +148,19 @@ void TorControlPrivate::setStatus(TorControl::Status n)
     g_globals.context->callback_registry_.emit_tor_control_status_changed(
         static_cast<tego_tor_control_status_t>(status));
 
-    if (status == TorControl::Connected && old < TorControl::Connected)
+    if (status == TorControl::Connected && old < TorControl::Connected) {
+        g_globals.context->record_startup_milestone(tego_startup_milestone_tor_control_connected);
+
+        // services do not survive a new connection to a tor we own, and
+        // detached ones on a shared tor may have gone with a restart; those
+        // added from connected() handlers are published by addHiddenService
+        const QList<HiddenService*> previous = services;
         emit q->connected();
-    else if (status < TorControl::Connected && old >= TorControl::Connected)
+        foreach (HiddenService *service, previous) {
+            if (services.contains(service))
+                publishService(service);
+        }
+    } else if (status < TorControl::Connected && old >= TorControl::Connected)
         emit q->disconnected();
 }
 
@@ -165,7 +191,7 @@ void TorControlPrivate::setTorStatus(TorControl::TorStatus n)
 
     if (torStatus == TorControl::TorReady)
     {
-        if (socksAddress.isNull())
+        if (socksAddress.isNull() && socksSocketPath.isEmpty())
         {
             // get info
             GetConfCommand *getConfCommand = new GetConfCommand(GetConfCommand::GetInfo);
@@ -174,7 +200,7 @@ void TorControlPrivate::setTorStatus(TorControl::TorStatus n)
             QList<QByteArray> keys;
             keys << QByteArray("net/listeners/socks");
 
-            socket->sendCommand(getConfCommand, getConfCommand->build(keys));
+            socket->sendBatchedCommand(getConfCommand, getConfCommand->verb(), getConfCommand->arguments(keys));
         }
     }
 }
@@ -194,7 +220,7 @@ void TorControlPrivate::setError(const QString &message)
 
     socket->abort();
 
-    QTimer::singleShot(15000, q, SLOT(reconnect()));
+    reconnectTimer.start(15000);
 }
 
 TorControl::Status TorControl::status() const
@@ -219,7 +245,20 @@ QString TorControl::errorMessage() const
 
 bool TorControl::hasConnectivity() const
 {
-    return torStatus() == TorReady && !d->socksAddress.isNull();
+    return torStatus() == TorReady && (!d->socksAddress.isNull() || !d->socksSocketPath.isEmpty());
+}
+
+QString TorControl::socksSocketPath() const
+{
+    // a tor with only a unix listener is used through it regardless
+    if (d->preferUnixSockets || d->socksAddress.isNull())
+        return d->socksSocketPath;
+    return QString();
+}
+
+void TorControl::setPreferUnixSockets(bool prefer)
+{
+    d->preferUnixSockets = prefer;
 }
 
 QHostAddress TorControl::socksAddress() const
@@ -232,9 +271,9 @@ quint16 TorControl::socksPort() const
     return d->socksPort;
 }
 
-HiddenService const* TorControl::getHiddenService() const
+const QList<HiddenService*> &TorControl::hiddenServices() const
 {
-    return d->service;
+    return d->services;
 }
 
 QVariantMap TorControl::bootstrapStatus() const
@@ -263,12 +302,52 @@ void TorControl::connect(const QHostAddress &address, quint16 port)
     d->socket->abort();
     d->socket->blockSignals(b);
 
+    d->controlSocketPath.clear();
+
     d->setStatus(Connecting);
     d->socket->connectToHost(address, port);
 }
 
+void TorControl::connect(const QString &socketPath)
+{
+    if (status() > Connecting)
+    {
+        qDebug() << "Ignoring TorControl::connect due to existing connection";
+        return;
+    }
+
+    d->torAddress.clear();
+    d->controlPort = 0;
+    d->controlSocketPath = socketPath;
+    d->setTorStatus(TorUnknown);
+
+    bool b = d->socket->blockSignals(true);
+    d->socket->abort();
+    d->socket->blockSignals(b);
+
+    d->connectToSocket();
+}
+
+void TorControlPrivate::connectToSocket()
+{
+    setStatus(TorControl::Connecting);
+    if (!socket->connectToPath(controlSocketPath)) {
+        setError(QStringLiteral("Connection failed: %1").arg(socket->errorString()));
+        return;
+    }
+
+    // local sockets connect synchronously and never emit connected()
+    socketConnected();
+}
+
 void TorControl::reconnect()
 {
+    if (!d->controlSocketPath.isEmpty()) {
+        if (status() < Connecting)
+            d->connectToSocket();
+        return;
+    }
+
     Q_ASSERT(!d->torAddress.isNull() && d->controlPort);
     if (d->torAddress.isNull() || !d->controlPort || status() >= Connecting)
         return;
@@ -277,6 +356,49 @@ void TorControl::reconnect()
     d->socket->connectToHost(d->torAddress, d->controlPort);
 }
 
+void TorControlPrivate::protocolInfoReply()
+{
+    ProtocolInfoCommand *command = qobject_cast<ProtocolInfoCommand*>(sender());
+    Q_ASSERT(command);
+    Q_ASSERT(status == TorControl::Authenticating);
+    if (!command)
+        return;
+
+    if (!command->isSuccessful()) {
+        setError(QStringLiteral("Tor did not describe its authentication methods (error %1)").arg(command->statusCode()));
+        return;
+    }
+
+    const auto methods = command->authMethods();
+    if (methods & ProtocolInfoCommand::NoAuth) {
+        authenticate(QByteArray());
+    } else if ((methods & ProtocolInfoCommand::Cookie) && !command->cookieFile().isEmpty()) {
+        // tor's cookie is 32 random bytes, readable by whoever may control it
+        QFile cookieFile(command->cookieFile());
+        if (!cookieFile.open(QIODevice::ReadOnly)) {
+            setError(QStringLiteral("Cannot read tor's authentication cookie: %1").arg(cookieFile.errorString()));
+            return;
+        }
+        QByteArray cookie = cookieFile.read(33);
+        if (cookie.size() != 32) {
+            setError(QStringLiteral("Unexpected authentication cookie in %1").arg(command->cookieFile()));
+            return;
+        }
+        authenticate(cookie);
+    } else if (methods & ProtocolInfoCommand::HashedPassword) {
+        setError(QStringLiteral("Tor requires a control port password"));
+    } else {
+        setError(QStringLiteral("Tor offers no supported authentication method"));
+    }
+}
+
+void TorControlPrivate::authenticate(const QByteArray &credential)
+{
+    AuthenticateCommand *authenticate = new AuthenticateCommand;
+    connect(authenticate, &TorControlCommand::finished, this, &TorControlPrivate::authenticateReply);
+    socket->sendCommand(authenticate, authenticate->build(credential));
+}
+
 void TorControlPrivate::authenticateReply()
 {
     // verify authentication succeeded
@@ -312,7 +434,7 @@ void TorControlPrivate::authenticateReply()
     keys << QByteArray("status/bootstrap-phase");
     keys << QByteArray("version");
 
-    socket->sendCommand(getConfCommand, getConfCommand->build(keys));
+    socket->sendBatchedCommand(getConfCommand, getConfCommand->verb(), getConfCommand->arguments(keys));
 }
 
 void TorControlPrivate::socketConnected()
@@ -322,9 +444,16 @@ void TorControlPrivate::socketConnected()
     qDebug() << "torctrl: Connected socket; querying information";
     setStatus(TorControl::Authenticating);
 
-    AuthenticateCommand *authenticate = new AuthenticateCommand;
-    connect(authenticate, &TorControlCommand::finished, this, &TorControlPrivate::authenticateReply);
-    socket->sendCommand(authenticate, authenticate->build(authPassword));
+    if (authPassword.isNull()) {
+        // an externally managed tor we have no password for; ask which
+        // methods it accepts (cookie or none)
+        ProtocolInfoCommand *protocolInfo = new ProtocolInfoCommand;
+        connect(protocolInfo, &TorControlCommand::finished, this, &TorControlPrivate::protocolInfoReply);
+        socket->sendCommand(protocolInfo, protocolInfo->build());
+        return;
+    }
+
+    authenticate(authPassword);
 }
 
 void TorControlPrivate::socketDisconnected()
@@ -332,6 +461,7 @@ void TorControlPrivate::socketDisconnected()
     /* Clear some internal state */
     torVersion.clear();
     socksAddress.clear();
+    socksSocketPath.clear();
     socksPort = 0;
     setTorStatus(TorControl::TorUnknown);
 
@@ -354,6 +484,11 @@ void TorControlPrivate::getTorInfoReply()
         QList<QByteArray> listenAddresses = splitQuotedStrings(val.toString().toLatin1(), ' ');
         for (QList<QByteArray>::Iterator it = listenAddresses.begin(); it != listenAddresses.end(); ++it) {
             QByteArray value = unquotedString(*it);
+            if (value.startsWith("unix:")) {
+                if (socksSocketPath.isEmpty())
+                    socksSocketPath = QFile::decodeName(unquotedString(value.mid(5)));
+                continue;
+            }
             int sepp = value.indexOf(':');
             QHostAddress address(QString::fromLatin1(value.mid(0, sepp)));
             quint16 port = static_cast<quint16>(value.mid(sepp+1).toUInt());
@@ -372,10 +507,12 @@ void TorControlPrivate::getTorInfoReply()
         /* It is not immediately an error to have no SOCKS address; when DisableNetwork is set there won't be a
          * listener yet. To handle that situation, we'll try to read the socks address again when TorReady state
          * is reached. */
-        if (!socksAddress.isNull()) {
+        if (!socksAddress.isNull())
             qDebug().nospace() << "torctrl: SOCKS address is " << socksAddress.toString() << ":" << socksPort;
+        if (!socksSocketPath.isEmpty())
+            qDebug() << "torctrl: SOCKS socket is" << socksSocketPath;
+        if (!socksAddress.isNull() || !socksSocketPath.isEmpty())
             emit q->connectivityChanged();
-        }
     }
 
     if (auto val = command->get(QByteArray("status/circuit-established")); val.isValid()) {
@@ -407,28 +544,81 @@ void TorControlPrivate::getTorInfoReply()
     setStatus(TorControl::Connected);
 }
 
-void TorControl::setHiddenService(HiddenService *service)
+void TorControl::addHiddenService(HiddenService *service)
 {
-    Q_ASSERT(d->service == nullptr);
-    d->service = service;
-}
+    Q_ASSERT(service != nullptr);
+    Q_ASSERT(!d->services.contains(service));
+    d->services.append(service);
 
-void TorControl::publishHiddenService()
-{
-    d->publishService();
+    // forget services whose identity has gone away
+    QObject::connect(service, &QObject::destroyed, this, [this,service]() {
+        d->services.removeOne(service);
+
+        // a detached service would stay published on the shared tor
+        QByteArray serviceId = d->detachedServices.take(service);
+        if (!serviceId.isEmpty() && isConnected()) {
+            d->socket->sendCommand("DEL_ONION " + serviceId + "\r\n");
+            d->socket->flush();
+        }
+    });
+
+    // otherwise published once the control connection is up
+    if (isConnected())
+        d->publishService(service);
 }
 
-void TorControlPrivate::publishService()
+void TorControlPrivate::publishService(HiddenService *service, bool replacingStale)
 {
     Q_ASSERT(q->isConnected());
-    Q_ASSERT(this->service != nullptr);
+    Q_ASSERT(service != nullptr);
 
     if (service->hostname().isEmpty())
         qDebug() << "torctrl: Creating a new hidden service";
     else
         qDebug() << "torctrl: Publishing hidden service" << service->hostname();
     AddOnionCommand *onionCommand = new AddOnionCommand(service);
+    // a tor we own exits along with us; on a shared tor the service must not
+    // vanish whenever our control connection drops, so detach it
+    onionCommand->setDetach(!hasOwnership);
     QObject::connect(onionCommand, &AddOnionCommand::succeeded, service, &HiddenService::serviceAdded);
+
+    if (onionCommand->isDetached()) {
+        QPointer<HiddenService> guard(service);
+        QObject::connect(onionCommand, &AddOnionCommand::succeeded, this, [this,guard]() {
+            if (guard)
+                detachedServices.insert(guard, guard->serviceId().toLatin1());
+        });
+        QObject::connect(onionCommand, &AddOnionCommand::failed, this, [this,guard,onionCommand,replacingStale](int code) {
+            if (code != 550 || replacingStale || !guard || !services.contains(guard) || guard->hostname().isEmpty())
+                return;
+            if (!onionCommand->errorMessage().contains(QLatin1String("collision"), Qt::CaseInsensitive))
+                return;
+
+            // only a copy we detached over an earlier control connection is
+            // known to target a stale listener of ours; on a shared tor any
+            // other may be the live service of another instance with the same
+            // key, so it is left alone
+            const QByteArray serviceId = guard->serviceId().toLatin1();
+            if (detachedServices.value(guard) != serviceId) {
+                const QString message = QStringLiteral("Hidden service %1 is already published on this tor, possibly by another instance using the same identity")
+                    .arg(guard->hostname());
+                qWarning() << "torctrl:" << message;
+
+                auto tegoError = std::make_unique<tego_error>();
+                tegoError->message = message.toStdString();
+                g_globals.context->callback_registry_.emit_tor_error_occurred(
+                    tego_tor_error_origin_control,
+                    tegoError.release());
+                return;
+            }
+
+            // replace it with ours, once
+            qDebug() << "torctrl: Replacing stale detached service" << guard->hostname();
+            socket->sendCommand("DEL_ONION " + serviceId + "\r\n");
+            publishService(guard, true);
+        });
+    }
+
     socket->sendCommand(onionCommand, onionCommand->build());
 }
 
@@ -465,7 +655,7 @@ void TorControlPrivate::statusEvent(int code, const QByteArray &data)
     if (tokens.size() < 3)
         return;
 
-    qDebug() << "torctrl: status event:" << data.trimmed();
+    qCDebug(torctrlTrace) << "torctrl: status event:" << data.trimmed();
 
     if (tokens[2] == "CIRCUIT_ESTABLISHED") {
         setTorStatus(TorControl::TorReady);
@@ -485,24 +675,26 @@ void TorControlPrivate::hsDescEvent(int code, const QByteArray &data)
     if (tokens.size() < 3)
         return;
 
-    if (service != nullptr) {
-        qDebug() << "hostname:" << service->serviceId();
-    }
-
-    if (service != nullptr &&
-        tokens[1] == "UPLOADED" && tokens[2] == service->serviceId()) {
-        qDebug() << "SERVICE PUBLISHED";
-        g_globals.context->set_host_onion_service_state(tego_host_onion_service_state_service_published);
+    if (tokens[1] == "UPLOADED") {
+        for (HiddenService *service : qAsConst(services)) {
+            if (tokens[2] == service->serviceId()) {
+                qDebug() << "SERVICE PUBLISHED" << service->serviceId();
+                g_globals.context->set_host_onion_service_state(service, tego_host_onion_service_state_service_published);
+                break;
+            }
+        }
     }
 
-    qDebug() << "torctrl: hs_desc event:" << data.trimmed();
+    qCDebug(torctrlTrace) << "torctrl: hs_desc event:" << data.trimmed();
 }
 
 void TorControlPrivate::updateBootstrap(const QList<QByteArray> &data)
 {
     bootstrapStatus.clear();
-    // WARN or NOTICE
-    bootstrapStatus[QStringLiteral("severity")] = data.value(0);
+    // WARN or NOTICE; the tokens may be views of the socket's read buffer, so
+    // keep a copy rather than the token itself
+    const QByteArray severity = data.value(0);
+    bootstrapStatus[QStringLiteral("severity")] = QByteArray(severity.constData(), severity.size());
     for (int i = 1; i < data.size(); i++) {
         int equals = data[i].indexOf('=');
         QString key = QString::fromLatin1(data[i].mid(0, equals));
@@ -516,6 +708,8 @@ void TorControlPrivate::updateBootstrap(const QList<QByteArray> &data)
 	// a bit roundabout but better than duplicating the tag parsing logic
     auto progress = g_globals.context->get_tor_bootstrap_progress();
     auto tag = g_globals.context->get_tor_bootstrap_tag();
+    if (progress == 100)
+        g_globals.context->record_startup_milestone(tego_startup_milestone_tor_bootstrapped);
 
     g_globals.context->callback_registry_.emit_tor_bootstrap_status_changed(
         progress,
@@ -527,7 +721,7 @@ void TorControlPrivate::updateBootstrap(const QList<QByteArray> &data)
 QObject *TorControl::getConfiguration(const QString &options)
 {
     GetConfCommand *command = new GetConfCommand(GetConfCommand::GetConf);
-    d->socket->sendCommand(command, command->build(options.toLatin1()));
+    d->socket->sendBatchedCommand(command, command->verb(), command->arguments(options.toLatin1().split(' ')));
 
     QQmlEngine::setObjectOwnership(command, QQmlEngine::CppOwnership);
     return command;
@@ -537,7 +731,7 @@ QObject *TorControl::setConfiguration(const QVariantMap &options)
 {
     SetConfCommand *command = new SetConfCommand;
     command->setResetMode(true);
-    d->socket->sendCommand(command, command->build(options));
+    d->socket->sendBatchedCommand(command, command->verb(), command->arguments(options));
 
     QQmlEngine::setObjectOwnership(command, QQmlEngine::CppOwnership);
     return command;
@@ -78,6 +78,10 @@ public:
     QHostAddress socksAddress() const;
     quint16 socksPort() const;
     QNetworkProxy connectionProxy();
+    /* Tor's unix domain SOCKS listener to use instead of connectionProxy(),
+     * or an empty string */
+    QString socksSocketPath() const;
+    void setPreferUnixSockets(bool prefer);
 
     /* Authentication */
     void setAuthPassword(const QByteArray &password);
@@ -85,6 +89,8 @@ public:
     /* Connection */
     bool isConnected() const { return status() == Connected; }
     void connect(const QHostAddress &address, quint16 port);
+    /* Connect to a control port exposed as a unix domain socket */
+    void connect(const QString &socketPath);
 
     /* Ownership means that tor is managed by this socket, and we
      * can shut it down, own its configuration, etc. */
@@ -92,9 +98,9 @@ public:
     void takeOwnership();
 
     /* Hidden Services */
-    HiddenService const* getHiddenService() const;
-    void setHiddenService(HiddenService* service);
-    void publishHiddenService();
+    const QList<HiddenService*> &hiddenServices() const;
+    /* Publish an additional service; each hosted identity has its own */
+    void addHiddenService(HiddenService *service);
 
     QVariantMap bootstrapStatus() const;
     QObject *getConfiguration(const QString &options);
@@ -53,6 +53,9 @@ signals:
     void finished();
 
 protected:
+    /* The data passed to onReply and onDataLine (and replyLine) refers
+     * directly to the socket's receive buffer and is only valid for the
+     * duration of the call; deep copy it to keep it around. */
     virtual void onReply(int statusCode, const QByteArray &data);
     virtual void onFinished(int statusCode);
     virtual void onDataLine(const QByteArray &data);
@@ -32,11 +32,17 @@
 
 #include "TorControlSocket.h"
 #include "TorControlCommand.h"
+#include "utils/UnixSocket.h"
 
 using namespace Tor;
 
+// Per-line protocol tracing, disabled by default since bootstrap produces
+// bursts of status and log events; enable with
+// QT_LOGGING_RULES="tego.torctrl.trace.debug=true"
+Q_LOGGING_CATEGORY(torctrlTrace, "tego.torctrl.trace", QtWarningMsg)
+
 TorControlSocket::TorControlSocket(QObject *parent)
-    : QTcpSocket(parent), currentCommand(0), inDataReply(false)
+    : QTcpSocket(parent), currentCommand(0), inDataReply(false), eventsChanged(false), flushScheduled(false)
 {
     connect(this, SIGNAL(readyRead()), this, SLOT(process()));
     connect(this, SIGNAL(disconnected()), this, SLOT(clear()));
@@ -47,38 +53,182 @@ TorControlSocket::~TorControlSocket()
     clear();
 }
 
+bool TorControlSocket::connectToPath(const QString &path)
+{
+    QString message;
+    qintptr fd = connectUnixSocket(path, &message);
+    if (fd < 0) {
+        setErrorString(message);
+        return false;
+    }
+
+    if (!setSocketDescriptor(fd, QAbstractSocket::ConnectedState)) {
+        closeUnixSocket(fd);
+        return false;
+    }
+    return true;
+}
+
 void TorControlSocket::sendCommand(TorControlCommand *command, const QByteArray &data)
+{
+    // Anything batched earlier must hit the wire first to keep replies in order
+    flushPending();
+    writeCommand(command, data);
+}
+
+void TorControlSocket::writeCommand(TorControlCommand *command, const QByteArray &data)
 {
     Q_ASSERT(data.endsWith("\r\n"));
 
     commandQueue.append(command);
     write(data);
 
-    qDebug() << "torctrl: Sent" << data.trimmed();
+    qCDebug(torctrlTrace) << "torctrl: Sent" << data.trimmed();
+}
+
+void TorControlSocket::sendBatchedCommand(TorControlCommand *command, const QByteArray &verb, const BatchArguments &arguments)
+{
+    BatchMember member;
+    member.command = command;
+    member.data = verb;
+    for (const auto &argument : arguments) {
+        member.keys.insert(argument.first.toLower());
+        member.data += ' ';
+        member.data += argument.second;
+    }
+    member.data += "\r\n";
+
+    if (verb != "GETINFO" && verb != "GETCONF") {
+        sendCommand(command, member.data);
+        return;
+    }
+
+    if (pendingBatch.verb != verb)
+        flushBatch();
+
+    for (const auto &pending : qAsConst(pendingBatch.members)) {
+        if (pending.keys.intersects(member.keys)) {
+            flushBatch();
+            break;
+        }
+    }
+
+    if (pendingBatch.members.isEmpty()) {
+        pendingBatch.verb = verb;
+        pendingBatch.data = verb;
+    }
+
+    for (const auto &argument : arguments) {
+        pendingBatch.data += ' ';
+        pendingBatch.data += argument.second;
+    }
+    pendingBatch.members.append(std::move(member));
+
+    scheduleFlush();
 }
 
 void TorControlSocket::registerEvent(const QByteArray &event, TorControlCommand *command)
 {
     eventCommands.insert(event, command);
 
-    QByteArray data("SETEVENTS");
-    foreach (const QByteArray &key, eventCommands.keys()) {
-        data += ' ';
-        data += key;
+    // Registrations made together go out as a single SETEVENTS
+    eventsChanged = true;
+    scheduleFlush();
+}
+
+void TorControlSocket::scheduleFlush()
+{
+    if (flushScheduled)
+        return;
+
+    flushScheduled = true;
+    QTimer::singleShot(0, this, &TorControlSocket::flushPending);
+}
+
+void TorControlSocket::flushPending()
+{
+    flushScheduled = false;
+
+    if (eventsChanged) {
+        eventsChanged = false;
+
+        QByteArray data("SETEVENTS");
+        for (auto it = eventCommands.constBegin(); it != eventCommands.constEnd(); ++it) {
+            data += ' ';
+            data += it.key();
+        }
+        data += "\r\n";
+
+        writeCommand(0, data);
     }
-    data += "\r\n";
 
-    sendCommand(data);
+    flushBatch();
+}
+
+void TorControlSocket::flushBatch()
+{
+    if (pendingBatch.members.isEmpty())
+        return;
+
+    PendingBatch batch = std::move(pendingBatch);
+    pendingBatch = PendingBatch();
+
+    TorControlCommand *lead = batch.members.first().command;
+    if (batch.members.size() > 1)
+        batches.insert(lead, batch.members);
+
+    batch.data += "\r\n";
+    writeCommand(lead, batch.data);
+}
+
+QList<TorControlCommand*> TorControlSocket::replyRecipients(TorControlCommand *command, const QByteArray &line) const
+{
+    QList<TorControlCommand*> recipients;
+    if (!command)
+        return recipients;
+
+    auto it = batches.constFind(command);
+    if (it == batches.constEnd()) {
+        recipients.append(command);
+        return recipients;
+    }
+
+    // key=value, key= for data replies, or a bare key for unset options
+    const int equals = line.indexOf('=');
+    const QByteArray key = (equals >= 0 ? line.left(equals) : line).toLower();
+    for (const BatchMember &member : *it) {
+        if (member.keys.contains(key))
+            recipients.append(member.command);
+    }
+
+    // lines naming no key we asked for, such as the final OK, go to everyone
+    if (recipients.isEmpty()) {
+        for (const BatchMember &member : *it)
+            recipients.append(member.command);
+    }
+    return recipients;
 }
 
 void TorControlSocket::clear()
 {
     qDeleteAll(commandQueue);
     commandQueue.clear();
+    // the first member of each batch went with commandQueue
+    for (const auto &members : qAsConst(batches)) {
+        for (int i = 1; i < members.size(); i++)
+            delete members[i].command;
+    }
+    batches.clear();
+    for (const auto &member : qAsConst(pendingBatch.members))
+        delete member.command;
+    pendingBatch = PendingBatch();
+    dataReplyCommands.clear();
     qDeleteAll(eventCommands);
     eventCommands.clear();
+    eventsChanged = false;
     inDataReply = false;
     currentCommand = 0;
+    readBuffer.clear();
 }
 
 void TorControlSocket::setError(const QString &message)
@@ -90,88 +240,162 @@ void TorControlSocket::setError(const QString &message)
 
 void TorControlSocket::process()
 {
-    for (;;) {
-        if (!canReadLine())
-            return;
+    // Append everything pending to our own buffer in one read; lines are then
+    // parsed in place and handed to commands as non-owning views
+    const qint64 available = bytesAvailable();
+    if (available > 0) {
+        const int oldSize = readBuffer.size();
+        readBuffer.resize(oldSize + static_cast<int>(available));
+        const qint64 count = read(readBuffer.data() + oldSize, available);
+        readBuffer.resize(oldSize + static_cast<int>(qMax<qint64>(count, 0)));
+    }
 
-        QByteArray line = readLine(5120);
-        qDebug() << "torctrl: Recv" << line.trimmed();
+    int consumed = 0;
+    {
+        // Hold a reference to the data for the duration of the parse, handlers
+        // may cause the socket to be cleared from underneath us
+        const QByteArray buffer = readBuffer;
+        const char *begin = buffer.constData();
+        const int size = buffer.size();
 
-        if (!line.endsWith("\r\n")) {
-            setError(QStringLiteral("Invalid control message syntax"));
-            return;
-        }
-        line.chop(2);
+        while (consumed < size) {
+            const char *lineBegin = begin + consumed;
+            const int remaining = size - consumed;
+            const char *newline = static_cast<const char*>(std::memchr(lineBegin, '\n', static_cast<size_t>(qMin(remaining, MaxLineLength))));
+            if (!newline) {
+                if (remaining >= MaxLineLength)
+                    setError(QStringLiteral("Invalid control message syntax"));
+                break;
+            }
 
-        if (inDataReply) {
-            if (line == ".") {
-                inDataReply = false;
-                if (currentCommand)
-                    currentCommand->onDataFinished();
-                currentCommand = 0;
-            } else {
-                if (currentCommand)
-                    currentCommand->onDataLine(line);
+            const int lineLength = static_cast<int>(newline - lineBegin) + 1;
+            consumed += lineLength;
+
+            if (lineLength < 2 || lineBegin[lineLength - 2] != '\r') {
+                setError(QStringLiteral("Invalid control message syntax"));
+                break;
             }
-            continue;
+
+            if (!processLine(lineBegin, lineLength - 2))
+                break;
         }
 
-        if (line.size() < 4) {
-            setError(QStringLiteral("Invalid control message syntax"));
+        // Socket was cleared or errored while processing
+        if (readBuffer.constData() != buffer.constData())
             return;
-        }
+    }
 
-        int statusCode = line.left(3).toInt();
-        char type = line[3];
-        bool isFinalReply = (type == ' ');
-        inDataReply = (type == '+');
+    if (consumed == readBuffer.size())
+        readBuffer.clear();
+    else if (consumed > 0)
+        readBuffer.remove(0, consumed);
+}
 
-        // Trim down to just data
-        line = line.mid(4);
+bool TorControlSocket::processLine(const char *data, int length)
+{
+    qCDebug(torctrlTrace) << "torctrl: Recv" << QByteArray::fromRawData(data, length);
 
-        if (!isFinalReply && !inDataReply && type != '-') {
-            setError(QStringLiteral("Invalid control message syntax"));
-            return;
+    if (inDataReply) {
+        // handlers may clear the socket, so work from a copy of the list
+        const QList<TorControlCommand*> recipients = dataReplyCommands;
+        if (length == 1 && data[0] == '.') {
+            inDataReply = false;
+            dataReplyCommands.clear();
+            currentCommand = 0;
+            for (TorControlCommand *c : recipients)
+                c->onDataFinished();
+        } else {
+            const QByteArray line = QByteArray::fromRawData(data, length);
+            for (TorControlCommand *c : recipients)
+                c->onDataLine(line);
         }
+        return true;
+    }
 
-        // 6xx replies are asynchronous responses
-        if (statusCode >= 600 && statusCode < 700) {
-            if (!currentCommand) {
-                int space = line.indexOf(' ');
-                if (space > 0)
-                    currentCommand = eventCommands.value(line.mid(0, space));
-
-                if (!currentCommand) {
-                    qWarning() << "torctrl: Ignoring unknown event";
-                    continue;
-                }
-            }
+    if (length < 4 ||
+        !std::isdigit(static_cast<unsigned char>(data[0])) ||
+        !std::isdigit(static_cast<unsigned char>(data[1])) ||
+        !std::isdigit(static_cast<unsigned char>(data[2]))) {
+        setError(QStringLiteral("Invalid control message syntax"));
+        return false;
+    }
+
+    const int statusCode = (data[0] - '0') * 100 + (data[1] - '0') * 10 + (data[2] - '0');
+    const char type = data[3];
+    const bool isFinalReply = (type == ' ');
+    inDataReply = (type == '+');
+
+    if (!isFinalReply && !inDataReply && type != '-') {
+        setError(QStringLiteral("Invalid control message syntax"));
+        return false;
+    }
 
-            currentCommand->onReply(statusCode, line);
-            if (isFinalReply) {
-                currentCommand->onFinished(statusCode);
-                currentCommand = 0;
+    // Trim down to just data
+    const QByteArray line = QByteArray::fromRawData(data + 4, length - 4);
+
+    // 6xx replies are asynchronous responses
+    if (statusCode >= 600 && statusCode < 700) {
+        if (!currentCommand) {
+            const char *space = static_cast<const char*>(std::memchr(line.constData(), ' ', static_cast<size_t>(line.size())));
+            if (space && space != line.constData())
+                currentCommand = eventCommands.value(QByteArray::fromRawData(line.constData(), static_cast<int>(space - line.constData())));
+
+            if (!currentCommand) {
+                qWarning() << "torctrl: Ignoring unknown event";
+                return true;
             }
-            continue;
         }
 
-        if (commandQueue.isEmpty()) {
-            qWarning() << "torctrl: Received unexpected data";
-            continue;
+        currentCommand->onReply(statusCode, line);
+        if (inDataReply) {
+            dataReplyCommands.clear();
+            dataReplyCommands.append(currentCommand);
+        } else if (isFinalReply) {
+            currentCommand->onFinished(statusCode);
+            currentCommand = 0;
         }
+        return true;
+    }
 
-        TorControlCommand *command = commandQueue.first();
-        if (command)
-            command->onReply(statusCode, line);
+    if (commandQueue.isEmpty()) {
+        qWarning() << "torctrl: Received unexpected data";
+        return true;
+    }
 
-        if (inDataReply) {
-            currentCommand = command;
-        } else if (isFinalReply) {
-            commandQueue.takeFirst();
-            if (command) {
-                command->onFinished(statusCode);
-                command->deleteLater();
-            }
+    TorControlCommand *command = commandQueue.first();
+
+    if (isFinalReply && statusCode != 250 && batches.contains(command)) {
+        // Tor answers a query with a bad key with a single error line, so no
+        // member has seen a reply yet; ask again separately so only the
+        // caller at fault gets the error
+        commandQueue.takeFirst();
+        const QList<BatchMember> members = batches.take(command);
+        for (const BatchMember &member : members)
+            writeCommand(member.command, member.data);
+        return true;
+    }
+
+    const QList<TorControlCommand*> recipients = replyRecipients(command, line);
+    for (TorControlCommand *c : recipients)
+        c->onReply(statusCode, line);
+
+    if (inDataReply) {
+        currentCommand = command;
+        dataReplyCommands = recipients;
+    } else if (isFinalReply) {
+        commandQueue.takeFirst();
+        // Detach the batch before notifying, handlers may clear the socket
+        const QList<BatchMember> members = batches.take(command);
+        QList<TorControlCommand*> finished;
+        if (members.isEmpty() && command)
+            finished.append(command);
+        for (const BatchMember &member : members)
+            finished.append(member.command);
+
+        for (TorControlCommand *c : finished) {
+            c->onFinished(statusCode);
+            c->deleteLater();
         }
     }
+    return true;
 }
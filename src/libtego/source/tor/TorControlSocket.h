@@ -33,6 +33,8 @@
 #ifndef TORCONTROLSOCKET_H
 #define TORCONTROLSOCKET_H
 
+Q_DECLARE_LOGGING_CATEGORY(torctrlTrace)
+
 namespace Tor
 {
 
@@ -47,26 +49,82 @@ public:
 
     QString errorMessage() const { return m_errorMessage; }
 
+    /* Connect to a control port exposed as a unix domain socket (tor's
+     * ControlSocket option). The connection is established synchronously;
+     * connected() is not emitted. Unsupported on Windows. */
+    bool connectToPath(const QString &path);
+
     void registerEvent(const QByteArray &event, TorControlCommand *handler);
 
     void sendCommand(const QByteArray &data) { sendCommand(0, data); }
     void sendCommand(TorControlCommand *command, const QByteArray &data);
 
+    /* Queue a GETINFO or GETCONF whose keys can be merged with those of other
+     * commands using the same verb issued during the same event loop
+     * iteration. The merged command is written once control returns to the
+     * event loop (or before any unbatched command). Each command is handed
+     * only the reply lines for the keys it asked for, plus those naming no
+     * key such as the final OK. Tor refuses a whole query over one bad key,
+     * so a merged command that fails is sent again as one command per
+     * caller, each getting its own answer. Arguments are (key, token) pairs;
+     * repeating a key already in the batch starts a new command.
+     *
+     * Any other verb is sent unmerged: tor applies a SETCONF or RESETCONF
+     * atomically, so one caller's bad setting would fail every caller merged
+     * with it. */
+    typedef QList<QPair<QByteArray, QByteArray> > BatchArguments;
+    void sendBatchedCommand(TorControlCommand *command, const QByteArray &verb, const BatchArguments &arguments);
+
 signals:
     void error(const QString &message);
 
 private slots:
     void process();
     void clear();
+    void flushPending();
 
 private:
+    // Longest line accepted from the control port, including CRLF
+    static const int MaxLineLength = 5120;
+
     QQueue<TorControlCommand*> commandQueue;
     QHash<QByteArray,TorControlCommand*> eventCommands;
     QString m_errorMessage;
     TorControlCommand *currentCommand;
     bool inDataReply;
+    // Received bytes not yet parsed into complete lines
+    QByteArray readBuffer;
+
+    // A command merged into a batch
+    struct BatchMember {
+        TorControlCommand *command;
+        // the command's own line, should it need to be sent alone
+        QByteArray data;
+        // lower case keys it asked for
+        QSet<QByteArray> keys;
+    };
+    // Batched command being accumulated for this event loop iteration
+    struct PendingBatch {
+        QByteArray verb;
+        QByteArray data;
+        QList<BatchMember> members;
+    } pendingBatch;
+    // Members of each written batch of more than one command, keyed by the
+    // first of them, which is the one in commandQueue
+    QHash<TorControlCommand*, QList<BatchMember> > batches;
+    // Commands receiving the lines of the current data reply
+    QList<TorControlCommand*> dataReplyCommands;
+    bool eventsChanged;
+    bool flushScheduled;
+
+    void scheduleFlush();
+    void flushBatch();
+    void writeCommand(TorControlCommand *command, const QByteArray &data);
+    QList<TorControlCommand*> replyRecipients(TorControlCommand *command, const QByteArray &line) const;
 
     void setError(const QString &message);
+    // Returns false if processing must stop
+    bool processLine(const char *data, int length);
 };
 
 }
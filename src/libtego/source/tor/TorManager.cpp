@@ -40,6 +40,8 @@
 #include "globals.hpp"
 
 #include "torrc.hpp"
+#include "tor_log.hpp"
+#include "utils/UnixSocket.h"
 using tego::g_globals;
 
 using namespace Tor;
@@ -56,7 +58,14 @@ public:
     TorProcess *process;
     TorControl *control;
     QString dataDir;
-    QStringList logMessages;
+    // shared tor mode
+    QHostAddress externalAddress;
+    quint16 externalPort;
+    QString externalSocket;
+    QByteArray externalPassword;
+    bool warmStart;
+    bool unixSockets;
+    tego::tor_log_buffer logBuffer;
     QString errorMessage;
 
     explicit TorManagerPrivate(TorManager *parent = 0);
@@ -64,6 +73,7 @@ public:
     QString torExecutablePath() const;
     bool createDataDir(const QString &path);
     bool createDefaultTorrc(const QString &path);
+    bool hasCachedDirectoryInfo() const;
 
     void setError(const QString &errorMessage);
 
@@ -86,6 +96,9 @@ TorManagerPrivate::TorManagerPrivate(TorManager *parent)
     , q(parent)
     , process(0)
     , control(new TorControl(this))
+    , externalPort(0)
+    , warmStart(false)
+    , unixSockets(false)
 {
     connect(control, SIGNAL(statusChanged(int,int)), SLOT(controlStatusChanged(int)));
 }
@@ -120,9 +133,69 @@ void TorManager::setDataDirectory(const QString &path)
         d->dataDir.append(QLatin1Char('/'));
 }
 
-QStringList TorManager::logMessages() const
+void TorManager::setExternalControlPort(const QHostAddress &address, quint16 port)
 {
-    return d->logMessages;
+    d->externalAddress = address;
+    d->externalPort = port;
+    d->externalSocket.clear();
+}
+
+void TorManager::setExternalControlSocket(const QString &path)
+{
+    d->externalSocket = path;
+    d->externalAddress.clear();
+    d->externalPort = 0;
+}
+
+void TorManager::setExternalControlPassword(const QByteArray &password)
+{
+    d->externalPassword = password;
+}
+
+bool TorManager::isExternal() const
+{
+    return !d->externalSocket.isEmpty() || (!d->externalAddress.isNull() && d->externalPort != 0);
+}
+
+bool TorManager::isWarmStart() const
+{
+    return d->warmStart;
+}
+
+void TorManager::setUnixSocketsEnabled(bool enabled)
+{
+#ifdef Q_OS_UNIX
+    d->unixSockets = enabled;
+#else
+    Q_UNUSED(enabled);
+#endif
+    d->control->setPreferUnixSockets(d->unixSockets);
+}
+
+bool TorManager::unixSocketsEnabled() const
+{
+    return d->unixSockets;
+}
+
+QString TorManager::unixSocketPath(const QString &name) const
+{
+    if (!d->unixSockets || d->dataDir.isEmpty())
+        return QString();
+
+    // tor cannot take quoted paths in every place we hand them over (the
+    // ADD_ONION target in particular), and sun_path is short
+    const QString path = QDir::toNativeSeparators(d->dataDir + name);
+    if (path.contains(QLatin1Char(' ')) || path.contains(QLatin1Char('"')) ||
+        QFile::encodeName(path).size() >= unixSocketMaxPathLength()) {
+        qDebug() << "Not using unix socket" << path << "- path is unusable, falling back to TCP";
+        return QString();
+    }
+    return path;
+}
+
+const tego::tor_log_buffer& TorManager::logBuffer() const
+{
+    return d->logBuffer;
 }
 
 QString TorManager::running() const
@@ -160,6 +233,19 @@ void TorManager::start()
             tegoError.release());
     }
 
+    if (isExternal()) {
+        d->warmStart = true;
+        // Shared tor: nothing to launch or configure, our services are
+        // published (detached) through the existing instance's control port
+        g_globals.context->callback_registry_.emit_tor_process_status_changed(tego_tor_process_status_external);
+        d->control->setAuthPassword(d->externalPassword);
+        if (!d->externalSocket.isEmpty())
+            d->control->connect(d->externalSocket);
+        else
+            d->control->connect(d->externalAddress, d->externalPort);
+        return;
+    }
+
     // Launch a bundled Tor instance
     QString executable = d->torExecutablePath();
     if (executable.isEmpty()) {
@@ -180,6 +266,12 @@ void TorManager::start()
         return;
     }
 
+    // tor's caches (consensus, microdescriptors, certificates and guard
+    // state) live alongside our torrc files and are reused as-is; only the
+    // files we manage are replaced
+    d->warmStart = d->hasCachedDirectoryInfo();
+    qDebug() << "Starting tor," << (d->warmStart ? "reusing cached directory information" : "no cached directory information");
+
     // always write out a new default torrc
     QString defaultTorrc = d->dataDir + QStringLiteral("default_torrc");
     if (QFile::exists(defaultTorrc) && !QFile::remove(defaultTorrc)) {
@@ -197,6 +289,15 @@ void TorManager::start()
         QFile::remove(torrc);
     }
 
+    // an extra SOCKS listener on a unix socket; the TCP one stays as a fallback
+    QStringList extraSettings;
+    const QString socksSocket = unixSocketPath(QStringLiteral("socks.sock"));
+    if (!socksSocket.isEmpty()) {
+        QFile::remove(socksSocket);
+        extraSettings << QStringLiteral("+SocksPort") << (QStringLiteral("unix:") + socksSocket);
+    }
+    d->process->setExtraSettings(extraSettings);
+
     d->process->setExecutable(executable);
     d->process->setDataDir(d->dataDir);
     d->process->setDefaultTorrc(defaultTorrc);
@@ -239,14 +340,13 @@ void TorManagerPrivate::processErrorChanged(const QString &message)
 void TorManagerPrivate::processLogMessage(const QString &message)
 {
     qDebug() << "tor:" << message;
-    if (logMessages.size() >= 50)
-        logMessages.takeFirst();
-    logMessages.append(message);
 
-    emit q->logMessage(message);
-
-    // marshall message out of the QString into our own char buffer
+    // marshall message out of the QString into utf8 once, and share it between
+    // the log ring and the callback
     auto utf8 = message.toUtf8();
+    logBuffer.append(utf8.constData(), static_cast<size_t>(utf8.size()));
+
+    emit q->logMessage(message);
 
     const auto msgLength = utf8.size();
     const auto msgSize = msgLength + 1;
@@ -335,6 +435,18 @@ bool TorManagerPrivate::createDefaultTorrc(const QString &path)
     return true;
 }
 
+bool TorManagerPrivate::hasCachedDirectoryInfo() const
+{
+    // tor (as configured by us) fetches microdescriptor consensuses; a full
+    // consensus is only present if the user configured tor to fetch one
+    for (auto cache : {"cached-microdesc-consensus", "cached-consensus"}) {
+        QFileInfo info(dataDir + QLatin1String(cache));
+        if (info.isFile() && info.size() > 0)
+            return true;
+    }
+    return false;
+}
+
 void TorManagerPrivate::setError(const QString &message)
 {
     errorMessage = message;
@@ -33,6 +33,11 @@
 #ifndef TORMANAGER_H
 #define TORMANAGER_H
 
+namespace tego
+{
+    class tor_log_buffer;
+}
+
 namespace Tor
 {
 
@@ -55,7 +60,25 @@ public:
     QString dataDirectory() const;
     void setDataDirectory(const QString &path);
 
-    QStringList logMessages() const;
+    /* Attach to an externally managed tor instead of launching our own;
+     * without a password, cookie or no authentication is negotiated */
+    void setExternalControlPort(const QHostAddress &address, quint16 port);
+    void setExternalControlSocket(const QString &path);
+    void setExternalControlPassword(const QByteArray &password);
+    bool isExternal() const;
+
+    /* True if tor was started with directory information cached in the data
+     * directory by an earlier run, or is external and already running */
+    bool isWarmStart() const;
+
+    /* Use unix domain sockets for SOCKS and onion service targets */
+    void setUnixSocketsEnabled(bool enabled);
+    bool unixSocketsEnabled() const;
+    /* Path of a socket named name in the data directory, or an empty string
+     * if unix sockets are disabled or that path would be unusable */
+    QString unixSocketPath(const QString &name) const;
+
+    const tego::tor_log_buffer& logBuffer() const;
     QString running() const;
 
     bool hasError() const;
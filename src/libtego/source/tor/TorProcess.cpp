@@ -48,7 +48,7 @@ TorProcess::~TorProcess()
 }
 
 TorProcessPrivate::TorProcessPrivate(TorProcess *tp)
-    : QObject(tp), q(tp), state(TorProcess::NotStarted), controlPort(0), controlPortAttempts(0)
+    : QObject(tp), q(tp), state(TorProcess::NotStarted), controlPort(0)
 {
     connect(&process, &QProcess::started, this, &TorProcessPrivate::processStarted);
     //XXX: This static cast shouldn't be needed here, but it is. Why?
@@ -56,8 +56,15 @@ TorProcessPrivate::TorProcessPrivate(TorProcess *tp)
     connect(&process, &QProcess::errorOccurred, this, &TorProcessPrivate::processError);
     connect(&process, &QProcess::readyRead, this, &TorProcessPrivate::processReadable);
 
-    controlPortTimer.setInterval(500);
-    connect(&controlPortTimer, &QTimer::timeout, this, &TorProcessPrivate::tryReadControlPort);
+    // the wheel's timers are single shot, so re-arm before polling; a
+    // successful or failed read stops it again
+    controlPortTimer.setCallback(
+        [this]() {
+            controlPortTimer.start(ControlPortPollInterval);
+            tryReadControlPort();
+        }
+    );
+    connect(&controlPortWatcher, &QFileSystemWatcher::directoryChanged, this, &TorProcessPrivate::tryReadControlPort);
 }
 
 QString TorProcess::executable() const
@@ -153,6 +160,7 @@ void TorProcess::start()
     args << d->extraSettings;
 
     d->state = Starting;
+    d->startupTimer.start();
     emit stateChanged(d->state);
 
     if (QFile::exists(d->controlPortFilePath()))
@@ -169,7 +177,7 @@ void TorProcess::stop()
     if (state() < Starting)
         return;
 
-    d->controlPortTimer.stop();
+    d->stopControlPortDiscovery();
 
     if (d->process.state() == QProcess::Starting)
         d->process.waitForStarted(2000);
@@ -239,13 +247,37 @@ QString TorProcessPrivate::controlPortFilePath() const
     return QDir::toNativeSeparators(dataDir) + QDir::separator() + QStringLiteral("control-port");
 }
 
+void TorProcessPrivate::traceStartupPhase(const char *phase) const
+{
+    qDebug() << "torprocess: startup phase" << phase << "after" << startupTimer.elapsed() << "ms";
+}
+
+void TorProcessPrivate::stopControlPortDiscovery()
+{
+    controlPortTimer.stop();
+    const QStringList watched = controlPortWatcher.directories();
+    if (!watched.isEmpty())
+        controlPortWatcher.removePaths(watched);
+}
+
 void TorProcessPrivate::processStarted()
 {
+    traceStartupPhase("process started");
+
     state = TorProcess::Connecting;
     emit q->stateChanged(state);
 
-    controlPortAttempts = 0;
-    controlPortTimer.start();
+    // ControlPortWriteToFile replaces the file within the data directory,
+    // so watching the directory catches it being created; then the timer
+    // only has to fire once, just after the deadline, to give up
+    if (controlPortWatcher.addPath(dataDir)) {
+        const int remaining = qMax(ControlPortTimeout - static_cast<int>(startupTimer.elapsed()), 0);
+        controlPortTimer.start(remaining + ControlPortPollInterval);
+    } else {
+        qWarning() << "torprocess: Cannot watch" << dataDir << "for the control port file, falling back to polling";
+        controlPortTimer.start(ControlPortPollInterval);
+    }
+    tryReadControlPort();
 }
 
 void TorProcessPrivate::processFinished()
@@ -253,7 +285,7 @@ void TorProcessPrivate::processFinished()
     if (state < TorProcess::Starting)
         return;
 
-    controlPortTimer.stop();
+    stopControlPortDiscovery();
     errorMessage = process.errorString();
     if (errorMessage.isEmpty())
         errorMessage = QStringLiteral("Process exited unexpectedly (code %1)").arg(process.exitCode());
@@ -272,13 +304,23 @@ void TorProcessPrivate::processReadable()
 {
     while (process.bytesAvailable() > 0) {
         QByteArray line = process.readLine(2048).trimmed();
-        if (!line.isEmpty())
-            emit q->logMessage(QString::fromLatin1(line));
+        if (line.isEmpty())
+            continue;
+
+        // tor notes "Opened Control listener connection (ready) on ..." just
+        // before writing out the control port file
+        if (state == TorProcess::Connecting && line.contains("Control listener"))
+            tryReadControlPort();
+
+        emit q->logMessage(QString::fromLatin1(line));
     }
 }
 
 void TorProcessPrivate::tryReadControlPort()
 {
+    if (state != TorProcess::Connecting)
+        return;
+
     QFile file(controlPortFilePath());
     if (file.open(QIODevice::ReadOnly)) {
         QByteArray data = file.readLine().trimmed();
@@ -289,7 +331,8 @@ void TorProcessPrivate::tryReadControlPort()
             controlPort = data.mid(p+1).toUShort();
 
             if (!controlHost.isNull() && controlPort > 0) {
-                controlPortTimer.stop();
+                stopControlPortDiscovery();
+                traceStartupPhase("control port available");
                 state = TorProcess::Ready;
                 emit q->stateChanged(state);
                 return;
@@ -297,7 +340,8 @@ void TorProcessPrivate::tryReadControlPort()
         }
     }
 
-    if (++controlPortAttempts * controlPortTimer.interval() > 10000) {
+    if (startupTimer.elapsed() > ControlPortTimeout) {
+        stopControlPortDiscovery();
         errorMessage = QStringLiteral("No control port available after launching process");
         state = TorProcess::Failed;
         emit q->errorMessageChanged(errorMessage);
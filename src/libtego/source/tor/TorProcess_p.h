@@ -34,6 +34,7 @@
 #define TORPROCESS_P_H
 
 #include "TorProcess.h"
+#include "utils/TimerWheel.h"
 
 namespace Tor {
 
@@ -54,14 +55,23 @@ public:
     quint16 controlPort;
     QByteArray controlPassword;
 
-    QTimer controlPortTimer;
-    int controlPortAttempts;
+    // the control port is picked up as soon as tor announces it on stdout
+    // or the data directory changes; the timer polls only if the directory
+    // can't be watched, and otherwise just enforces the timeout
+    QFileSystemWatcher controlPortWatcher;
+    WheelTimer controlPortTimer;
+    static const int ControlPortPollInterval = 500;
+    static const int ControlPortTimeout = 10000;
+    // time since start(), used to trace startup phases and time out
+    QElapsedTimer startupTimer;
 
     TorProcessPrivate(TorProcess *q);
 
     QString torrcPath() const;
     QString controlPortFilePath() const;
     bool ensureFilesExist();
+    void traceStartupPhase(const char *phase) const;
+    void stopControlPortDiscovery();
 
 public slots:
     void processStarted();
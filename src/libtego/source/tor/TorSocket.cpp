@@ -35,6 +35,7 @@ using tego::g_globals;
 
 #include "TorSocket.h"
 #include "TorControl.h"
+#include "utils/UnixSocket.h"
 
 using namespace Tor;
 
@@ -44,13 +45,14 @@ TorSocket::TorSocket(QObject *parent)
     , m_reconnectEnabled(true)
     , m_maxInterval(900)
     , m_connectAttempts(0)
+    , m_socksStage(SocksIdle)
 {
     connect(g_globals.context->torControl, SIGNAL(connectivityChanged()), SLOT(connectivityChanged()));
-    connect(&m_connectTimer, SIGNAL(timeout()), SLOT(reconnect()));
     connect(this, SIGNAL(disconnected()), SLOT(onFailed()));
     connect(this, SIGNAL(error(QAbstractSocket::SocketError)), SLOT(onFailed()));
+    connect(this, &QIODevice::readyRead, this, &TorSocket::socksReadyRead);
 
-    m_connectTimer.setSingleShot(true);
+    m_connectTimer.setCallback([this]() { reconnect(); });
     connectivityChanged();
 }
 
@@ -81,7 +83,6 @@ void TorSocket::resetAttempts()
 {
     m_connectAttempts = 0;
     if (m_connectTimer.isActive()) {
-        m_connectTimer.stop();
         m_connectTimer.start(reconnectInterval() * 1000);
     }
 }
@@ -132,6 +133,12 @@ void TorSocket::connectToHost(const QString &hostName, quint16 port, OpenMode op
     if (!g_globals.context->torControl->hasConnectivity())
         return;
 
+    const QString socksSocket = g_globals.context->torControl->socksSocketPath();
+    if (!socksSocket.isEmpty()) {
+        connectThroughSocksSocket(socksSocket);
+        return;
+    }
+
     if (proxy() != g_globals.context->torControl->connectionProxy())
         setProxy(g_globals.context->torControl->connectionProxy());
 
@@ -143,8 +150,97 @@ void TorSocket::connectToHost(const QHostAddress &address, quint16 port, OpenMod
     TorSocket::connectToHost(address.toString(), port, openMode);
 }
 
+void TorSocket::connectThroughSocksSocket(const QString &socketPath)
+{
+    // onion hostnames are plain ascii and SOCKS5 limits them to 255 bytes
+    const QByteArray host = m_host.toLatin1();
+    if (host.isEmpty() || host.size() > 255) {
+        qWarning() << "Cannot connect to" << m_host << "through tor's SOCKS socket";
+        return;
+    }
+
+    setProxy(QNetworkProxy::NoProxy);
+
+    QString message;
+    qintptr fd = connectUnixSocket(socketPath, &message);
+    if (fd < 0) {
+        socksFailed(message);
+        return;
+    }
+    if (!setSocketDescriptor(fd, QAbstractSocket::ConnectedState)) {
+        closeUnixSocket(fd);
+        socksFailed(errorString());
+        return;
+    }
+
+    // version 5, offering only 'no authentication'
+    m_socksStage = SocksAwaitingMethod;
+    write("\x05\x01\x00", 3);
+}
+
+void TorSocket::socksReadyRead()
+{
+    if (m_socksStage == SocksAwaitingMethod) {
+        if (bytesAvailable() < 2)
+            return;
+
+        char reply[2];
+        read(reply, sizeof(reply));
+        if (reply[0] != 0x05 || reply[1] != 0x00) {
+            socksFailed(QStringLiteral("SOCKS method negotiation failed"));
+            return;
+        }
+
+        // CONNECT to a domain name, port in network order
+        const QByteArray host = m_host.toLatin1();
+        QByteArray request("\x05\x01\x00\x03", 4);
+        request.append(static_cast<char>(host.size()));
+        request.append(host);
+        request.append(static_cast<char>(m_port >> 8));
+        request.append(static_cast<char>(m_port & 0xff));
+        m_socksStage = SocksAwaitingReply;
+        write(request);
+        return;
+    }
+
+    if (m_socksStage != SocksAwaitingReply || bytesAvailable() < 5)
+        return;
+
+    const QByteArray header = peek(5);
+    if (header[0] != 0x05 || header[1] != 0x00) {
+        socksFailed(QStringLiteral("SOCKS connect failed with reply %1").arg(static_cast<uchar>(header[1])));
+        return;
+    }
+
+    // the reply ends with the bound address, which tor leaves zeroed
+    qint64 length = 0;
+    switch (header[3]) {
+    case 0x01: length = 4 + 4 + 2; break;
+    case 0x03: length = 4 + 1 + static_cast<uchar>(header[4]) + 2; break;
+    case 0x04: length = 4 + 16 + 2; break;
+    default:
+        socksFailed(QStringLiteral("Malformed SOCKS reply"));
+        return;
+    }
+    if (bytesAvailable() < length)
+        return;
+
+    read(length);
+    m_socksStage = SocksIdle;
+    emit connected();
+}
+
+void TorSocket::socksFailed(const QString &message)
+{
+    qDebug() << "SOCKS connection to" << m_host << m_port << "failed:" << message;
+    setErrorString(message);
+    onFailed();
+}
+
 void TorSocket::onFailed()
 {
+    m_socksStage = SocksIdle;
+
     // Make sure the internal connection to the SOCKS proxy is closed
     // Otherwise reconnect attempts will fail (#295)
     close();
@@ -33,6 +33,8 @@
 #ifndef TORSOCKET_H
 #define TORSOCKET_H
 
+#include "utils/TimerWheel.h"
+
 namespace Tor {
 
 /* Specialized QTcpSocket which makes connections over the SOCKS proxy
@@ -77,15 +79,28 @@ private slots:
     void reconnect();
     void connectivityChanged();
     void onFailed();
+    void socksReadyRead();
 
 private:
     QString m_host;
     quint16 m_port;
-    QTimer m_connectTimer;
+    WheelTimer m_connectTimer;
     bool m_reconnectEnabled;
     int m_maxInterval;
     int m_connectAttempts;
 
+    /* QNetworkProxy only reaches TCP proxies, so SOCKS5 over tor's unix
+     * socket listener is spoken here; connected() is emitted once tor has
+     * established the stream */
+    enum SocksStage {
+        SocksIdle,
+        SocksAwaitingMethod,
+        SocksAwaitingReply
+    } m_socksStage;
+
+    void connectThroughSocksSocket(const QString &socketPath);
+    void socksFailed(const QString &message);
+
     using QAbstractSocket::connectToHost;
 };
 
@@ -0,0 +1,78 @@
+#include "tor_log.hpp"
+#include "error.hpp"
+
+namespace tego
+{
+    tor_log_buffer::tor_log_buffer(size_t capacity)
+    : entries_(capacity)
+    {
+        TEGO_THROW_IF_FALSE(capacity > 0);
+    }
+
+    uint64_t tor_log_buffer::append(char const* line, size_t lineLength)
+    {
+        const auto sequence = nextSequence_++;
+        auto& e = entries_[static_cast<size_t>(sequence % entries_.size())];
+
+        // assign rather than replace so the slot's existing capacity is reused
+        e.text.assign(line, lineLength);
+        e.offset = totalBytes_;
+        totalBytes_ += lineLength + 1;
+
+        return sequence;
+    }
+
+    uint64_t tor_log_buffer::first_sequence() const
+    {
+        const auto capacity = static_cast<uint64_t>(entries_.size());
+        return nextSequence_ > capacity ? nextSequence_ - capacity : 0;
+    }
+
+    size_t tor_log_buffer::size_since(uint64_t sequence) const
+    {
+        sequence = std::max(sequence, first_sequence());
+        if (sequence >= nextSequence_)
+        {
+            return 0;
+        }
+        return static_cast<size_t>(totalBytes_ - slot(sequence).offset);
+    }
+
+    size_t tor_log_buffer::copy_since(
+        uint64_t sequence,
+        char* dest,
+        size_t destSize,
+        uint64_t* out_nextSequence) const
+    {
+        TEGO_THROW_IF_NULL(dest);
+        TEGO_THROW_IF_FALSE(destSize > 0);
+
+        auto seq = std::max(sequence, first_sequence());
+        // leave room for the null terminator
+        const auto available = destSize - 1;
+        size_t written = 0;
+        for(; seq < nextSequence_; ++seq)
+        {
+            const auto& text = slot(seq).text;
+            if (written + text.size() + 1 > available)
+            {
+                break;
+            }
+            std::copy(text.begin(), text.end(), dest + written);
+            written += text.size();
+            dest[written++] = '\n';
+        }
+        dest[written++] = 0;
+
+        if (out_nextSequence != nullptr)
+        {
+            *out_nextSequence = seq;
+        }
+        return written;
+    }
+
+    tor_log_buffer::entry const& tor_log_buffer::slot(uint64_t sequence) const
+    {
+        return entries_[static_cast<size_t>(sequence % entries_.size())];
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+//
+// Tego Tor Log
+//
+
+namespace tego
+{
+    //
+    // Fixed-capacity ring of UTF-8 tor log lines
+    //
+    // Every appended line is assigned a monotonically increasing sequence
+    // number, so clients can hold on to a cursor and ask for only the lines
+    // which have arrived since they last looked. Once full, the oldest line is
+    // overwritten in place and its slot's string storage is reused.
+    //
+    // When serialised, each line is terminated with a newline character '\n'
+    //
+    class tor_log_buffer
+    {
+    public:
+        constexpr static size_t DEFAULT_CAPACITY = 128;
+
+        explicit tor_log_buffer(size_t capacity = DEFAULT_CAPACITY);
+
+        // append a line, returns its sequence number
+        uint64_t append(char const* line, size_t lineLength);
+
+        // sequence number of the oldest line still held
+        uint64_t first_sequence() const;
+
+        // number of bytes (including newlines, excluding null terminator)
+        // needed to serialise every held line from sequence onwards
+        size_t size_since(uint64_t sequence) const;
+
+        // copies as many whole lines from sequence onwards as will fit in
+        // dest (keeping room for a null terminator) and returns the number
+        // of bytes written including null terminator; out_nextSequence is set
+        // to the cursor the caller should pass on its next call
+        size_t copy_since(
+            uint64_t sequence,
+            char* dest,
+            size_t destSize,
+            uint64_t* out_nextSequence) const;
+
+    private:
+        struct entry
+        {
+            std::string text;
+            // total bytes appended to the log before this line
+            uint64_t offset = 0;
+        };
+
+        entry const& slot(uint64_t sequence) const;
+
+        std::vector<entry> entries_;
+        uint64_t nextSequence_ = 0;
+        // total bytes ever appended (including newlines)
+        uint64_t totalBytes_ = 0;
+    };
+}
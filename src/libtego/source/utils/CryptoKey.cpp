@@ -34,10 +34,106 @@
 #include "SecureRNG.h"
 #include "Useful.h"
 #include "utils/StringUtil.h"
+#include "ed25519.hpp"
+#include "error.hpp"
+
+namespace
+{
+    // LRU cache of public keys decoded from service ids
+    //
+    // Decoding means base32 decoding and checking the checksum, which we would
+    // otherwise repeat on every reconnect of every contact. Lookups of cached
+    // keys only bump a reference count. Accessed from the auth verifier's
+    // worker threads, so guarded by a mutex.
+    class PublicKeyCache
+    {
+    public:
+        constexpr static size_t CAPACITY = 4096;
+
+        using key_t = std::array<char, TEGO_V3_ONION_SERVICE_ID_LENGTH>;
+        using value_t = std::shared_ptr<const tego_ed25519_public_key_t>;
+
+        static PublicKeyCache& instance()
+        {
+            static PublicKeyCache cache;
+            return cache;
+        }
+
+        value_t get(const key_t& serviceId)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = index_.find(serviceId);
+            if (it == index_.end())
+            {
+                return {};
+            }
+            // move to front (most recently used)
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->second;
+        }
+
+        void put(const key_t& serviceId, value_t publicKey)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (auto it = index_.find(serviceId); it != index_.end())
+            {
+                entries_.splice(entries_.begin(), entries_, it->second);
+                return;
+            }
+
+            if (entries_.size() >= CAPACITY)
+            {
+                // evict least recently used, recycling its node
+                auto last = std::prev(entries_.end());
+                index_.erase(last->first);
+                last->first = serviceId;
+                last->second = std::move(publicKey);
+                entries_.splice(entries_.begin(), entries_, last);
+            }
+            else
+            {
+                entries_.emplace_front(serviceId, std::move(publicKey));
+            }
+            index_.emplace(serviceId, entries_.begin());
+        }
+
+    private:
+        PublicKeyCache()
+        {
+            index_.reserve(CAPACITY);
+        }
+
+        struct key_hash
+        {
+            size_t operator()(const key_t& key) const
+            {
+                return std::hash<std::string_view>()(std::string_view(key.data(), key.size()));
+            }
+        };
+
+        std::mutex mutex_;
+        std::list<std::pair<key_t, value_t>> entries_;
+        std::unordered_map<key_t, decltype(entries_)::iterator, key_hash> index_;
+    };
+}
 
 bool CryptoKey::loadFromServiceId(const QByteArray& data)
 {
     this->clear();
+
+    PublicKeyCache::key_t cacheKey;
+    const bool cacheable = data.size() == TEGO_V3_ONION_SERVICE_ID_LENGTH;
+    if (cacheable)
+    {
+        std::copy(data.begin(), data.end(), cacheKey.begin());
+        if (auto publicKey = PublicKeyCache::instance().get(cacheKey); publicKey)
+        {
+            this->publicKey_ = std::move(publicKey);
+            this->serviceId_ = data;
+            return true;
+        }
+    }
+
     // convert string to service id
     std::unique_ptr<tego_v3_onion_service_id_t> serviceId;
     tego_v3_onion_service_id_from_string(
@@ -53,6 +149,12 @@ bool CryptoKey::loadFromServiceId(const QByteArray& data)
         serviceId.get(),
         tego::throw_on_error());
     this->publicKey_ = std::move(publicKey);
+    this->serviceId_ = data;
+
+    if (cacheable)
+    {
+        PublicKeyCache::instance().put(cacheKey, this->publicKey_);
+    }
 
     return true;
 }
@@ -78,6 +180,22 @@ bool CryptoKey::loadFromKeyBlob(const QByteArray& keyBlob)
         tego::throw_on_error());
     this->publicKey_ = std::move(publicKey);
 
+    // convert public key to service id
+    std::unique_ptr<tego_v3_onion_service_id_t> serviceId;
+    tego_v3_onion_service_id_from_ed25519_public_key(
+        tego::out(serviceId),
+        this->publicKey_.get(),
+        tego::throw_on_error());
+
+    // service id to string
+    char serviceIdString[TEGO_V3_ONION_SERVICE_ID_SIZE] = {0};
+    tego_v3_onion_service_id_to_string(
+        serviceId.get(),
+        serviceIdString,
+        sizeof(serviceIdString),
+        tego::throw_on_error());
+    this->serviceId_ = QByteArray(serviceIdString);
+
     return true;
 }
 
@@ -85,6 +203,7 @@ void CryptoKey::clear()
 {
     privateKey_ = {};
     publicKey_ = {};
+    serviceId_.clear();
 }
 
 bool CryptoKey::isPrivate() const
@@ -104,65 +223,66 @@ QByteArray CryptoKey::encodedKeyBlob() const
 
 QByteArray CryptoKey::torServiceID() const
 {
-    // convert public key to service id
-    std::unique_ptr<tego_v3_onion_service_id_t> serviceId;
-    tego_v3_onion_service_id_from_ed25519_public_key(
-        tego::out(serviceId),
-        this->publicKey_.get(),
-        tego::throw_on_error());
-
-    // service id to string
-    char serviceIdString[TEGO_V3_ONION_SERVICE_ID_SIZE] = {0};
-    tego_v3_onion_service_id_to_string(
-        serviceId.get(),
-        serviceIdString,
-        sizeof(serviceIdString),
-        tego::throw_on_error());
-
-    QByteArray retval(serviceIdString);
-    return retval;
+    return serviceId_;
 }
 
 QByteArray CryptoKey::signData(const QByteArray &msg) const
 {
-    // calculate signature
-    std::unique_ptr<tego_ed25519_signature_t> signature;
-    tego_message_ed25519_sign(
+    uint8_t signature[TEGO_ED25519_SIGNATURE_SIZE] = {0};
+    this->signData(
         reinterpret_cast<const uint8_t*>(msg.data()),
         static_cast<size_t>(msg.size()),
-        this->privateKey_.get(),
-        this->publicKey_.get(),
-        tego::out(signature),
-        tego::throw_on_error());
+        signature);
 
-    // signature to byte blob
-    QByteArray retval(TEGO_ED25519_SIGNATURE_SIZE, 0x00);
-    tego_ed25519_signature_to_bytes(
-        signature.get(),
-        reinterpret_cast<uint8_t*>(retval.data()),
-        static_cast<size_t>(retval.size()),
-        tego::throw_on_error());
+    return QByteArray(reinterpret_cast<const char*>(signature), sizeof(signature));
+}
 
-    return retval;
+void CryptoKey::signData(const uint8_t* msg, size_t msgSize, uint8_t (&out_signature)[TEGO_ED25519_SIGNATURE_SIZE]) const
+{
+    TEGO_THROW_IF_NULL(msg);
+    TEGO_THROW_IF_FALSE(msgSize > 0);
+    TEGO_THROW_IF_NULL(this->privateKey_);
+    TEGO_THROW_IF_NULL(this->publicKey_);
+
+    // private key is kept in its expanded form, so sign directly rather
+    // than going through the C API and its heap allocated signature
+    TEGO_THROW_IF_FALSE(
+        ::ed25519_donna_sign(
+            out_signature,
+            msg,
+            msgSize,
+            this->privateKey_->data,
+            this->publicKey_->data) == 0);
 }
 
 bool CryptoKey::verifyData(const QByteArray &msg, QByteArray signatureBytes) const
 {
-    // load signature from buffer
-    std::unique_ptr<tego_ed25519_signature_t> signature;
-    tego_ed25519_signature_from_bytes(
-        tego::out(signature),
-        reinterpret_cast<const uint8_t*>(signatureBytes.data()),
-        static_cast<size_t>(signatureBytes.size()),
-        tego::throw_on_error());
+    TEGO_THROW_IF_FALSE(signatureBytes.size() == TEGO_ED25519_SIGNATURE_SIZE);
 
-    // verify it against msg and our public key
-    return tego_ed25519_signature_verify(
-        signature.get(),
+    uint8_t signature[TEGO_ED25519_SIGNATURE_SIZE];
+    std::copy(signatureBytes.begin(), signatureBytes.end(), signature);
+
+    return this->verifyData(
         reinterpret_cast<const uint8_t*>(msg.data()),
         static_cast<size_t>(msg.size()),
-        this->publicKey_.get(),
-        tego::throw_on_error());
+        signature);
+}
+
+bool CryptoKey::verifyData(const uint8_t* msg, size_t msgSize, const uint8_t (&signature)[TEGO_ED25519_SIGNATURE_SIZE]) const
+{
+    TEGO_THROW_IF_NULL(msg);
+    TEGO_THROW_IF_FALSE(msgSize > 0);
+    TEGO_THROW_IF_NULL(this->publicKey_);
+
+    // result will be 0 if valid, -1 if not
+    const auto result = ::ed25519_donna_open(
+        signature,
+        msg,
+        msgSize,
+        this->publicKey_->data);
+    TEGO_THROW_IF_FALSE(result == 0 || result == -1);
+
+    return result == 0;
 }
 
 /* Cryptographic hash of a password as expected by Tor's HashedControlPassword */
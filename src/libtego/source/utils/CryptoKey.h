@@ -53,12 +53,19 @@ public:
 
     // sign data with our private key
     QByteArray signData(const QByteArray &data) const;
+    // sign data with our private key into a caller provided buffer, does not allocate
+    void signData(const uint8_t* data, size_t dataSize, uint8_t (&out_signature)[TEGO_ED25519_SIGNATURE_SIZE]) const;
     // verify data signature against public key
     bool verifyData(const QByteArray &data, QByteArray signature) const;
+    // verify data signature against public key, does not allocate
+    bool verifyData(const uint8_t* data, size_t dataSize, const uint8_t (&signature)[TEGO_ED25519_SIGNATURE_SIZE]) const;
 
 private:
     std::shared_ptr<tego_ed25519_private_key_t> privateKey_;
-    std::shared_ptr<tego_ed25519_public_key_t> publicKey_;
+    // public keys loaded from service ids are shared with the decoded key cache
+    std::shared_ptr<const tego_ed25519_public_key_t> publicKey_;
+    // computed once when the key is loaded
+    QByteArray serviceId_;
 };
 
 QByteArray torControlHashedPassword(const QByteArray &password);
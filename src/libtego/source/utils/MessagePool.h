@@ -0,0 +1,86 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MESSAGEPOOL_H
+#define MESSAGEPOOL_H
+
+/* Recycles protobuf messages of type T
+ *
+ * Parsing into a fresh message allocates the message and each of its
+ * submessages and strings; Clear() keeps those allocations around, so a
+ * message that goes back to the pool parses the next packet of the same
+ * shape without touching the heap. Acquired messages return to the pool when
+ * their handle goes out of scope, and the pool holds at most MaxPooled idle
+ * messages per type. Main thread only. */
+template<typename T> class MessagePool
+{
+public:
+    static constexpr size_t MaxPooled = 16;
+
+    struct Releaser
+    {
+        void operator()(T *message) const { MessagePool<T>::release(message); }
+    };
+    using Handle = std::unique_ptr<T, Releaser>;
+
+    static Handle acquire()
+    {
+        auto &pool = idle();
+        if (pool.empty())
+            return Handle(new T);
+
+        T *message = pool.back().release();
+        pool.pop_back();
+        return Handle(message);
+    }
+
+private:
+    static std::vector<std::unique_ptr<T>> &idle()
+    {
+        static std::vector<std::unique_ptr<T>> pool;
+        return pool;
+    }
+
+    static void release(T *message)
+    {
+        auto &pool = idle();
+        if (pool.size() >= MaxPooled) {
+            delete message;
+            return;
+        }
+
+        message->Clear();
+        pool.emplace_back(message);
+    }
+};
+
+#endif // MESSAGEPOOL_H
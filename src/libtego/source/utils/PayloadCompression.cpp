@@ -0,0 +1,78 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "PayloadCompression.h"
+
+QByteArray PayloadCompression::compress(const char *data, int size)
+{
+    if (size < MinSize)
+        return QByteArray();
+
+    uLongf compressedSize = compressBound(static_cast<uLong>(size));
+    QByteArray payload(HeaderSize + static_cast<int>(compressedSize), Qt::Uninitialized);
+    qToBigEndian(static_cast<quint32>(size), payload.data());
+
+    if (compress2(reinterpret_cast<Bytef*>(payload.data() + HeaderSize), &compressedSize,
+                  reinterpret_cast<const Bytef*>(data), static_cast<uLong>(size),
+                  Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return QByteArray();
+    }
+
+    const int payloadSize = HeaderSize + static_cast<int>(compressedSize);
+    if (payloadSize > size - size / 8)
+        return QByteArray();
+
+    payload.truncate(payloadSize);
+    return payload;
+}
+
+QByteArray PayloadCompression::uncompress(const char *data, int size, int maxSize)
+{
+    if (size <= HeaderSize)
+        return QByteArray();
+
+    const quint32 expectedSize = qFromBigEndian<quint32>(data);
+    if (expectedSize == 0 || expectedSize > static_cast<quint32>(maxSize))
+        return QByteArray();
+
+    // zlib stops with Z_BUF_ERROR rather than write past the buffer, so a
+    // stream that inflates past its size prefix can't grow it
+    QByteArray result(static_cast<int>(expectedSize), Qt::Uninitialized);
+    uLongf resultSize = expectedSize;
+    if (::uncompress(reinterpret_cast<Bytef*>(result.data()), &resultSize,
+                     reinterpret_cast<const Bytef*>(data + HeaderSize), static_cast<uLong>(size - HeaderSize)) != Z_OK ||
+        resultSize != expectedSize) {
+        return QByteArray();
+    }
+
+    return result;
+}
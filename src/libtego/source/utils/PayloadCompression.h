@@ -0,0 +1,57 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PAYLOADCOMPRESSION_H
+#define PAYLOADCOMPRESSION_H
+
+/* zlib compression of chat text and file chunks
+ *
+ * A compressed payload is the size of the original data as a big-endian
+ * uint32 followed by a zlib (RFC 1950) stream, the same layout qCompress
+ * produces. Payloads are only compressed when that pays for itself, and
+ * uncompressing never allocates more than the caller's limit, whatever the
+ * size prefix or the stream claim. */
+namespace PayloadCompression
+{
+    constexpr int HeaderSize = sizeof(quint32);
+    // smaller payloads save too little to be worth the cpu
+    constexpr int MinSize = 128;
+
+    // the compressed payload, or a null QByteArray if it wouldn't save at
+    // least an eighth of size, in which case the data should be sent as is
+    QByteArray compress(const char *data, int size);
+    // the original data, or a null QByteArray if the payload is malformed or
+    // holds more than maxSize bytes
+    QByteArray uncompress(const char *data, int size, int maxSize);
+}
+
+#endif // PAYLOADCOMPRESSION_H
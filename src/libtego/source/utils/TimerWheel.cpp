@@ -0,0 +1,252 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TimerWheel.h"
+
+// the wheel lives on the main thread, as do all of its timers
+static TimerWheel *s_wheel = nullptr;
+
+WheelTimer::WheelTimer(std::function<void()> callback)
+    : m_prev(nullptr)
+    , m_next(nullptr)
+    , m_expiry(0)
+    , m_interval(0)
+    , m_callback(std::move(callback))
+{
+}
+
+WheelTimer::~WheelTimer()
+{
+    stop();
+}
+
+void WheelTimer::start()
+{
+    start(m_interval);
+}
+
+void WheelTimer::start(int msec)
+{
+    m_interval = msec;
+    TimerWheel::instance()->add(this, msec);
+}
+
+void WheelTimer::stop()
+{
+    if (!isActive())
+        return;
+
+    if (s_wheel)
+        s_wheel->remove(this);
+    else
+        unlink();
+}
+
+void WheelTimer::unlink()
+{
+    m_prev->m_next = m_next;
+    m_next->m_prev = m_prev;
+    m_prev = nullptr;
+    m_next = nullptr;
+}
+
+TimerWheel *TimerWheel::instance()
+{
+    if (!s_wheel)
+        s_wheel = new TimerWheel(qApp);
+    return s_wheel;
+}
+
+TimerWheel::TimerWheel(QObject *parent)
+    : QObject(parent)
+    , m_clockOffset(0)
+    , m_currentTick(0)
+    , m_wakeTick(0)
+    , m_active(0)
+{
+    for (auto &level : m_slots) {
+        for (auto &head : level) {
+            head.m_prev = &head;
+            head.m_next = &head;
+        }
+    }
+
+    m_ticker.setTimerType(Qt::CoarseTimer);
+    m_ticker.setSingleShot(true);
+    connect(&m_ticker, &QTimer::timeout, this, &TimerWheel::processTicks);
+    m_clock.start();
+}
+
+TimerWheel::~TimerWheel()
+{
+    // timers outliving the wheel just never fire
+    for (auto &level : m_slots) {
+        for (auto &head : level) {
+            while (head.m_next != &head)
+                head.m_next->unlink();
+            head.m_prev = nullptr;
+            head.m_next = nullptr;
+        }
+    }
+
+    if (s_wheel == this)
+        s_wheel = nullptr;
+}
+
+void TimerWheel::add(WheelTimer *timer, int msec)
+{
+    if (timer->isActive())
+        remove(timer);
+
+    // while idle the wheel doesn't advance, so catch up with the clock first;
+    // no timers are armed, so nothing needs cascading
+    const quint64 elapsed = static_cast<quint64>(now());
+    if (m_active == 0)
+        m_currentTick = elapsed / TickMs;
+
+    // round up so the timer never fires early
+    quint64 expiry = (elapsed + static_cast<quint64>(qMax(msec, 0)) + TickMs - 1) / TickMs;
+    if (expiry <= m_currentTick)
+        expiry = m_currentTick + 1;
+    else if (expiry - m_currentTick > MaxTicks)
+        expiry = m_currentTick + MaxTicks;
+
+    timer->m_expiry = expiry;
+    const quint64 due = insert(timer);
+    ++m_active;
+
+    if (!m_ticker.isActive() || due < m_wakeTick)
+        scheduleWakeup(due);
+}
+
+void TimerWheel::remove(WheelTimer *timer)
+{
+    timer->unlink();
+    if (--m_active == 0)
+        m_ticker.stop();
+}
+
+quint64 TimerWheel::insert(WheelTimer *timer)
+{
+    // the finest level whose span covers the remaining time
+    const quint64 delta = timer->m_expiry - m_currentTick;
+    int level = 0;
+    while (level < Levels - 1 && delta >= (quint64(1) << (SlotBits * (level + 1))))
+        ++level;
+
+    WheelTimer &head = m_slots[level][(timer->m_expiry >> (SlotBits * level)) & (Slots - 1)];
+    timer->m_prev = head.m_prev;
+    timer->m_next = &head;
+    head.m_prev->m_next = timer;
+    head.m_prev = timer;
+
+    // slots above level 0 are due when they cascade, at the start of their span
+    const int shift = SlotBits * level;
+    return (timer->m_expiry >> shift) << shift;
+}
+
+void TimerWheel::cascade(int level)
+{
+    // everything in this slot now expires within the span of a finer level
+    WheelTimer &head = m_slots[level][(m_currentTick >> (SlotBits * level)) & (Slots - 1)];
+    while (head.m_next != &head) {
+        WheelTimer *timer = head.m_next;
+        timer->unlink();
+        insert(timer);
+    }
+}
+
+void TimerWheel::advance()
+{
+    ++m_currentTick;
+    for (int level = 1; level < Levels; level++) {
+        if ((m_currentTick & ((quint64(1) << (SlotBits * level)) - 1)) != 0)
+            break;
+        cascade(level);
+    }
+
+    WheelTimer &head = m_slots[0][m_currentTick & (Slots - 1)];
+    while (head.m_next != &head) {
+        WheelTimer *timer = head.m_next;
+        remove(timer);
+        // the callback may destroy the timer along with its owner
+        const auto callback = timer->m_callback;
+        if (callback)
+            callback();
+    }
+}
+
+quint64 TimerWheel::nextEventTick() const
+{
+    // the first occupied slot after the current one on each level; a level's
+    // slots are at most a full turn ahead, so the last one checked is the
+    // current slot again, holding timers due on the next turn
+    quint64 next = std::numeric_limits<quint64>::max();
+    for (int level = 0; level < Levels; level++) {
+        const int shift = SlotBits * level;
+        const quint64 base = m_currentTick >> shift;
+        for (quint64 offset = 1; offset <= Slots; offset++) {
+            const WheelTimer &head = m_slots[level][(base + offset) & (Slots - 1)];
+            if (head.m_next != &head) {
+                next = qMin(next, (base + offset) << shift);
+                break;
+            }
+        }
+    }
+    return next;
+}
+
+void TimerWheel::scheduleWakeup(quint64 tick)
+{
+    // waking early is harmless, so very distant ticks are just clamped
+    const qint64 delay = static_cast<qint64>(tick * TickMs) - now();
+    m_wakeTick = tick;
+    m_ticker.start(static_cast<int>(qBound<qint64>(0, delay, std::numeric_limits<int>::max())));
+}
+
+void TimerWheel::processTicks()
+{
+    // a late or coalesced wakeup handles every event that has passed, jumping
+    // straight over the ticks in between since they have nothing to do
+    const quint64 target = static_cast<quint64>(now()) / TickMs;
+    while (m_active > 0) {
+        const quint64 next = nextEventTick();
+        if (next > target)
+            break;
+        m_currentTick = next - 1;
+        advance();
+    }
+    m_currentTick = qMax(m_currentTick, target);
+
+    if (m_active > 0)
+        scheduleWakeup(nextEventTick());
+}
@@ -0,0 +1,135 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+class TimerWheel;
+
+/* A single shot timeout driven by the shared TimerWheel
+ *
+ * Meant to be embedded as a member of the object it times out, in place of
+ * a QTimer: starting and stopping never allocate and stopping is O(1), and
+ * the owner going away stops the timer. Expiry is rounded up to the wheel's
+ * tick, so this is for timeouts and retries, not for precise scheduling.
+ *
+ * The callback runs on the main thread after the timer has been disarmed,
+ * so it may restart the timer or destroy its owner. */
+class WheelTimer
+{
+    Q_DISABLE_COPY(WheelTimer)
+
+public:
+    explicit WheelTimer(std::function<void()> callback = std::function<void()>());
+    ~WheelTimer();
+
+    void setCallback(std::function<void()> callback) { m_callback = std::move(callback); }
+    void setInterval(int msec) { m_interval = msec; }
+    int interval() const { return m_interval; }
+
+    /* (Re)arm the timer to fire once after interval() or msec milliseconds */
+    void start();
+    void start(int msec);
+    void stop();
+    bool isActive() const { return m_next != 0; }
+
+private:
+    friend class TimerWheel;
+
+    // intrusive links into a wheel slot; both null while inactive
+    WheelTimer *m_prev;
+    WheelTimer *m_next;
+    quint64 m_expiry;
+    int m_interval;
+    std::function<void()> m_callback;
+
+    void unlink();
+};
+
+/* Hierarchical timing wheel shared by all protocol and tor timeouts
+ *
+ * Timers are bucketed by expiry tick into Levels wheels of Slots slots each;
+ * level n slots span Slots^n ticks, and as time advances the slots of the
+ * higher levels are cascaded down into finer ones. Arming a timer is O(1),
+ * as is cancelling one, and expiry does work proportional to the timers
+ * that expire. A single coarse QTimer drives the wheel. It is armed only
+ * for the next tick at which a timer expires or a slot cascades, and skipped
+ * ticks cost nothing, so an idle wheel never wakes the thread and one holding
+ * only long timeouts wakes a few times a minute at most. */
+class TimerWheel : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(TimerWheel)
+
+public:
+    static constexpr int TickMs = 250;
+    static constexpr int SlotBits = 6;
+    static constexpr int Slots = 1 << SlotBits;
+    static constexpr int Levels = 4;
+    // longer timeouts are clamped to this many ticks (about 48 days)
+    static constexpr quint64 MaxTicks = (quint64(1) << (SlotBits * Levels)) - 1;
+
+    static TimerWheel *instance();
+
+    explicit TimerWheel(QObject *parent = nullptr);
+    ~TimerWheel();
+
+    int activeTimers() const { return m_active; }
+
+private:
+    friend class WheelTimer;
+    // moves the clock forward in tests
+    friend struct TimerWheelTest;
+
+    // sentinel heads of the circular slot lists
+    std::array<std::array<WheelTimer, Slots>, Levels> m_slots;
+    QTimer m_ticker;
+    QElapsedTimer m_clock;
+    qint64 m_clockOffset;
+    quint64 m_currentTick;
+    // tick m_ticker is armed for
+    quint64 m_wakeTick;
+    int m_active;
+
+    qint64 now() const { return m_clock.elapsed() + m_clockOffset; }
+    void add(WheelTimer *timer, int msec);
+    void remove(WheelTimer *timer);
+    // returns the tick at which the timer is next due to expire or cascade
+    quint64 insert(WheelTimer *timer);
+    void cascade(int level);
+    void advance();
+    quint64 nextEventTick() const;
+    void scheduleWakeup(quint64 tick);
+    void processTicks();
+};
+
+#endif // TIMERWHEEL_H
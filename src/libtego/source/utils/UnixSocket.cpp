@@ -0,0 +1,115 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "UnixSocket.h"
+
+int unixSocketMaxPathLength()
+{
+#ifdef Q_OS_UNIX
+    return static_cast<int>(sizeof(sockaddr_un::sun_path));
+#else
+    return 0;
+#endif
+}
+
+qintptr connectUnixSocket(const QString &path, QString *errorMessage)
+{
+#ifdef Q_OS_UNIX
+    const QByteArray encodedPath = QFile::encodeName(path);
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (encodedPath.isEmpty() || encodedPath.size() >= unixSocketMaxPathLength()) {
+        *errorMessage = QStringLiteral("Invalid socket path: %1").arg(path);
+        return -1;
+    }
+    memcpy(address.sun_path, encodedPath.constData(), static_cast<size_t>(encodedPath.size()));
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        *errorMessage = QString::fromLocal8Bit(strerror(errno));
+        return -1;
+    }
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        *errorMessage = QStringLiteral("%1: %2").arg(path, QString::fromLocal8Bit(strerror(errno)));
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+#else
+    *errorMessage = QStringLiteral("Unix domain sockets are not supported on this platform: %1").arg(path);
+    return -1;
+#endif
+}
+
+void closeUnixSocket(qintptr fd)
+{
+#ifdef Q_OS_UNIX
+    ::close(static_cast<int>(fd));
+#else
+    Q_UNUSED(fd);
+#endif
+}
+
+UnixSocketServer::UnixSocketServer(QObject *parent)
+    : QLocalServer(parent)
+{
+}
+
+bool UnixSocketServer::hasPendingConnections() const
+{
+    return !m_pendingSockets.isEmpty();
+}
+
+QTcpSocket *UnixSocketServer::nextPendingSocket()
+{
+    if (m_pendingSockets.isEmpty())
+        return 0;
+    return m_pendingSockets.dequeue();
+}
+
+void UnixSocketServer::incomingConnection(quintptr socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    if (!socket->setSocketDescriptor(static_cast<qintptr>(socketDescriptor), QAbstractSocket::ConnectedState)) {
+        qWarning() << "Failed to adopt incoming local connection:" << socket->errorString();
+        delete socket;
+        closeUnixSocket(static_cast<qintptr>(socketDescriptor));
+        return;
+    }
+    m_pendingSockets.enqueue(socket);
+    emit newConnection();
+}
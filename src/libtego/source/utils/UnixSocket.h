@@ -0,0 +1,71 @@
+/* Ricochet Refresh - https://ricochetrefresh.net/
+ * Copyright (C) 2021, Blueprint For Free Speech <ricochet@blueprintforfreespeech.net>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *
+ *    * Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following disclaimer
+ *      in the documentation and/or other materials provided with the
+ *      distribution.
+ *
+ *    * Neither the names of the copyright owners nor the names of its
+ *      contributors may be used to endorse or promote products derived from
+ *      this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef UNIXSOCKET_H
+#define UNIXSOCKET_H
+
+/* AF_UNIX stream sockets presented through the QTcpSocket API, so that the
+ * tor control connection and peer connections work over local sockets
+ * without changes. QAbstractSocket only reads from and writes to the
+ * descriptor it is given, so it drives a unix domain socket just as well;
+ * only the address accessors are meaningless. Not available on Windows. */
+
+/* Longest usable socket path, including the terminating null */
+int unixSocketMaxPathLength();
+
+/* Connect a local stream socket to path, returning its descriptor, or -1
+ * after filling errorMessage. Local connects complete (or fail) at once. */
+qintptr connectUnixSocket(const QString &path, QString *errorMessage);
+/* Close a descriptor that could not be handed to a socket */
+void closeUnixSocket(qintptr fd);
+
+/* Listens on a unix domain socket, handing out accepted connections as
+ * connected QTcpSockets parented to the server */
+class UnixSocketServer : public QLocalServer
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(UnixSocketServer)
+
+public:
+    explicit UnixSocketServer(QObject *parent = 0);
+
+    virtual bool hasPendingConnections() const;
+    QTcpSocket *nextPendingSocket();
+
+protected:
+    virtual void incomingConnection(quintptr socketDescriptor);
+
+private:
+    QQueue<QTcpSocket*> m_pendingSockets;
+};
+
+#endif // UNIXSOCKET_H
@@ -0,0 +1,132 @@
+#include <catch2/catch.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "protocol/Connection.h"
+#include "utils/TimerWheel.h"
+
+// These tests replace the global operator new, which affects every test
+// linked into the same binary; that is why they are built on their own as
+// libtego_allocation_tests. Allocations are only counted while a
+// CountAllocations is in scope.
+namespace
+{
+    std::atomic<bool> counting{false};
+    std::atomic<size_t> allocations{0};
+
+    struct CountAllocations
+    {
+        CountAllocations()
+        {
+            allocations = 0;
+            counting = true;
+        }
+
+        ~CountAllocations()
+        {
+            counting = false;
+        }
+
+        size_t count() const { return allocations; }
+    };
+
+    // run the event loop until done() or a timeout
+    void waitFor(const std::function<bool()> &done)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (!done() && timer.elapsed() < 5000)
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        REQUIRE(done());
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    if (counting)
+        ++allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+TEST_CASE(  "TimerWheel arms and cancels timers without allocating",
+            "[internal][allocations][timerwheel]")
+{
+    auto wheel = TimerWheel::instance();
+    int fired = 0;
+
+    // a nearer timer keeps the wheel's wakeup where it is, so the ticker
+    // isn't rescheduled (which allocates inside Qt) as the others come and go
+    WheelTimer anchor([&fired]() { ++fired; });
+    anchor.start(1000);
+
+    // callbacks capturing a pointer or two fit in std::function's own storage
+    std::vector<std::unique_ptr<WheelTimer>> timers;
+    for (int i = 0; i < 64; ++i)
+        timers.push_back(std::make_unique<WheelTimer>([&fired]() { ++fired; }));
+
+    size_t allocated = 0;
+    {
+        CountAllocations count;
+        for (int round = 0; round < 100; ++round) {
+            for (size_t i = 0; i < timers.size(); ++i)
+                timers[i]->start(5000 + static_cast<int>(i) * 1000);
+            for (auto &timer : timers)
+                timer->stop();
+        }
+        allocated = count.count();
+    }
+
+    REQUIRE(allocated == 0);
+    REQUIRE(fired == 0);
+    anchor.stop();
+    REQUIRE(wheel->activeTimers() == 0);
+}
+
+TEST_CASE(  "Allocations per accepted connection",
+            "[.][benchmark][internal][allocations]")
+{
+    QTcpServer server;
+    REQUIRE(server.listen(QHostAddress::LocalHost, 0));
+
+    const int rounds = 100;
+    size_t accepting = 0;
+    size_t destroying = 0;
+    for (int i = 0; i < rounds; ++i) {
+        QTcpSocket client;
+        client.connectToHost(server.serverAddress(), server.serverPort());
+        waitFor([&]() { return server.hasPendingConnections() && client.state() == QAbstractSocket::ConnectedState; });
+
+        // as UserIdentity::onIncomingConnection does for every socket tor
+        // hands us
+        Protocol::Connection *connection = nullptr;
+        {
+            CountAllocations count;
+            QTcpSocket *socket = server.nextPendingConnection();
+            socket->setProperty("localHostname", QStringLiteral("test.onion"));
+            connection = new Protocol::Connection(socket, Protocol::Connection::ServerSide);
+            accepting += count.count();
+        }
+
+        {
+            CountAllocations count;
+            delete connection;
+            destroying += count.count();
+        }
+    }
+
+    WARN("allocations per accepted connection: " << (accepting / rounds) << " accepting it, "
+         << (destroying / rounds) << " destroying it");
+}
@@ -0,0 +1,171 @@
+#include <catch2/catch.hpp>
+
+#include "protocol/AuthProofVerifier.h"
+#include "utils/CryptoKey.h"
+
+using Protocol::AuthProofVerifier;
+
+namespace
+{
+    const QByteArray testKeyBlob("ED25519-V3:CHmhWtOje0mMYO7GKFWLKdKau+hu2TmXXqZtHONwZnOSW3rHzBFZre/uoFydP4bUWWe/l6Z37PoWrdwbx3682w==");
+
+    struct SignedProof
+    {
+        QByteArray serviceId;
+        QByteArray message;
+        QByteArray signature;
+    };
+
+    SignedProof makeProof()
+    {
+        CryptoKey key;
+        REQUIRE(key.loadFromKeyBlob(testKeyBlob));
+
+        SignedProof proof;
+        proof.serviceId = key.torServiceID();
+        proof.message = QByteArray(64, 'x');
+        proof.signature = key.signData(proof.message);
+        return proof;
+    }
+
+    // run the event loop until the verifier has delivered count results
+    void waitForResults(const int &results, int count)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (results < count && timer.elapsed() < 5000)
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        REQUIRE(results == count);
+    }
+}
+
+TEST_CASE(  "AuthProofVerifier accepts a valid proof and rejects a forged one",
+            "[internal][authproof]")
+{
+    const auto proof = makeProof();
+    AuthProofVerifier verifier;
+    QObject connection;
+
+    int results = 0;
+    bool valid = false;
+    bool forgedValid = true;
+    REQUIRE(verifier.verify(proof.serviceId, false, proof.message, proof.signature, &connection,
+        [&](bool v) { valid = v; ++results; }));
+
+    QByteArray forged = proof.signature;
+    forged[0] = static_cast<char>(forged[0] ^ 0x01);
+    REQUIRE(verifier.verify(proof.serviceId, false, proof.message, forged, &connection,
+        [&](bool v) { forgedValid = v; ++results; }));
+
+    waitForResults(results, 2);
+    REQUIRE(valid);
+    REQUIRE_FALSE(forgedValid);
+    REQUIRE(verifier.statistics().verified == 2);
+}
+
+TEST_CASE(  "AuthProofVerifier caps verifications of unknown ids",
+            "[internal][authproof]")
+{
+    const auto proof = makeProof();
+    AuthProofVerifier verifier;
+    QObject connection;
+
+    int results = 0;
+    int accepted = 0;
+    auto count = [&](bool) { ++results; };
+
+    for (int i = 0; i < AuthProofVerifier::UnknownRateLimitBurst * 2; ++i) {
+        if (verifier.verify(proof.serviceId, false, proof.message, proof.signature, &connection, count))
+            ++accepted;
+    }
+
+    REQUIRE(accepted <= AuthProofVerifier::UnknownRateLimitBurst);
+    REQUIRE(accepted <= AuthProofVerifier::MaxPending);
+    waitForResults(results, accepted);
+}
+
+TEST_CASE(  "AuthProofVerifier keeps a budget for contacts that a flood can't use",
+            "[internal][authproof]")
+{
+    const auto proof = makeProof();
+    AuthProofVerifier verifier;
+    QObject connection;
+
+    int results = 0;
+    int accepted = 0;
+    auto count = [&](bool) { ++results; };
+
+    // a flood of connections claiming unknown ids, until it is refused
+    while (verifier.verify(proof.serviceId, false, proof.message, proof.signature, &connection, count))
+        ++accepted;
+    REQUIRE_FALSE(verifier.verify(proof.serviceId, false, proof.message, proof.signature, &connection, count));
+
+    // still leaves room for a contact
+    bool valid = false;
+    REQUIRE(verifier.verify(proof.serviceId, true, proof.message, proof.signature, &connection,
+        [&](bool v) { valid = v; ++results; }));
+
+    waitForResults(results, accepted + 1);
+    REQUIRE(valid);
+}
+
+TEST_CASE(  "AuthProofVerifier rate limits each contact separately",
+            "[internal][authproof]")
+{
+    const auto proof = makeProof();
+    const QByteArray otherServiceId(proof.serviceId.size(), 'a');
+    AuthProofVerifier verifier;
+    QObject connection;
+
+    int results = 0;
+    auto count = [&](bool) { ++results; };
+
+    // connections claiming a contact's id can use up that contact's bucket
+    for (int i = 0; i < AuthProofVerifier::ContactRateLimitBurst; ++i)
+        REQUIRE(verifier.verify(otherServiceId, true, proof.message, proof.signature, &connection, count));
+    REQUIRE_FALSE(verifier.verify(otherServiceId, true, proof.message, proof.signature, &connection, count));
+    REQUIRE(verifier.statistics().rejectedRateLimited == 1);
+
+    // but not any other contact's
+    bool valid = false;
+    REQUIRE(verifier.verify(proof.serviceId, true, proof.message, proof.signature, &connection,
+        [&](bool v) { valid = v; ++results; }));
+
+    waitForResults(results, AuthProofVerifier::ContactRateLimitBurst + 1);
+    REQUIRE(valid);
+}
+
+TEST_CASE(  "AuthProofVerifier throughput",
+            "[.][benchmark][internal][authproof]")
+{
+    const auto proof = makeProof();
+
+    BENCHMARK("decode service id and verify signature") {
+        CryptoKey key;
+        return key.loadFromServiceId(proof.serviceId) && key.verifyData(proof.message, proof.signature);
+    };
+
+    // submission through the pool and delivery back to this thread, with
+    // proofs claiming unknown ids so that the shared limit applies
+    AuthProofVerifier verifier;
+    QObject connection;
+    int results = 0;
+    int accepted = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 2000) {
+        if (verifier.verify(proof.serviceId, false, proof.message, proof.signature, &connection,
+                            [&](bool) { ++results; }))
+            ++accepted;
+        QCoreApplication::processEvents();
+        QThread::msleep(1);
+    }
+    waitForResults(results, accepted);
+
+    const auto &stats = verifier.statistics();
+    WARN("verified " << stats.verified << " proofs in 2s at ~1000 attempts/s, refused " << stats.rejectedRateLimited
+         << " rate limited and " << stats.rejectedQueueFull << " queue full; mean latency "
+         << (stats.verified ? stats.totalLatencyUs / static_cast<qint64>(stats.verified) : 0)
+         << "us, max " << stats.maxLatencyUs << "us");
+}
@@ -0,0 +1,204 @@
+#include <catch2/catch.hpp>
+#include <QTemporaryDir>
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+#include "core/MessageOutbox.h"
+
+using Entry = MessageOutbox::Entry;
+
+static Entry makeEntry(MessageOutbox::MessageId id, const QString &text)
+{
+    return Entry{id, QDateTime::fromMSecsSinceEpoch(1600000000000 + id), text};
+}
+
+static std::vector<MessageOutbox::MessageId> idsOf(const QList<Entry> &entries)
+{
+    std::vector<MessageOutbox::MessageId> ids;
+    for (const Entry &entry : entries)
+        ids.push_back(entry.id);
+    return ids;
+}
+
+TEST_CASE(  "MessageOutbox reloads live messages in the order they were queued",
+            "[internal][outbox]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("contact.outbox"));
+
+    {
+        MessageOutbox outbox(path);
+        REQUIRE(outbox.load().isEmpty());
+        outbox.append(makeEntry(5, QStringLiteral("first")));
+        outbox.append(makeEntry(3, QStringLiteral("second")));
+        outbox.append(makeEntry(9, QStringLiteral("third")));
+        outbox.remove(3);
+        // queuing an id again moves it to the end
+        outbox.append(makeEntry(5, QStringLiteral("fourth")));
+        // unknown ids are ignored
+        outbox.remove(42);
+    }
+
+    MessageOutbox outbox(path);
+    const auto entries = outbox.load();
+    REQUIRE(idsOf(entries) == std::vector<MessageOutbox::MessageId>{ 9, 5 });
+    REQUIRE(entries[0].text == QStringLiteral("third"));
+    REQUIRE(entries[0].time == makeEntry(9, {}).time);
+    REQUIRE(entries[1].text == QStringLiteral("fourth"));
+
+#ifdef Q_OS_UNIX
+    const QFileDevice::Permissions userBits = QFileDevice::ReadUser | QFileDevice::WriteUser | QFileDevice::ExeUser;
+    REQUIRE((QFile::permissions(path) & ~userBits) == (QFileDevice::ReadOwner | QFileDevice::WriteOwner));
+#endif
+}
+
+TEST_CASE(  "MessageOutbox drops a record torn by a crash mid-write",
+            "[internal][outbox]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("contact.outbox"));
+
+    {
+        MessageOutbox outbox(path);
+        outbox.load();
+        outbox.append(makeEntry(1, QStringLiteral("kept")));
+        outbox.append(makeEntry(2, QStringLiteral("torn")));
+    }
+
+    // cut the last record short
+    qint64 tornSize = 0;
+    {
+        QFile file(path);
+        REQUIRE(file.open(QIODevice::ReadWrite));
+        tornSize = file.size() - 3;
+        REQUIRE(file.resize(tornSize));
+    }
+
+    {
+        MessageOutbox outbox(path);
+        REQUIRE(idsOf(outbox.load()) == std::vector<MessageOutbox::MessageId>{ 1 });
+        REQUIRE(QFileInfo(path).size() < tornSize);
+
+        // new records follow on from the last complete one
+        outbox.append(makeEntry(3, QStringLiteral("after")));
+    }
+
+    MessageOutbox outbox(path);
+    const auto entries = outbox.load();
+    REQUIRE(idsOf(entries) == std::vector<MessageOutbox::MessageId>{ 1, 3 });
+    REQUIRE(entries[1].text == QStringLiteral("after"));
+}
+
+#ifdef Q_OS_UNIX
+// lowers the file size limit for its lifetime, so writes past it come up short
+struct FileSizeLimit
+{
+    explicit FileSizeLimit(qint64 size)
+    {
+        previousHandler = std::signal(SIGXFSZ, SIG_IGN);
+        ::getrlimit(RLIMIT_FSIZE, &previous);
+        rlimit limited = previous;
+        limited.rlim_cur = static_cast<rlim_t>(size);
+        ::setrlimit(RLIMIT_FSIZE, &limited);
+    }
+
+    ~FileSizeLimit()
+    {
+        ::setrlimit(RLIMIT_FSIZE, &previous);
+        std::signal(SIGXFSZ, previousHandler);
+    }
+
+    rlimit previous;
+    void (*previousHandler)(int);
+};
+
+TEST_CASE(  "MessageOutbox cuts off a record torn by a failed write",
+            "[internal][outbox]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("contact.outbox"));
+
+    {
+        MessageOutbox outbox(path);
+        outbox.load();
+        outbox.append(makeEntry(1, QStringLiteral("before")));
+        const qint64 size = QFileInfo(path).size();
+
+        {
+            FileSizeLimit limit(size + 8);
+            outbox.append(makeEntry(2, QString(64, QLatin1Char('x'))));
+        }
+        REQUIRE(QFileInfo(path).size() == size);
+
+        outbox.append(makeEntry(3, QStringLiteral("after")));
+    }
+
+    MessageOutbox outbox(path);
+    REQUIRE(idsOf(outbox.load()) == std::vector<MessageOutbox::MessageId>{ 1, 3 });
+}
+#endif
+
+TEST_CASE(  "MessageOutbox compacts a log of mostly done messages",
+            "[internal][outbox]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("contact.outbox"));
+    const QString text(1024, QLatin1Char('x'));
+    const MessageOutbox::MessageId count = 100;
+
+    {
+        MessageOutbox outbox(path);
+        outbox.load();
+        for (MessageOutbox::MessageId i = 1; i <= count; ++i)
+            outbox.append(makeEntry(i, text));
+        const qint64 fullSize = QFileInfo(path).size();
+        REQUIRE(fullSize >= MessageOutbox::CompactMinBytes);
+
+        // the oldest go first, as they'd be acknowledged
+        for (MessageOutbox::MessageId i = 1; i <= 80; ++i)
+            outbox.remove(i);
+        // rewritten once half of it was dead, later done records still follow
+        REQUIRE(QFileInfo(path).size() < fullSize * 2 / 3);
+
+        // the compacted log is still appended to
+        outbox.append(makeEntry(count + 1, QStringLiteral("after")));
+    }
+
+#ifdef Q_OS_UNIX
+    const QFileDevice::Permissions userBits = QFileDevice::ReadUser | QFileDevice::WriteUser | QFileDevice::ExeUser;
+    REQUIRE((QFile::permissions(path) & ~userBits) == (QFileDevice::ReadOwner | QFileDevice::WriteOwner));
+#endif
+
+    std::vector<MessageOutbox::MessageId> expected;
+    for (MessageOutbox::MessageId i = 81; i <= count + 1; ++i)
+        expected.push_back(i);
+
+    MessageOutbox outbox(path);
+    const auto entries = outbox.load();
+    REQUIRE(idsOf(entries) == expected);
+    REQUIRE(entries.first().text == text);
+    REQUIRE(entries.last().text == QStringLiteral("after"));
+}
+
+TEST_CASE(  "MessageOutbox truncates the log once nothing is left in it",
+            "[internal][outbox]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("contact.outbox"));
+
+    MessageOutbox outbox(path);
+    outbox.load();
+    const qint64 emptySize = QFileInfo(path).size();
+    outbox.append(makeEntry(1, QStringLiteral("one")));
+    outbox.append(makeEntry(2, QStringLiteral("two")));
+    outbox.remove(2);
+    outbox.remove(1);
+    REQUIRE(QFileInfo(path).size() == emptySize);
+}
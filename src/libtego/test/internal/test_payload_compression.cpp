@@ -0,0 +1,120 @@
+#include <catch2/catch.hpp>
+
+#include "utils/PayloadCompression.h"
+
+static QByteArray compressibleText(int size)
+{
+    const QByteArray line("the quick brown fox jumps over the lazy dog\n");
+    QByteArray text;
+    while (text.size() < size)
+        text.append(line);
+    text.truncate(size);
+    return text;
+}
+
+static QByteArray compressPayload(const QByteArray &data)
+{
+    return PayloadCompression::compress(data.constData(), data.size());
+}
+
+static QByteArray uncompressPayload(const QByteArray &payload, int maxSize)
+{
+    return PayloadCompression::uncompress(payload.constData(), payload.size(), maxSize);
+}
+
+// the payload with its size prefix replaced
+static QByteArray withSizePrefix(QByteArray payload, quint32 size)
+{
+    qToBigEndian(size, payload.data());
+    return payload;
+}
+
+TEST_CASE(  "PayloadCompression round trips compressible data",
+            "[internal][compression]")
+{
+    const QByteArray text = compressibleText(4096);
+    const QByteArray payload = compressPayload(text);
+    REQUIRE_FALSE(payload.isNull());
+    REQUIRE(payload.size() <= text.size() - text.size() / 8);
+
+    REQUIRE(uncompressPayload(payload, text.size()) == text);
+    // the same layout as qCompress
+    REQUIRE(qUncompress(payload) == text);
+}
+
+TEST_CASE(  "PayloadCompression leaves small or incompressible data alone",
+            "[internal][compression]")
+{
+    REQUIRE(compressPayload(compressibleText(PayloadCompression::MinSize - 1)).isNull());
+
+    QByteArray noise(4096, Qt::Uninitialized);
+    quint32 state = 0x12345678;
+    for (char &c : noise) {
+        state = state * 1664525 + 1013904223;
+        c = static_cast<char>(state >> 24);
+    }
+    REQUIRE(compressPayload(noise).isNull());
+}
+
+TEST_CASE(  "PayloadCompression rejects a size prefix that lies",
+            "[internal][compression]")
+{
+    const QByteArray text = compressibleText(4096);
+    const QByteArray payload = compressPayload(text);
+    REQUIRE_FALSE(payload.isNull());
+    const int maxSize = 64 * 1024;
+
+    SECTION("larger than the stream")
+    {
+        REQUIRE(uncompressPayload(withSizePrefix(payload, 4097), maxSize).isNull());
+    }
+
+    SECTION("smaller than the stream")
+    {
+        REQUIRE(uncompressPayload(withSizePrefix(payload, 4095), maxSize).isNull());
+        REQUIRE(uncompressPayload(withSizePrefix(payload, 1), maxSize).isNull());
+    }
+
+    SECTION("zero")
+    {
+        REQUIRE(uncompressPayload(withSizePrefix(payload, 0), maxSize).isNull());
+    }
+
+    SECTION("far past the limit")
+    {
+        // refused before anything that size is allocated
+        REQUIRE(uncompressPayload(withSizePrefix(payload, 0xffffffff), maxSize).isNull());
+    }
+}
+
+TEST_CASE(  "PayloadCompression rejects a stream inflating past the limit",
+            "[internal][compression]")
+{
+    // a megabyte of zeros compresses to around a kilobyte
+    const QByteArray zeros(1024 * 1024, '\0');
+    const QByteArray payload = compressPayload(zeros);
+    REQUIRE_FALSE(payload.isNull());
+    REQUIRE(payload.size() < 4096);
+
+    REQUIRE(uncompressPayload(payload, 64 * 1024).isNull());
+    // nor can it be smuggled in under a size prefix within the limit
+    REQUIRE(uncompressPayload(withSizePrefix(payload, 64 * 1024), 64 * 1024).isNull());
+
+    REQUIRE(uncompressPayload(payload, zeros.size()) == zeros);
+}
+
+TEST_CASE(  "PayloadCompression rejects truncated and malformed payloads",
+            "[internal][compression]")
+{
+    const QByteArray text = compressibleText(4096);
+    const QByteArray payload = compressPayload(text);
+    REQUIRE_FALSE(payload.isNull());
+
+    REQUIRE(uncompressPayload(QByteArray(), text.size()).isNull());
+    REQUIRE(uncompressPayload(payload.left(PayloadCompression::HeaderSize), text.size()).isNull());
+    REQUIRE(uncompressPayload(payload.left(payload.size() - 1), text.size()).isNull());
+
+    QByteArray corrupt = payload;
+    corrupt[PayloadCompression::HeaderSize] = static_cast<char>(corrupt[PayloadCompression::HeaderSize] ^ 0xff);
+    REQUIRE(uncompressPayload(corrupt, text.size()).isNull());
+}
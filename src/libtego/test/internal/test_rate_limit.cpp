@@ -0,0 +1,46 @@
+#include <catch2/catch.hpp>
+
+#include "protocol/Connection_p.h"
+
+using RateLimit = Protocol::ConnectionPrivate::RateLimit;
+
+TEST_CASE(  "RateLimit allows a burst and then refuses",
+            "[internal][ratelimit]")
+{
+    RateLimit limit(3, 1000);
+
+    REQUIRE(limit.take(0));
+    REQUIRE(limit.take(0));
+    REQUIRE(limit.take(0));
+    REQUIRE_FALSE(limit.take(0));
+    REQUIRE_FALSE(limit.take(999));
+}
+
+TEST_CASE(  "RateLimit refills one token per interval",
+            "[internal][ratelimit]")
+{
+    RateLimit limit(3, 1000);
+    for (int i = 0; i < 3; ++i)
+        REQUIRE(limit.take(0));
+
+    REQUIRE(limit.take(1000));
+    REQUIRE_FALSE(limit.take(1000));
+
+    // the part of an interval already waited out is not lost
+    REQUIRE_FALSE(limit.take(1500));
+    REQUIRE(limit.take(2000));
+    REQUIRE_FALSE(limit.take(2000));
+}
+
+TEST_CASE(  "RateLimit never refills past its burst",
+            "[internal][ratelimit]")
+{
+    RateLimit limit(3, 1000);
+    REQUIRE(limit.take(0));
+
+    // a long quiet period only restores the burst
+    const qint64 later = 1000 * 1000;
+    for (int i = 0; i < 3; ++i)
+        REQUIRE(limit.take(later));
+    REQUIRE_FALSE(limit.take(later));
+}
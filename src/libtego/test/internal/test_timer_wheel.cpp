@@ -0,0 +1,98 @@
+#include <catch2/catch.hpp>
+
+#include "utils/TimerWheel.h"
+
+struct TimerWheelTest
+{
+    // move the wheel's clock forward and handle whatever came due
+    static void skip(TimerWheel &wheel, qint64 msec)
+    {
+        wheel.m_clockOffset += msec;
+        wheel.processTicks();
+    }
+
+    static qint64 now(const TimerWheel &wheel) { return wheel.now(); }
+    static bool tickerActive(const TimerWheel &wheel) { return wheel.m_ticker.isActive(); }
+    static int tickerRemaining(const TimerWheel &wheel) { return wheel.m_ticker.remainingTime(); }
+};
+
+TEST_CASE(  "TimerWheel fires timers in expiry order and never early",
+            "[internal][timerwheel]")
+{
+    auto wheel = TimerWheel::instance();
+    const int intervals[] = { 3000, 500, 1750, 1000 };
+
+    std::vector<int> fired;
+    std::vector<std::unique_ptr<WheelTimer>> timers;
+    for (int interval : intervals) {
+        const qint64 started = TimerWheelTest::now(*wheel);
+        timers.push_back(std::make_unique<WheelTimer>([&fired, wheel, interval, started]() {
+            const qint64 elapsed = TimerWheelTest::now(*wheel) - started;
+            REQUIRE(elapsed >= interval);
+            REQUIRE(elapsed < interval + 2 * TimerWheel::TickMs);
+            fired.push_back(interval);
+        }));
+        timers.back()->start(interval);
+    }
+    REQUIRE(wheel->activeTimers() == 4);
+
+    for (int i = 0; i < 16; ++i)
+        TimerWheelTest::skip(*wheel, TimerWheel::TickMs);
+
+    REQUIRE(fired == std::vector<int>{ 500, 1000, 1750, 3000 });
+    REQUIRE(wheel->activeTimers() == 0);
+    REQUIRE_FALSE(TimerWheelTest::tickerActive(*wheel));
+}
+
+TEST_CASE(  "TimerWheel cascades long timers down in order",
+            "[internal][timerwheel]")
+{
+    auto wheel = TimerWheel::instance();
+    // landing on levels 3, 2, 2 and 1 of the wheel
+    const int seconds[] = { 2 * 24 * 3600, 5 * 3600, 20 * 60, 20 };
+
+    std::vector<int> fired;
+    std::vector<std::unique_ptr<WheelTimer>> timers;
+    for (int s : seconds) {
+        timers.push_back(std::make_unique<WheelTimer>([&fired, s]() { fired.push_back(s); }));
+        timers.back()->start(s * 1000);
+    }
+
+    // a cancelled timer never fires
+    WheelTimer cancelled([&fired]() { fired.push_back(-1); });
+    cancelled.start(60 * 1000);
+    cancelled.stop();
+
+    // only long timers are armed, so the wheel doesn't wake every tick
+    REQUIRE(TimerWheelTest::tickerRemaining(*wheel) > TimerWheel::TickMs);
+
+    TimerWheelTest::skip(*wheel, 19 * 1000);
+    REQUIRE(fired.empty());
+    TimerWheelTest::skip(*wheel, 2 * 1000);
+    REQUIRE(fired == std::vector<int>{ 20 });
+
+    // one late wakeup handles everything that came due in order
+    TimerWheelTest::skip(*wheel, 3 * 24 * 3600 * 1000ll);
+    REQUIRE(fired == std::vector<int>{ 20, 20 * 60, 5 * 3600, 2 * 24 * 3600 });
+    REQUIRE(wheel->activeTimers() == 0);
+}
+
+TEST_CASE(  "TimerWheel timers can restart themselves from their callback",
+            "[internal][timerwheel]")
+{
+    auto wheel = TimerWheel::instance();
+
+    int fired = 0;
+    WheelTimer timer;
+    timer.setCallback([&]() {
+        if (++fired < 3)
+            timer.start(1000);
+    });
+    timer.start(1000);
+
+    for (int i = 0; i < 20; ++i)
+        TimerWheelTest::skip(*wheel, TimerWheel::TickMs);
+
+    REQUIRE(fired == 3);
+    REQUIRE_FALSE(timer.isActive());
+}
@@ -0,0 +1,48 @@
+#include <catch2/catch.hpp>
+#include <QTemporaryDir>
+
+#include "utils/UnixSocket.h"
+
+#ifdef Q_OS_UNIX
+
+TEST_CASE(  "UnixSocketServer announces and hands out accepted connections",
+            "[internal][unixsocket]")
+{
+    QTemporaryDir dir;
+    REQUIRE(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("test.sock"));
+
+    UnixSocketServer server;
+    REQUIRE(server.listen(path));
+
+    int announced = 0;
+    QTcpSocket *accepted = nullptr;
+    QObject::connect(&server, &QLocalServer::newConnection, [&]() {
+        ++announced;
+        accepted = server.nextPendingSocket();
+    });
+
+    QString errorMessage;
+    const qintptr fd = connectUnixSocket(path, &errorMessage);
+    REQUIRE(fd >= 0);
+    QTcpSocket client;
+    REQUIRE(client.setSocketDescriptor(fd, QAbstractSocket::ConnectedState));
+
+    QElapsedTimer timer;
+    timer.start();
+    while (announced == 0 && timer.elapsed() < 5000)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+
+    REQUIRE(announced == 1);
+    REQUIRE(accepted != nullptr);
+    REQUIRE(accepted->state() == QAbstractSocket::ConnectedState);
+    REQUIRE_FALSE(server.hasPendingConnections());
+
+    // and the accepted socket actually carries data
+    client.write("ping");
+    REQUIRE(client.waitForBytesWritten(5000));
+    REQUIRE(accepted->waitForReadyRead(5000));
+    REQUIRE(accepted->readAll() == QByteArray("ping"));
+}
+
+#endif
@@ -71,23 +71,11 @@ namespace shims
             case SectionRole: {
                 if (contact()->getStatus() == ContactUser::Online)
                     return QString();
-                if (index.row() < messages.size() - 1) {
-                    const MessageData &next = messages[index.row()+1];
-                    if (next.status != Received && next.status != Delivered)
-                        return QString();
-                }
-                for (int i = 0; i <= index.row(); i++) {
-                    if (messages[i].status == Received || messages[i].status == Delivered)
-                        return QString();
-                }
-                return QStringLiteral("offline");
-            }
-            case TimespanRole: {
-                if (index.row() < messages.size() - 1)
-                    return messages[index.row() + 1].time.secsTo(messages[index.row()].time);
-                else
-                    return -1;
+                if (index.row() == undeliveredRowCount - 1)
+                    return QStringLiteral("offline");
+                return QString();
             }
+            case TimespanRole: return message.timespan;
             case TypeRole: {
                 if (message.type == TextMessage) {
                     return QStringLiteral("text");
@@ -209,9 +197,7 @@ namespace shims
         md.identifier = messageId;
         md.status = Queued;
 
-        this->beginInsertRows(QModelIndex(), 0, 0);
-        this->messages.prepend(std::move(md));
-        this->endInsertRows();
+        this->prependMessage(std::move(md));
         this->addEventFromMessage(indexOfOutgoingMessage(messageId));
     }
 
@@ -260,9 +246,7 @@ namespace shims
                 md.transferStatus = Pending;
                 md.transferDirection = Uploading;
 
-                this->beginInsertRows(QModelIndex(), 0, 0);
-                this->messages.prepend(std::move(md));
-                this->endInsertRows();
+                this->prependMessage(std::move(md));
 
                 this->addEventFromMessage(indexOfOutgoingMessage(id));
             }
@@ -273,41 +257,49 @@ namespace shims
         }
     }
 
-    void ConversationModel::deserializeTextMessageEventToFile(const EventData &event, std::ofstream &ofile) const
+    void ConversationModel::serializeTextMessageEvent(const EventData &event, const QList<MessageData> &messages, const ExportStrings &strings, std::string &out)
     {
-        auto &md = this->messages[this->messages.size() - safe_cast<int>(event.messageData.reverseIndex)];
+        const auto reverseIndex = safe_cast<int>(event.messageData.reverseIndex);
+        if (reverseIndex > messages.size())
+            return;
+
+        auto &md = messages[messages.size() - reverseIndex];
         switch (md.status)
         {
             case Received:
-                fmt::print(ofile, "[{}] <{}>: {}\n",
+                fmt::format_to(std::back_inserter(out), "[{}] <{}>: {}\n",
                                     md.time.toString().toStdString(),
-                                    this->contact()->getNickname().toStdString(),
+                                    strings.nickname,
                                     md.text.toStdString()); break;
             case Delivered:
-                fmt::print(ofile, "[{}] <{}>: {}\n",
+                fmt::format_to(std::back_inserter(out), "[{}] <{}>: {}\n",
                                     md.time.toString().toStdString(),
-                                    tr("me").toStdString(),
+                                    strings.me,
                                     md.text.toStdString()); break;
             default:
                 // messages we sent that weren't delivered
-                fmt::print(ofile, "[{}] <{}> ({}): {}\n",
+                fmt::format_to(std::back_inserter(out), "[{}] <{}> ({}): {}\n",
                                     md.time.toString().toStdString(),
-                                    tr("me").toStdString(),
+                                    strings.me,
                                     getMessageStatusString(md.status),
                                     md.text.toStdString()); break;
         }
     }
 
-    void ConversationModel::deserializeTransferMessageEventToFile(const EventData &event, std::ofstream &ofile) const
+    void ConversationModel::serializeTransferMessageEvent(const EventData &event, const QList<MessageData> &messages, const ExportStrings &strings, std::string &out)
     {
-        auto &md = this->messages[this->messages.size() - safe_cast<int>(event.transferData.reverseIndex)];
+        const auto reverseIndex = safe_cast<int>(event.transferData.reverseIndex);
+        if (reverseIndex > messages.size())
+            return;
+
+        auto &md = messages[messages.size() - reverseIndex];
 
         if (md.transferDirection == InvalidDirection)
             return;
 
-        std::string sender = md.transferDirection == Uploading
-                                    ? tr("me").toStdString()
-                                    : this->contact()->getNickname().toStdString();
+        const std::string &sender = md.transferDirection == Uploading
+                                    ? strings.me
+                                    : strings.nickname;
 
         switch (event.transferData.status)
         {
@@ -316,7 +308,7 @@ namespace shims
             case Rejected:          //FALLTHROUGH
             case Cancelled:         //FALLTHROUGH
             case Finished:
-                fmt::print(ofile, "[{}] file '{}' from <{}> (hash: {}, size: {:L} bytes): {}\n",
+                fmt::format_to(std::back_inserter(out), "[{}] file '{}' from <{}> (hash: {}, size: {:L} bytes): {}\n",
                                     event.time.toString().toStdString(),
                                     md.fileName.toStdString(),
                                     sender,
@@ -327,7 +319,7 @@ namespace shims
             case BadFileHash:       //FALLTHROUGH
             case NetworkError:      //FALLTHROUGH
             case FileSystemError:
-                fmt::print(ofile, "[{}] file '{}' from <{}> (hash: {}, size: {:L} bytes): Error: {}, bytes transferred: {:L} bytes\n",
+                fmt::format_to(std::back_inserter(out), "[{}] file '{}' from <{}> (hash: {}, size: {:L} bytes): Error: {}, bytes transferred: {:L} bytes\n",
                                     event.time.toString().toStdString(),
                                     md.fileName.toStdString(),
                                     sender,
@@ -341,48 +333,44 @@ namespace shims
         }
     }
 
-    void ConversationModel::deserializeUserStatusUpdateEventToFile(const EventData &event, std::ofstream &ofile) const
+    void ConversationModel::serializeUserStatusUpdateEvent(const EventData &event, const ExportStrings &strings, std::string &out)
     {
         if (event.userStatusData.target == UserTargetNone)
             return;
 
-        std::string sender = event.userStatusData.target == UserTargetClient
-                                    ? tr("me").toStdString()
-                                    : this->contact()->getNickname().toStdString();
-
         switch (event.userStatusData.status)
         {
             case ContactUser::Status::Online:
-                fmt::print(ofile, "[{}] <{}> is now online\n",
+                fmt::format_to(std::back_inserter(out), "[{}] <{}> is now online\n",
                                     event.time.toString().toStdString(),
-                                    this->contact()->getNickname().toStdString()); break;
+                                    strings.nickname); break;
             case ContactUser::Status::Offline:
-                fmt::print(ofile, "[{}] <{}> is now offline\n",
+                fmt::format_to(std::back_inserter(out), "[{}] <{}> is now offline\n",
                                     event.time.toString().toStdString(),
-                                    this->contact()->getNickname().toStdString()); break;
+                                    strings.nickname); break;
             case ContactUser::Status::RequestPending:
-                fmt::print(ofile, "[{}] New contact request to <{}>\n",
+                fmt::format_to(std::back_inserter(out), "[{}] New contact request to <{}>\n",
                                     event.time.toString().toStdString(),
-                                    this->contact()->getNickname().toStdString()); break;
+                                    strings.nickname); break;
             case ContactUser::Status::RequestRejected:
-                fmt::print(ofile, "[{}] Outgoing request to <{}> was rejected\n",
+                fmt::format_to(std::back_inserter(out), "[{}] Outgoing request to <{}> was rejected\n",
                                     event.time.toString().toStdString(),
-                                    this->contact()->getNickname().toStdString()); break;
+                                    strings.nickname); break;
             default:
                 break;
         }
     }
 
-    void ConversationModel::deserializeEventToFile(const EventData &event, std::ofstream &ofile) const
+    void ConversationModel::serializeEvent(const EventData &event, const QList<MessageData> &messages, const ExportStrings &strings, std::string &out)
     {
         switch (event.type)
         {
             case TextMessageEvent:
-                deserializeTextMessageEventToFile(event, ofile); break;
+                serializeTextMessageEvent(event, messages, strings, out); break;
             case TransferMessageEvent:
-                deserializeTransferMessageEventToFile(event, ofile); break;
+                serializeTransferMessageEvent(event, messages, strings, out); break;
             case UserStatusUpdateEvent:
-                deserializeUserStatusUpdateEventToFile(event, ofile); break;
+                serializeUserStatusUpdateEvent(event, strings, out); break;
             default:
                 qWarning() << "Unknown event type in events list";
                 break;
@@ -395,6 +383,12 @@ namespace shims
 
     bool ConversationModel::exportConversation()
     {
+        if (exporter && !exporter->finished())
+        {
+            qWarning() << "Conversation export already in progress";
+            return false;
+        }
+
         const auto proposedDest = QString("%1/%2-%3.log").arg(QStandardPaths::writableLocation(QStandardPaths::DownloadLocation)).arg(this->contact()->getNickname()).arg(this->events.constFirst().time.toString(Qt::ISODate));
 
         auto filePath = QFileDialog::getSaveFileName(nullptr,
@@ -405,21 +399,53 @@ namespace shims
         if (filePath.isEmpty())
             return true;
 
-        std::ofstream ofile(filePath.toStdString(), std::ios::out);
-        if (!ofile.is_open())
-        {
-            qWarning() << "Could not open file " << filePath;
-            return false;
-        }
+        ExportStrings strings;
+        strings.nickname = this->contact()->getNickname().toStdString();
+        strings.me = tr("me").toStdString();
 
-        fmt::print(ofile, "Conversation with {} ({})\n",
-                            this->contact()->getNickname().toStdString(),
+        auto header = fmt::format("Conversation with {} ({})\n",
+                            strings.nickname,
                             this->contact()->getContactID().toStdString());
 
-        foreach(auto &event, this->events)
+        // both lists are implicitly shared, so the snapshot is O(1) here and the
+        // worker keeps reading it even if we modify ours in the meantime
+        const auto eventsSnapshot = this->events;
+        const auto messagesSnapshot = this->messages;
+
+        auto formatEntry = [eventsSnapshot, messagesSnapshot, strings](std::string &out, size_t index) -> void
         {
-            deserializeEventToFile(event, ofile);
-        }
+            serializeEvent(eventsSnapshot[safe_cast<int>(index)], messagesSnapshot, strings, out);
+        };
+
+        // the exporter reports from its worker thread, bounce back to ours; it is
+        // owned by this model and joined before we go away so 'this' stays valid
+        auto progress = [this](size_t entriesWritten, size_t entriesTotal) -> void
+        {
+            QMetaObject::invokeMethod(this, [=]() -> void
+            {
+                emit this->conversationExportProgressChanged(safe_cast<int>(entriesWritten), safe_cast<int>(entriesTotal));
+            }, Qt::QueuedConnection);
+        };
+        auto complete = [this, filePath](bool success) -> void
+        {
+            QMetaObject::invokeMethod(this, [=]() -> void
+            {
+                if (!success)
+                {
+                    qWarning() << "Could not export conversation to" << filePath;
+                }
+                emit this->conversationExportFinished(success);
+            }, Qt::QueuedConnection);
+        };
+
+        exporter = std::make_unique<tego::conversation_exporter>(
+            filePath.toStdString(),
+            std::move(header),
+            static_cast<size_t>(eventsSnapshot.size()),
+            std::move(formatEntry),
+            std::move(progress),
+            std::move(complete));
+        exporter->start();
 
         return true;
     }
@@ -555,9 +581,7 @@ namespace shims
         md.transferDirection = Downloading;
         md.transferStatus = Pending;
 
-        this->beginInsertRows(QModelIndex(), 0, 0);
-        this->messages.prepend(std::move(md));
-        this->endInsertRows();
+        this->prependMessage(std::move(md));
 
         this->setUnreadCount(this->unreadCount + 1);
         this->addEventFromMessage(indexOfIncomingMessage(id));
@@ -571,6 +595,7 @@ namespace shims
         MessageData &data = messages[row];
         data.status = accepted ? Delivered : Error;
         emitDataChanged(row);
+        messageStatusChanged(row);
     }
 
     void ConversationModel::fileTransferRequestResponded(tego_file_transfer_id_t id, tego_file_transfer_response_t response)
@@ -656,6 +681,7 @@ namespace shims
 
         beginRemoveRows(QModelIndex(), 0, messages.size()-1);
         messages.clear();
+        undeliveredRowCount = 0;
         endRemoveRows();
 
         resetUnreadCount();
@@ -670,9 +696,7 @@ namespace shims
         md.identifier = messageId;
         md.status = Received;
 
-        this->beginInsertRows(QModelIndex(), 0, 0);
-        this->messages.prepend(std::move(md));
-        this->endInsertRows();
+        this->prependMessage(std::move(md));
 
         this->setUnreadCount(this->unreadCount + 1);
         this->addEventFromMessage(indexOfIncomingMessage(messageId));
@@ -693,6 +717,7 @@ namespace shims
         MessageData &data = messages[row];
         data.status = accepted ? Delivered : Error;
         emitDataChanged(row);
+        messageStatusChanged(row);
     }
 
     void ConversationModel::addEventFromMessage(int row)
@@ -735,6 +760,56 @@ namespace shims
 
         this->events.append(std::move(ed));
         emit this->conversationEventCountChanged();
+
+        // the offline section is only shown while the contact is not online
+        emitSectionChanged(undeliveredRowCount);
+    }
+
+    void ConversationModel::prependMessage(MessageData &&md)
+    {
+        if (!messages.isEmpty())
+        {
+            md.timespan = messages.constFirst().time.secsTo(md.time);
+        }
+
+        const auto previousUndeliveredRowCount = undeliveredRowCount;
+        const bool delivered = (md.status == Received || md.status == Delivered);
+
+        this->beginInsertRows(QModelIndex(), 0, 0);
+        this->messages.prepend(std::move(md));
+        undeliveredRowCount = delivered ? 0 : undeliveredRowCount + 1;
+        this->endInsertRows();
+
+        // a delivered message ends the offline run, so the old boundary row
+        // (shifted down by the insert) loses its section
+        if (delivered && previousUndeliveredRowCount > 0)
+        {
+            emitSectionChanged(previousUndeliveredRowCount + 1);
+        }
+    }
+
+    void ConversationModel::messageStatusChanged(int row)
+    {
+        Q_ASSERT(row >= 0);
+
+        const auto status = messages[row].status;
+        if ((status == Received || status == Delivered) && row < undeliveredRowCount)
+        {
+            const auto previousUndeliveredRowCount = undeliveredRowCount;
+            undeliveredRowCount = row;
+
+            emitSectionChanged(previousUndeliveredRowCount);
+            emitSectionChanged(undeliveredRowCount);
+        }
+    }
+
+    void ConversationModel::emitSectionChanged(int undeliveredCount)
+    {
+        const auto row = undeliveredCount - 1;
+        if (row >= 0 && row < messages.size())
+        {
+            emit dataChanged(index(row, 0), index(row, 0), {SectionRole});
+        }
     }
 
     void ConversationModel::emitDataChanged(int row)
@@ -2,6 +2,8 @@
 
 #include "ContactUser.h"
 
+#include <tego/conversation_export.hpp>
+
 namespace shims
 {
     class ContactUser;
@@ -119,6 +121,8 @@ namespace shims
         void contactChanged();
         void unreadCountChanged(int prevCount, int currentCount);
         void conversationEventCountChanged();
+        void conversationExportProgressChanged(int entriesWritten, int entriesTotal);
+        void conversationExportFinished(bool success);
     private:
         void setUnreadCount(int count);
 
@@ -141,6 +145,9 @@ namespace shims
             quint64 bytesTransferred = 0;
             TransferDirection transferDirection = InvalidDirection;
             TransferStatus transferStatus = InvalidTransfer;
+            // seconds between the previous (older) message and this one, -1 if first;
+            // computed once on insert since message times never change
+            qint64 timespan = -1;
         };
 
         struct EventData
@@ -169,12 +176,31 @@ namespace shims
         QList<MessageData> messages;
         QList<EventData> events;
 
+        // number of rows at the top of the model (newest first) before the first
+        // Received or Delivered message; the last of these rows carries the
+        // 'offline' section
+        int undeliveredRowCount = 0;
+
+        void prependMessage(MessageData &&md);
+        void messageStatusChanged(int row);
+        void emitSectionChanged(int undeliveredCount);
+
         void addEventFromMessage(int row);
 
-        void deserializeTextMessageEventToFile(const EventData &event, std::ofstream &ofile) const;
-        void deserializeTransferMessageEventToFile(const EventData &event, std::ofstream &ofile) const;
-        void deserializeUserStatusUpdateEventToFile(const EventData &event, std::ofstream &ofile) const;
-        void deserializeEventToFile(const EventData &event, std::ofstream &ofile) const;
+        // strings needed to format events, resolved on the GUI thread before
+        // handing a snapshot over to the export worker
+        struct ExportStrings
+        {
+            std::string nickname;
+            std::string me;
+        };
+
+        static void serializeTextMessageEvent(const EventData &event, const QList<MessageData> &messages, const ExportStrings &strings, std::string &out);
+        static void serializeTransferMessageEvent(const EventData &event, const QList<MessageData> &messages, const ExportStrings &strings, std::string &out);
+        static void serializeUserStatusUpdateEvent(const EventData &event, const ExportStrings &strings, std::string &out);
+        static void serializeEvent(const EventData &event, const QList<MessageData> &messages, const ExportStrings &strings, std::string &out);
+
+        std::unique_ptr<tego::conversation_exporter> exporter;
 
         int unreadCount = 0;
 
@@ -47,6 +47,15 @@ Item {
 
     signal renameTriggered
 
+    Connections {
+        target: contact !== null ? contact.conversation : null
+        onConversationExportFinished: {
+            if (success != true) {
+                exportConversationFailedDialog.visible = true;
+            }
+        }
+    }
+
     MessageDialog {
         id: exportConversationFailedDialog
 